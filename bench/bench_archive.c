@@ -0,0 +1,161 @@
+/**
+ * Benchmark for archives of codes
+ *
+ * Packs a G-code file given as the first argument, or generated slicer-like
+ * output when there isn't one, as an archive of human codes and as an archive
+ * of the same codes dumped as binary. Reports how much smaller each archive
+ * is, and how fast it is packed, popped and parsed on several threads.
+ */
+#include <scode.h>
+#include <scode_file.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GENERATED_LINES 200000
+#define ROUNDS 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Layers of extrusion moves with a travel move and a feed rate change every
+// so often, with three decimals on the axes and five on E
+static char *generate(size_t *len) {
+  size_t cap = GENERATED_LINES * 64;
+  char *buf = malloc(cap);
+  size_t pos = 0;
+  uint32_t seed = 1;
+  double e = 0;
+  double z = 0.2;
+  for (int i = 0; i < GENERATED_LINES; ++i) {
+    seed = seed * 1103515245 + 12345;
+    double x = (seed >> 8) % 220000 / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double y = (seed >> 8) % 220000 / 1000.0;
+    e += (seed >> 20) % 100 / 1000.0;
+    if (i % 2000 == 0) {
+      z += 0.2;
+      pos += snprintf(buf + pos, cap - pos, ";LAYER_CHANGE\n");
+      pos += snprintf(buf + pos, cap - pos, "G1 Z%.3f F9000\n", z);
+    } else if (i % 50 == 0) {
+      pos += snprintf(buf + pos, cap - pos, "G0 F9000 X%.3f Y%.3f\n", x, y);
+      pos += snprintf(buf + pos, cap - pos, "G1 F1800\n");
+    } else {
+      pos += snprintf(buf + pos, cap - pos, "G1 X%.3f Y%.3f E%.5f\n", x, y, e);
+    }
+  }
+  *len = pos;
+  return buf;
+}
+
+static size_t file_size(const char *path) {
+  struct stat st;
+  return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+// Write the codes of a file to an archive as binary codes
+static int pack_binary(const char *path, const char *archive_path) {
+  code_file_t file;
+  if (init_code_file(&file, path) < 0) {
+    free_code_file(&file);
+    return SCODE_ERROR_FILE;
+  }
+  int fd = open(archive_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  code_archive_writer_t writer;
+  int res = init_code_archive_writer(&writer, fd, 0);
+  code_t code;
+  while (res >= 0) {
+    int popped = code_file_pop(&file, &code);
+    if (popped == SCODE_ERROR_BUFFER) {
+      break;
+    }
+    if (popped == 0) {
+      res = code_archive_dump_binary(&writer, &code);
+      free_code(&code);
+    }
+  }
+  if (res >= 0) {
+    res = code_archive_finish(&writer);
+  }
+  free_code_archive_writer(&writer);
+  close(fd);
+  free_code_file(&file);
+  return res;
+}
+
+static void run(const char *name, const char *path, const char *archive_path,
+                int binary) {
+  double pack = 0, pop = 0, parallel = 0;
+  size_t num_codes = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    int res = binary ? pack_binary(path, archive_path)
+                     : code_archive_pack(path, archive_path, 0);
+    double elapsed = now() - start;
+    if (res < 0) {
+      printf("%s: failed with %d\n", name, res);
+      return;
+    }
+    pack = round == 0 || elapsed < pack ? elapsed : pack;
+
+    start = now();
+    code_archive_t archive;
+    init_code_archive(&archive, archive_path);
+    code_view_t view;
+    num_codes = 0;
+    while ((res = code_archive_pop_view(&archive, &view)) !=
+           SCODE_ERROR_BUFFER) {
+      num_codes += res == 0;
+    }
+    free_code_archive(&archive);
+    elapsed = now() - start;
+    pop = round == 0 || elapsed < pop ? elapsed : pop;
+
+    start = now();
+    scode_codes_t codes;
+    scode_parse_archive_parallel(&codes, archive_path, 0);
+    free_scode_codes(&codes);
+    elapsed = now() - start;
+    parallel = round == 0 || elapsed < parallel ? elapsed : parallel;
+  }
+  size_t len = file_size(path);
+  size_t packed = file_size(archive_path);
+  printf("%s: %zu -> %zu bytes (%.2fx), pack %.0f MB/s, "
+         "pop_view %.1f ns/code, parallel parse %.1f ns/code\n",
+         name, len, packed, (double)len / packed, len / pack / 1e6,
+         pop * 1e9 / num_codes, parallel * 1e9 / num_codes);
+}
+
+int main(int argc, char **argv) {
+  char generated[] = "/tmp/scode_bench_XXXXXX";
+  char archive_path[] = "/tmp/scode_bench_XXXXXX";
+  close(mkstemp(archive_path));
+  const char *path = argc > 1 ? argv[1] : generated;
+  if (argc <= 1) {
+    size_t len;
+    char *buf = generate(&len);
+    int fd = mkstemp(generated);
+    if (write(fd, buf, len) != (ssize_t)len) {
+      perror(generated);
+      return 1;
+    }
+    close(fd);
+    free(buf);
+  }
+
+  run("human", path, archive_path, 0);
+  run("binary", path, archive_path, 1);
+
+  if (argc <= 1) {
+    unlink(generated);
+  }
+  unlink(archive_path);
+  return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * Benchmark for dumping bursts of binary codes
+ *
+ * Compares dumping and writing each code on its own with dumping a burst into
+ * one buffer with code_dump_binary_batch() and writing it at once.
+ */
+#include <scode.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CODES 100000
+#define ROUNDS 10
+#define BATCH 256
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Dump the codes one at a time, writing each to fd if it is open
+static int run_each(const code_t *codes, char *buf, size_t len, int fd) {
+  size_t written = 0;
+  for (int i = 0; i < CODES; ++i) {
+    int res = code_dump_binary(&codes[i], buf + written, len - written);
+    if (res < 0) {
+      return res;
+    }
+    if (fd >= 0 && write(fd, buf + written, res) != res) {
+      return SCODE_ERROR_DUMP;
+    }
+    written += res;
+  }
+  return 0;
+}
+
+// Dump the codes in bursts, writing each burst to fd if it is open
+static int run_batch(const code_t *codes, char *buf, size_t len, int fd) {
+  size_t offsets[BATCH];
+  size_t written = 0;
+  for (int i = 0; i < CODES; i += BATCH) {
+    size_t n = CODES - i < BATCH ? CODES - i : BATCH;
+    int res = code_dump_binary_batch(&codes[i], n, buf + written,
+                                     len - written, offsets);
+    if (res < 0) {
+      return res;
+    }
+    if (fd >= 0 && write(fd, buf + written, res) != res) {
+      return SCODE_ERROR_DUMP;
+    }
+    written += res;
+  }
+  return 0;
+}
+
+typedef int (*run_fn)(const code_t *codes, char *buf, size_t len, int fd);
+
+static void run(const char *name, run_fn fn, const code_t *codes, char *buf,
+                size_t len, int fd) {
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    int res = fn(codes, buf, len, fd);
+    if (res < 0) {
+      printf("%s: failed with %d\n", name, res);
+      return;
+    }
+    double elapsed = now() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  printf("%s: %.1f ns/code\n", name, best * 1e9 / CODES);
+}
+
+int main(void) {
+  code_t *codes = malloc(sizeof(code_t) * CODES);
+  uint32_t seed = 1;
+  double e = 0;
+  for (int i = 0; i < CODES; ++i) {
+    char line[128];
+    seed = seed * 1103515245 + 12345;
+    double x = (seed >> 8) % 220000 / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double y = (seed >> 8) % 220000 / 1000.0;
+    e += (seed >> 20) % 100 / 1000.0;
+    int n = snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f\n", x, y, e);
+    if (code_parse(&codes[i], line, n) < 0) {
+      printf("failed to parse %s", line);
+      return 1;
+    }
+  }
+
+  size_t len = CODES * 32;
+  char *buf = malloc(len);
+  int fd = open("/dev/null", O_WRONLY);
+  run("code_dump_binary", run_each, codes, buf, len, -1);
+  run("code_dump_binary_batch", run_batch, codes, buf, len, -1);
+  run("code_dump_binary + write", run_each, codes, buf, len, fd);
+  run("code_dump_binary_batch + write", run_batch, codes, buf, len, fd);
+  close(fd);
+
+  for (int i = 0; i < CODES; ++i) {
+    free_code(&codes[i]);
+  }
+  free(codes);
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * Benchmark for the checksums of binary codes
+ *
+ * Runs CRC-8, CRC-16 and CRC-32C over buffers the size of a short code, a
+ * long string param and a block of bulk data, and reports the throughput of
+ * each implementation.
+ */
+#include <scode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define TOTAL_BYTES (256 * 1024 * 1024)
+#define ROUNDS 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t run_crc8(const char *buf, size_t len) {
+  return crc_calc(buf, len, 0);
+}
+
+static uint32_t run_crc16(const char *buf, size_t len) {
+  return crc16_calc(buf, len, 0);
+}
+
+static uint32_t run_crc32c_table(const char *buf, size_t len) {
+  return crc32c_calc_table(buf, len, 0);
+}
+
+static uint32_t run_crc32c_hw(const char *buf, size_t len) {
+  return crc32c_calc_hw(buf, len, 0);
+}
+
+typedef uint32_t (*crc_fn)(const char *buf, size_t len);
+
+static void run(const char *name, crc_fn crc, const char *buf, size_t len) {
+  size_t iterations = TOTAL_BYTES / len;
+  uint32_t sink = 0;
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+      sink += crc(buf, len);
+    }
+    double elapsed = now() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  printf("%-14s %6zu B: %6.2f GB/s (%08x)\n", name, len,
+         (double)iterations * len / best / 1e9, sink);
+}
+
+int main(void) {
+  const size_t sizes[] = {64, 1024, 64 * 1024};
+  char *buf = malloc(sizes[2]);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < sizes[2]; ++i) {
+    seed = seed * 1103515245 + 12345;
+    buf[i] = seed >> 16;
+  }
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    run("crc8", run_crc8, buf, sizes[i]);
+    run("crc16", run_crc16, buf, sizes[i]);
+    run("crc32c table", run_crc32c_table, buf, sizes[i]);
+    if (crc32c_hw_supported()) {
+      run("crc32c hw", run_crc32c_hw, buf, sizes[i]);
+    }
+  }
+
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,216 @@
+/**
+ * Benchmark for delta coded binary codes
+ *
+ * Sends the codes of a G-code file given as the first argument, or generated
+ * slicer-like output when there isn't one, with and without delta coding, and
+ * reports the bytes per move and the time to dump and rebuild each code.
+ */
+#include <scode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GENERATED_LINES 200000
+#define ROUNDS 10
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Perimeters and infill made of short segments at a constant feed rate, with
+// a travel move every so often and a layer change every 2000 moves
+static char *generate(size_t *len) {
+  size_t cap = GENERATED_LINES * 64;
+  char *buf = malloc(cap);
+  size_t pos = 0;
+  uint32_t seed = 1;
+  double x = 100;
+  double y = 100;
+  double e = 0;
+  double z = 0.2;
+  for (int i = 0; i < GENERATED_LINES; ++i) {
+    seed = seed * 1103515245 + 12345;
+    double dx = ((int)(seed >> 8) % 2000 - 1000) / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double dy = ((int)(seed >> 8) % 2000 - 1000) / 1000.0;
+    x = x + dx < 10 || x + dx > 210 ? x - dx : x + dx;
+    y = y + dy < 10 || y + dy > 210 ? y - dy : y + dy;
+    e += (dx < 0 ? -dx : dx) * 0.033 + (dy < 0 ? -dy : dy) * 0.033;
+    if (i % 2000 == 0) {
+      z += 0.2;
+      pos += snprintf(buf + pos, cap - pos, "G1 Z%.3f F9000\n", z);
+    } else if (i % 100 == 0) {
+      pos += snprintf(buf + pos, cap - pos, "G0 X%.3f Y%.3f F9000\n", x, y);
+    } else {
+      pos += snprintf(buf + pos, cap - pos, "G1 X%.3f Y%.3f E%.5f F1800\n", x,
+                      y, e);
+    }
+  }
+  *len = pos;
+  return buf;
+}
+
+static char *load(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *buf = malloc(*len);
+  if (fread(buf, 1, *len, f) != *len) {
+    perror(path);
+    exit(1);
+  }
+  fclose(f);
+  return buf;
+}
+
+// Parse every code in the buffer, skipping lines that aren't codes. Codes
+// can't be moved once parsed, so there is room for one on every line.
+static code_t *parse_all(const char *buf, size_t len, size_t *num_codes) {
+  size_t lines = 1;
+  for (const char *c = buf; (c = memchr(c, '\n', buf + len - c)) != NULL;
+       ++c) {
+    lines++;
+  }
+  code_t *codes = malloc(sizeof(code_t) * lines);
+  size_t n = 0;
+  size_t pos = 0;
+  while (pos < len && n < lines) {
+    int res = code_parse(&codes[n], buf + pos, len - pos);
+    if (res >= 0) {
+      n++;
+      pos += res;
+    } else if (res == SCODE_ERROR_EMPTY || res == SCODE_ERROR_PARSE) {
+      const char *eol = memchr(buf + pos, '\n', len - pos);
+      pos = eol == NULL ? len : eol - buf + 1;
+    } else {
+      break;
+    }
+  }
+  *num_codes = n;
+  return codes;
+}
+
+static int is_move(const code_t *code) {
+  return code_letter(code) == 'G' && code->number <= 1;
+}
+
+// Dump the codes into buf, returning the number of bytes or an error
+static long dump_all(const code_t *codes, size_t num_codes, char *buf,
+                     size_t len, const scode_quant_t *quant, int delta,
+                     size_t *move_bytes) {
+  code_delta_t state = init_code_delta();
+  size_t pos = 0;
+  *move_bytes = 0;
+  for (size_t i = 0; i < num_codes; ++i) {
+    int res;
+    if (delta) {
+      res = code_dump_binary_delta(&codes[i], buf + pos, len - pos, &state,
+                                   quant);
+    } else if (quant != NULL) {
+      res = code_dump_binary_quant(&codes[i], buf + pos, len - pos, quant);
+    } else {
+      res = code_dump_binary(&codes[i], buf + pos, len - pos);
+    }
+    if (res < 0) {
+      return res;
+    }
+    if (is_move(&codes[i])) {
+      *move_bytes += res;
+    }
+    pos += res;
+  }
+  return pos;
+}
+
+// Pop every code out of the dump, returning the number of codes
+static long pop_all(const char *buf, size_t len, const scode_quant_t *quant,
+                    int delta) {
+  code_delta_t state = init_code_delta();
+  code_stream_t stream = init_code_stream(len);
+  code_stream_set_quant(&stream, quant);
+  if (delta) {
+    code_stream_set_delta(&stream, &state);
+  }
+  code_stream_update(&stream, buf, len);
+  code_t code = init_code('G', 0, 0);
+  long codes = 0;
+  int res;
+  while ((res = code_stream_pop_into(&stream, &code)) == 0) {
+    codes++;
+  }
+  free_code(&code);
+  free_code_stream(&stream);
+  return res == SCODE_ERROR_BUFFER ? codes : res;
+}
+
+static void run(const char *name, const code_t *codes, size_t num_codes,
+                const scode_quant_t *quant, int delta) {
+  size_t len = num_codes * 64;
+  char *buf = malloc(len);
+  size_t moves = 0;
+  for (size_t i = 0; i < num_codes; ++i) {
+    moves += is_move(&codes[i]);
+  }
+  size_t move_bytes = 0;
+  long bytes = 0;
+  long popped = 0;
+  double dump = 0;
+  double pop = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    bytes = dump_all(codes, num_codes, buf, len, quant, delta, &move_bytes);
+    double middle = now();
+    popped = bytes < 0 ? 0 : pop_all(buf, bytes, quant, delta);
+    double elapsed = now() - middle;
+    if (round == 0 || middle - start < dump) {
+      dump = middle - start;
+    }
+    if (round == 0 || elapsed < pop) {
+      pop = elapsed;
+    }
+  }
+  free(buf);
+  if (bytes < 0 || popped != (long)num_codes) {
+    printf("%s: failed with %ld/%ld\n", name, bytes, popped);
+    return;
+  }
+  printf("%s: %ld bytes, %.2f bytes/move, dump %.1f ns/code, pop %.1f "
+         "ns/code\n",
+         name, bytes, moves > 0 ? (double)move_bytes / moves : 0,
+         dump * 1e9 / num_codes, pop * 1e9 / num_codes);
+}
+
+int main(int argc, char **argv) {
+  size_t len;
+  char *buf = argc > 1 ? load(argv[1], &len) : generate(&len);
+  size_t num_codes;
+  code_t *codes = parse_all(buf, len, &num_codes);
+  free(buf);
+
+  scode_quant_t profile = {0};
+  scode_quant_set(&profile, 'X', 100, PARAM_T_I16);
+  scode_quant_set(&profile, 'Y', 100, PARAM_T_I16);
+  scode_quant_set(&profile, 'Z', 100, PARAM_T_I16);
+  scode_quant_set(&profile, 'E', 100000, PARAM_T_I32);
+
+  printf("%zu codes\n", num_codes);
+  run("binary", codes, num_codes, NULL, 0);
+  run("binary delta", codes, num_codes, NULL, 1);
+  run("binary quant", codes, num_codes, &profile, 0);
+  run("binary quant delta", codes, num_codes, &profile, 1);
+
+  for (size_t i = 0; i < num_codes; ++i) {
+    free_code(&codes[i]);
+  }
+  free(codes);
+  return 0;
+}
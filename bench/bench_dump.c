@@ -0,0 +1,82 @@
+/**
+ * Benchmark for dumping human codes
+ *
+ * Re-emits generated slicer-like moves, which is what a transcoder spends
+ * most of its time doing.
+ */
+#include <scode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CODES 100000
+#define ROUNDS 10
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+typedef int (*dump_fn)(const code_t *code, char *buf, size_t len);
+
+static int dump_fixed(const code_t *code, char *buf, size_t len) {
+  return code_dump_human_fixed(code, buf, len, 3);
+}
+
+static void run(const char *name, dump_fn dump, const code_t *codes,
+                char *buf, size_t len) {
+  size_t written = 0;
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    written = 0;
+    for (int i = 0; i < CODES; ++i) {
+      int res = dump(&codes[i], buf + written, len - written);
+      if (res < 0) {
+        printf("%s: failed with %d\n", name, res);
+        return;
+      }
+      written += res;
+    }
+    double elapsed = now() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  printf("%s: %zu bytes, %.1f MB/s, %.1f ns/code\n", name, written,
+         written / best / 1e6, best * 1e9 / CODES);
+}
+
+int main(void) {
+  // Parse the codes from text so that the values are what a transcoder sees
+  code_t *codes = malloc(sizeof(code_t) * CODES);
+  uint32_t seed = 1;
+  double e = 0;
+  for (int i = 0; i < CODES; ++i) {
+    char line[128];
+    seed = seed * 1103515245 + 12345;
+    double x = (seed >> 8) % 220000 / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double y = (seed >> 8) % 220000 / 1000.0;
+    e += (seed >> 20) % 100 / 1000.0;
+    int n = snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f\n", x, y, e);
+    if (code_parse(&codes[i], line, n) < 0) {
+      printf("failed to parse %s", line);
+      return 1;
+    }
+  }
+
+  size_t len = CODES * 64;
+  char *buf = malloc(len);
+  run("code_dump_human", code_dump_human, codes, buf, len);
+  run("code_dump_human_fixed", dump_fixed, codes, buf, len);
+
+  for (int i = 0; i < CODES; ++i) {
+    free_code(&codes[i]);
+  }
+  free(codes);
+  free(buf);
+  return 0;
+}
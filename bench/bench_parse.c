@@ -0,0 +1,132 @@
+/**
+ * Benchmark for parsing human codes
+ *
+ * Parses a G-code file given as the first argument, or generated slicer-like
+ * output when there isn't one.
+ */
+#include <scode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GENERATED_LINES 200000
+#define ROUNDS 10
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Extrusion moves with three decimals on the axes and five on E, like most
+// slicers output
+static char *generate(size_t *len) {
+  size_t cap = GENERATED_LINES * 64;
+  char *buf = malloc(cap);
+  size_t pos = 0;
+  uint32_t seed = 1;
+  double e = 0;
+  for (int i = 0; i < GENERATED_LINES; ++i) {
+    seed = seed * 1103515245 + 12345;
+    double x = (seed >> 8) % 220000 / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double y = (seed >> 8) % 220000 / 1000.0;
+    e += (seed >> 20) % 100 / 1000.0;
+    if (i % 50 == 0) {
+      pos += snprintf(buf + pos, cap - pos, ";TYPE:WALL-OUTER\n");
+      pos += snprintf(buf + pos, cap - pos, "G1 F1800 X%.3f Y%.3f\n", x, y);
+    } else {
+      pos += snprintf(buf + pos, cap - pos, "G1 X%.3f Y%.3f E%.5f\n", x, y, e);
+    }
+  }
+  *len = pos;
+  return buf;
+}
+
+static char *load(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *buf = malloc(*len);
+  if (fread(buf, 1, *len, f) != *len) {
+    perror(path);
+    exit(1);
+  }
+  fclose(f);
+  return buf;
+}
+
+typedef int (*parse_fn)(const char *buf, size_t len, size_t *params);
+
+static int parse_owned(const char *buf, size_t len, size_t *params) {
+  code_t code;
+  int res = code_parse(&code, buf, len);
+  if (res >= 0) {
+    for (param_t *p = code.params; p != NULL && p->param != 0; ++p) {
+      (*params)++;
+    }
+    free_code(&code);
+  }
+  return res;
+}
+
+static int parse_view(const char *buf, size_t len, size_t *params) {
+  code_view_t code;
+  param_view_t views[32];
+  int res = code_parse_view(&code, views, 32, buf, len);
+  if (res >= 0) {
+    *params += code.num_params;
+  }
+  return res;
+}
+
+static void run(const char *name, parse_fn parse, const char *buf, size_t len) {
+  size_t codes = 0;
+  size_t params = 0;
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    codes = 0;
+    params = 0;
+    size_t pos = 0;
+    while (pos < len) {
+      int res = parse(buf + pos, len - pos, &params);
+      if (res >= 0) {
+        codes++;
+        pos += res;
+      } else if (res == SCODE_ERROR_EMPTY || res == SCODE_ERROR_PARSE) {
+        // Skip the line
+        const char *eol = memchr(buf + pos, '\n', len - pos);
+        pos = eol == NULL ? len : eol - buf + 1;
+      } else {
+        break;
+      }
+    }
+    double elapsed = now() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+
+  printf("%s: %zu bytes, %zu codes, %zu params\n", name, len, codes, params);
+  printf("%s: %.1f MB/s, %.1f ns/code, %.1f ns/param\n", name,
+         len / best / 1e6, best * 1e9 / codes, best * 1e9 / params);
+}
+
+int main(int argc, char **argv) {
+  size_t len;
+  char *buf = argc > 1 ? load(argv[1], &len) : generate(&len);
+
+  run("code_parse", parse_owned, buf, len);
+  run("code_parse_view", parse_view, buf, len);
+
+  free(buf);
+  return 0;
+}
@@ -0,0 +1,208 @@
+/**
+ * Benchmark for the size of quantized binary codes
+ *
+ * Dumps the codes of a G-code file given as the first argument, or generated
+ * slicer-like output when there isn't one, as human, binary, narrowed binary
+ * and quantized binary codes, and reports the bytes per move of each.
+ */
+#include <scode.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GENERATED_LINES 200000
+#define ROUNDS 10
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Layers of extrusion moves with a travel move and a feed rate change every
+// so often, with three decimals on the axes and five on E
+static char *generate(size_t *len) {
+  size_t cap = GENERATED_LINES * 64;
+  char *buf = malloc(cap);
+  size_t pos = 0;
+  uint32_t seed = 1;
+  double e = 0;
+  double z = 0.2;
+  for (int i = 0; i < GENERATED_LINES; ++i) {
+    seed = seed * 1103515245 + 12345;
+    double x = (seed >> 8) % 220000 / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double y = (seed >> 8) % 220000 / 1000.0;
+    e += (seed >> 20) % 100 / 1000.0;
+    if (i % 2000 == 0) {
+      z += 0.2;
+      pos += snprintf(buf + pos, cap - pos, ";LAYER_CHANGE\n");
+      pos += snprintf(buf + pos, cap - pos, "G1 Z%.3f F9000\n", z);
+    } else if (i % 50 == 0) {
+      pos += snprintf(buf + pos, cap - pos, "G0 F9000 X%.3f Y%.3f\n", x, y);
+      pos += snprintf(buf + pos, cap - pos, "G1 F1800\n");
+    } else {
+      pos += snprintf(buf + pos, cap - pos, "G1 X%.3f Y%.3f E%.5f\n", x, y, e);
+    }
+  }
+  *len = pos;
+  return buf;
+}
+
+static char *load(const char *path, size_t *len) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  char *buf = malloc(*len);
+  if (fread(buf, 1, *len, f) != *len) {
+    perror(path);
+    exit(1);
+  }
+  fclose(f);
+  return buf;
+}
+
+// Parse every code in the buffer, skipping lines that aren't codes. Codes
+// can't be moved once parsed, so there is room for one on every line.
+static code_t *parse_all(const char *buf, size_t len, size_t *num_codes) {
+  size_t lines = 1;
+  for (const char *c = buf; (c = memchr(c, '\n', buf + len - c)) != NULL;
+       ++c) {
+    lines++;
+  }
+  code_t *codes = malloc(sizeof(code_t) * lines);
+  size_t n = 0;
+  size_t pos = 0;
+  while (pos < len && n < lines) {
+    int res = code_parse(&codes[n], buf + pos, len - pos);
+    if (res >= 0) {
+      n++;
+      pos += res;
+    } else if (res == SCODE_ERROR_EMPTY || res == SCODE_ERROR_PARSE) {
+      const char *eol = memchr(buf + pos, '\n', len - pos);
+      pos = eol == NULL ? len : eol - buf + 1;
+    } else {
+      break;
+    }
+  }
+  *num_codes = n;
+  return codes;
+}
+
+static int is_move(const code_t *code) {
+  return code_letter(code) == 'G' && code->number <= 1;
+}
+
+typedef int (*dump_fn)(const code_t *code, char *buf, size_t len,
+                       const scode_quant_t *profile);
+
+static int dump_human(const code_t *code, char *buf, size_t len,
+                      const scode_quant_t *profile) {
+  (void)profile;
+  return code_dump_human(code, buf, len);
+}
+
+static int dump_binary(const code_t *code, char *buf, size_t len,
+                       const scode_quant_t *profile) {
+  (void)profile;
+  return code_dump_binary(code, buf, len);
+}
+
+static int dump_narrow(const code_t *code, char *buf, size_t len,
+                       const scode_quant_t *profile) {
+  (void)profile;
+  return code_dump_binary_narrow(code, buf, len);
+}
+
+static void run(const char *name, dump_fn dump, const code_t *codes,
+                size_t num_codes, const scode_quant_t *profile) {
+  char buf[4096];
+  size_t move_bytes = 0;
+  size_t moves = 0;
+  size_t bytes = 0;
+  double best = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    bytes = 0;
+    move_bytes = 0;
+    moves = 0;
+    for (size_t i = 0; i < num_codes; ++i) {
+      int res = dump(&codes[i], buf, sizeof(buf), profile);
+      if (res < 0) {
+        printf("%s: failed with %d\n", name, res);
+        return;
+      }
+      bytes += res;
+      if (is_move(&codes[i])) {
+        move_bytes += res;
+        moves++;
+      }
+    }
+    double elapsed = now() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  printf("%s: %zu bytes, %.2f bytes/move, %.1f ns/code\n", name, bytes,
+         moves > 0 ? (double)move_bytes / moves : 0, best * 1e9 / num_codes);
+}
+
+// Largest difference between the moves and their quantized round trip
+static double max_error(const code_t *codes, size_t num_codes,
+                        const scode_quant_t *profile) {
+  char buf[4096];
+  double worst = 0;
+  for (size_t i = 0; i < num_codes; ++i) {
+    int res = code_dump_binary_quant(&codes[i], buf, sizeof(buf), profile);
+    code_t code;
+    if (res < 0 || code_parse(&code, buf, res) < 0) {
+      continue;
+    }
+    code_dequantize(&code, profile);
+    for (int j = 0; code.params != NULL && code.params[j].param != 0; ++j) {
+      if (param_type(&code.params[j]) != PARAM_T_STR) {
+        double error = param_cast_f64(&code.params[j]) -
+                       param_cast_f64(&codes[i].params[j]);
+        error = error < 0 ? -error : error;
+        worst = error > worst ? error : worst;
+      }
+    }
+    free_code(&code);
+  }
+  return worst;
+}
+
+int main(int argc, char **argv) {
+  size_t len;
+  char *buf = argc > 1 ? load(argv[1], &len) : generate(&len);
+  size_t num_codes;
+  code_t *codes = parse_all(buf, len, &num_codes);
+  free(buf);
+
+  // 10 um on the axes fits a 327 mm bed in an I16, and E is absolute
+  scode_quant_t profile = {0};
+  scode_quant_set(&profile, 'X', 100, PARAM_T_I16);
+  scode_quant_set(&profile, 'Y', 100, PARAM_T_I16);
+  scode_quant_set(&profile, 'Z', 100, PARAM_T_I16);
+  scode_quant_set(&profile, 'E', 100000, PARAM_T_I32);
+
+  printf("%zu codes\n", num_codes);
+  run("human", dump_human, codes, num_codes, NULL);
+  run("binary", dump_binary, codes, num_codes, NULL);
+  run("binary narrow", dump_narrow, codes, num_codes, NULL);
+  run("binary quant", code_dump_binary_quant, codes, num_codes, &profile);
+  printf("binary quant: max error %g\n", max_error(codes, num_codes, &profile));
+
+  for (size_t i = 0; i < num_codes; ++i) {
+    free_code(&codes[i]);
+  }
+  free(codes);
+  return 0;
+}
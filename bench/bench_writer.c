@@ -0,0 +1,124 @@
+/**
+ * Benchmark for writing codes to a pipe
+ *
+ * Compares a write() for every dumped code with a code_writer_t, which stands
+ * in for sending codes to a serial port or socket. A thread drains the other
+ * end of the pipe.
+ */
+#include <scode.h>
+#include <scode_file.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CODES 100000
+#define ROUNDS 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *drain(void *arg) {
+  int fd = *(int *)arg;
+  char buf[65536];
+  while (read(fd, buf, sizeof(buf)) > 0) {
+  }
+  return NULL;
+}
+
+// Dump each code and write it on its own, returning the number of writes
+static long run_each(const code_t *codes, int fd, int is_binary) {
+  char buf[256];
+  for (int i = 0; i < CODES; ++i) {
+    int len = is_binary ? code_dump_binary(&codes[i], buf, sizeof(buf))
+                        : code_dump_human(&codes[i], buf, sizeof(buf));
+    if (len < 0 || write(fd, buf, len) != len) {
+      return -1;
+    }
+  }
+  return CODES;
+}
+
+// Dump the codes into a writer, returning the number of writes
+static long run_writer(const code_t *codes, int fd, int is_binary) {
+  code_writer_t writer;
+  if (init_code_writer(&writer, fd, 0) < 0) {
+    return -1;
+  }
+  for (int i = 0; i < CODES; ++i) {
+    int res = is_binary ? code_writer_dump_binary(&writer, &codes[i])
+                        : code_writer_dump_human(&writer, &codes[i]);
+    if (res < 0) {
+      free_code_writer(&writer);
+      return -1;
+    }
+  }
+  long writes = code_writer_flush(&writer) < 0 ? -1 : writer.num_writes;
+  free_code_writer(&writer);
+  return writes;
+}
+
+typedef long (*run_fn)(const code_t *codes, int fd, int is_binary);
+
+static void run(const char *name, run_fn fn, const code_t *codes, int fd,
+                int is_binary) {
+  double best = 0;
+  long writes = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    double start = now();
+    writes = fn(codes, fd, is_binary);
+    if (writes < 0) {
+      printf("%s: failed\n", name);
+      return;
+    }
+    double elapsed = now() - start;
+    if (round == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  printf("%s: %ld writes, %.1f ns/code\n", name, writes, best * 1e9 / CODES);
+}
+
+int main(void) {
+  code_t *codes = malloc(sizeof(code_t) * CODES);
+  uint32_t seed = 1;
+  double e = 0;
+  for (int i = 0; i < CODES; ++i) {
+    char line[128];
+    seed = seed * 1103515245 + 12345;
+    double x = (seed >> 8) % 220000 / 1000.0;
+    seed = seed * 1103515245 + 12345;
+    double y = (seed >> 8) % 220000 / 1000.0;
+    e += (seed >> 20) % 100 / 1000.0;
+    int n = snprintf(line, sizeof(line), "G1 X%.3f Y%.3f E%.5f\n", x, y, e);
+    if (code_parse(&codes[i], line, n) < 0) {
+      printf("failed to parse %s", line);
+      return 1;
+    }
+  }
+
+  int fds[2];
+  pthread_t thread;
+  if (pipe(fds) < 0 || pthread_create(&thread, NULL, drain, &fds[0]) != 0) {
+    printf("failed to open a pipe\n");
+    return 1;
+  }
+  run("human, write per code", run_each, codes, fds[1], 0);
+  run("human, code_writer_t", run_writer, codes, fds[1], 0);
+  run("binary, write per code", run_each, codes, fds[1], 1);
+  run("binary, code_writer_t", run_writer, codes, fds[1], 1);
+  close(fds[1]);
+  pthread_join(thread, NULL);
+  close(fds[0]);
+
+  for (int i = 0; i < CODES; ++i) {
+    free_code(&codes[i]);
+  }
+  free(codes);
+  return 0;
+}
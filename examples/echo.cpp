@@ -28,13 +28,12 @@ void print_error(int error) {
 }
 
 void run_code(CodeStream &cs) {
-  code_t cmd;
+  Code code;
   int res;
   char buf[1024];
 
   while (true) {
-    res = cs.pop(&cmd);
-    Code code(std::move(cmd));
+    res = cs.pop(code);
 
     if (res == SCODE_ERROR_BUFFER) {
       return;
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <scode_file.h>
+
+static void usage(const char *name) {
+  fprintf(stderr, "usage: %s [-j threads | -s] [-h | -b] file\n", name);
+  fprintf(stderr, "  -j  number of threads (default: one per core)\n");
+  fprintf(stderr, "  -s  read the codes one at a time from the file\n");
+  fprintf(stderr, "  -h  write the codes to stdout as human codes\n");
+  fprintf(stderr, "  -b  write the codes to stdout as binary codes\n");
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Read the codes straight out of the file without keeping them
+static int read_sequential(const char *path) {
+  code_file_t file;
+  double start = now();
+  if (init_code_file(&file, path) < 0) {
+    perror(path);
+    free_code_file(&file);
+    return 1;
+  }
+  size_t num_codes = 0, num_errors = 0;
+  code_view_t code;
+  int res;
+  while ((res = code_file_pop_view(&file, &code)) != SCODE_ERROR_BUFFER) {
+    if (res < 0) {
+      num_errors++;
+    } else {
+      num_codes++;
+    }
+  }
+  double elapsed = now() - start;
+  fprintf(stderr, "%zu codes, %zu errors in %.3f s\n", num_codes, num_errors,
+          elapsed);
+  free_code_file(&file);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t threads = 0;
+  char output = 0;
+  int sequential = 0;
+  const char *path = NULL;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      threads = strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-s") == 0) {
+      sequential = 1;
+    } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-b") == 0) {
+      output = argv[i][1];
+    } else if (argv[i][0] != '-' && path == NULL) {
+      path = argv[i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (path == NULL) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (sequential) {
+    return read_sequential(path);
+  }
+
+  scode_codes_t codes;
+  double start = now();
+  int res = scode_parse_file_parallel(&codes, path, threads);
+  double elapsed = now() - start;
+  if (res == SCODE_ERROR_FILE) {
+    perror(path);
+    return 1;
+  }
+  if (res < 0) {
+    fprintf(stderr, "%s: failed to parse (%d)\n", path, res);
+    return 1;
+  }
+  fprintf(stderr, "%zu codes, %zu errors in %.3f s\n", codes.num_codes,
+          codes.num_errors, elapsed);
+
+  if (output != 0) {
+    char buf[4096];
+    for (size_t i = 0; i < codes.num_codes; ++i) {
+      res = output == 'h' ? code_dump_human(&codes.codes[i], buf, sizeof(buf))
+                          : code_dump_binary(&codes.codes[i], buf, sizeof(buf));
+      if (res < 0) {
+        fprintf(stderr, "code %zu could not be written (%d)\n", i, res);
+        continue;
+      }
+      fwrite(buf, 1, res, stdout);
+    }
+  }
+
+  free_scode_codes(&codes);
+  return 0;
+}
@@ -1,10 +1,31 @@
 #include "scode.h"
 
 #include <ctype.h>
+#include <float.h>
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
+#define MAX(a, b) ((a) > (b) ? (a) : (b))
+
+// Everything that uses the heap goes through these, so that it can be left out
+#if defined(SCODE_NO_MALLOC)
+static inline void *scode_malloc(size_t size) {
+  (void)size;
+  return NULL;
+}
+static inline void *scode_realloc(void *ptr, size_t size) {
+  (void)ptr;
+  (void)size;
+  return NULL;
+}
+static inline void scode_free(void *ptr) { (void)ptr; }
+#else
+#define scode_malloc malloc
+#define scode_realloc realloc
+#define scode_free free
+#endif
 
 #define BUF_ASSERT_LEN(len, min)                                               \
   if ((len) < (min))                                                           \
@@ -62,19 +83,38 @@ static const uint8_t crc_lookup[256] = {
     0xFA, 0xFD, 0xF4, 0xF3,
 };
 
-uint8_t crc_calc(const char *buf, size_t len, uint8_t crc) {
-  uint8_t val = 0;
+static uint8_t crc_update_table(uint8_t val, const char *buf, size_t len) {
   for (size_t i = 0; i < len; ++i) {
     val = crc_lookup[val ^ ((uint8_t)buf[i])];
   }
-  return val ^ crc;
+  return val;
 }
 
-#else
+uint8_t crc_calc_table(const char *buf, size_t len, uint8_t crc) {
+  return crc_update_table(0, buf, len) ^ crc;
+}
 
-uint8_t crc_calc(const char *buf, size_t len, uint8_t crc) {
+#endif
+
+#ifndef CRC_TABLE
+static uint8_t crc_update_bitwise(uint8_t val, const char *buf, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    val ^= (uint8_t)buf[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      val = (val & 0x80) ? (val << 1) ^ 0x07 : (val << 1);
+    }
+  }
+  return val;
+}
+#endif
+
+uint8_t crc_calc_bitwise(const char *buf, size_t len, uint8_t crc) {
 #define DIVISOR(pos) (0x107 << ((pos)-8))
 
+  if (len == 0) {
+    return crc;
+  }
+
   uint16_t data = buf[0] & 0x00FF;
   size_t pos = 1;
   size_t i = 15;
@@ -100,8 +140,466 @@ uint8_t crc_calc(const char *buf, size_t len, uint8_t crc) {
   }
 }
 
+#if SCODE_CRC_FAST
+
+// crc_slice[n][b] is the crc of the byte b followed by n null bytes
+static uint8_t crc_slice[8][256];
+
+static uint8_t crc_update_slice8(uint8_t val, const char *buf, size_t len) {
+  const uint8_t *b = (const uint8_t *)buf;
+  while (len >= 8) {
+    val = crc_slice[7][b[0] ^ val] ^ crc_slice[6][b[1]] ^ crc_slice[5][b[2]] ^
+          crc_slice[4][b[3]] ^ crc_slice[3][b[4]] ^ crc_slice[2][b[5]] ^
+          crc_slice[1][b[6]] ^ crc_slice[0][b[7]];
+    b += 8;
+    len -= 8;
+  }
+  return crc_update_table(val, (const char *)b, len);
+}
+
+uint8_t crc_calc_slice8(const char *buf, size_t len, uint8_t crc) {
+  return crc_update_slice8(0, buf, len) ^ crc;
+}
+
+// Remainder of x^n / P
+static uint64_t crc_xpow(unsigned n) {
+  uint16_t r = 1;
+  while (n-- > 0) {
+    r <<= 1;
+    if (r & 0x100) {
+      r ^= 0x107;
+    }
+  }
+  return r;
+}
+
+/*
+ * Carry-less multiply folding
+ *
+ * The message is read 16 bytes at a time as a 128 bit polynomial with the
+ * first byte as the highest degree. Four accumulators are each multiplied by
+ * x^512 (mod P) and the next block is added, which keeps them congruent to the
+ * message that has been read so far. Finally, the accumulators are reduced to
+ * 64 bits, and a Barrett reduction gives the 8 bit remainder.
+ */
+static struct {
+  uint64_t fold4[2]; // x^576, x^512
+  uint64_t fold1[2]; // x^192, x^128
+  uint64_t x64;      // x^64
+  uint64_t mu;       // x^72 / P without the x^64 term
+} crc_clmul_k;
+
+static int crc_has_clmul = 0;
+
+// Find the remainder of (t * x^8) / P
+static uint8_t crc_barrett(uint64_t t, uint64_t hi) {
+  uint64_t q = t ^ hi;
+  return (uint8_t)(q ^ (q << 1) ^ (q << 2));
+}
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRC_CLMUL __attribute__((target("pclmul,ssse3")))
+
+CRC_CLMUL static inline __m128i crc_fold(__m128i x, __m128i k) {
+  return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11),
+                       _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+CRC_CLMUL static uint8_t crc_update_clmul(uint8_t val, const char *buf,
+                                          size_t len) {
+  if (len < 64) {
+    return crc_update_slice8(val, buf, len);
+  }
+  const __m128i rev =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+#define CRC_LOAD(i)                                                            \
+  _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(buf + (i))), rev)
+
+  __m128i x0 =
+      _mm_xor_si128(CRC_LOAD(0), _mm_set_epi64x((uint64_t)val << 56, 0));
+  __m128i x1 = CRC_LOAD(16);
+  __m128i x2 = CRC_LOAD(32);
+  __m128i x3 = CRC_LOAD(48);
+  buf += 64;
+  len -= 64;
+
+  __m128i k = _mm_set_epi64x(crc_clmul_k.fold4[0], crc_clmul_k.fold4[1]);
+  while (len >= 64) {
+    x0 = _mm_xor_si128(crc_fold(x0, k), CRC_LOAD(0));
+    x1 = _mm_xor_si128(crc_fold(x1, k), CRC_LOAD(16));
+    x2 = _mm_xor_si128(crc_fold(x2, k), CRC_LOAD(32));
+    x3 = _mm_xor_si128(crc_fold(x3, k), CRC_LOAD(48));
+    buf += 64;
+    len -= 64;
+  }
+
+  k = _mm_set_epi64x(crc_clmul_k.fold1[0], crc_clmul_k.fold1[1]);
+  x1 = _mm_xor_si128(crc_fold(x0, k), x1);
+  x2 = _mm_xor_si128(crc_fold(x1, k), x2);
+  x3 = _mm_xor_si128(crc_fold(x2, k), x3);
+  while (len >= 16) {
+    x3 = _mm_xor_si128(crc_fold(x3, k), CRC_LOAD(0));
+    buf += 16;
+    len -= 16;
+  }
+#undef CRC_LOAD
+
+  // 128 -> 72 -> 64 bits
+  k = _mm_set_epi64x(crc_clmul_k.x64, crc_clmul_k.mu);
+  x3 = _mm_xor_si128(_mm_clmulepi64_si128(x3, k, 0x11), _mm_move_epi64(x3));
+  x3 = _mm_xor_si128(_mm_clmulepi64_si128(x3, k, 0x11), _mm_move_epi64(x3));
+  __m128i hi = _mm_srli_si128(_mm_clmulepi64_si128(x3, k, 0x00), 8);
+  val = crc_barrett(_mm_cvtsi128_si64(x3), _mm_cvtsi128_si64(hi));
+  return crc_update_table(val, buf, len);
+}
+
+static int crc_clmul_detect(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+#include <arm_neon.h>
+
+static inline uint64x2_t crc_mul(uint64_t a, uint64_t b) {
+  return vreinterpretq_u64_p128(vmull_p64((poly64_t)a, (poly64_t)b));
+}
+
+static inline uint64x2_t crc_fold(uint64x2_t x, const uint64_t *k) {
+  return veorq_u64(crc_mul(vgetq_lane_u64(x, 1), k[0]),
+                   crc_mul(vgetq_lane_u64(x, 0), k[1]));
+}
+
+static inline uint64x2_t crc_load(const char *buf) {
+  uint8x16_t v = vrev64q_u8(vld1q_u8((const uint8_t *)buf));
+  return vreinterpretq_u64_u8(vextq_u8(v, v, 8));
+}
+
+static uint8_t crc_update_clmul(uint8_t val, const char *buf, size_t len) {
+  if (len < 64) {
+    return crc_update_slice8(val, buf, len);
+  }
+  uint64x2_t x0 =
+      veorq_u64(crc_load(buf), vcombine_u64(vcreate_u64(0),
+                                            vcreate_u64((uint64_t)val << 56)));
+  uint64x2_t x1 = crc_load(buf + 16);
+  uint64x2_t x2 = crc_load(buf + 32);
+  uint64x2_t x3 = crc_load(buf + 48);
+  buf += 64;
+  len -= 64;
+
+  while (len >= 64) {
+    x0 = veorq_u64(crc_fold(x0, crc_clmul_k.fold4), crc_load(buf));
+    x1 = veorq_u64(crc_fold(x1, crc_clmul_k.fold4), crc_load(buf + 16));
+    x2 = veorq_u64(crc_fold(x2, crc_clmul_k.fold4), crc_load(buf + 32));
+    x3 = veorq_u64(crc_fold(x3, crc_clmul_k.fold4), crc_load(buf + 48));
+    buf += 64;
+    len -= 64;
+  }
+
+  x1 = veorq_u64(crc_fold(x0, crc_clmul_k.fold1), x1);
+  x2 = veorq_u64(crc_fold(x1, crc_clmul_k.fold1), x2);
+  x3 = veorq_u64(crc_fold(x2, crc_clmul_k.fold1), x3);
+  while (len >= 16) {
+    x3 = veorq_u64(crc_fold(x3, crc_clmul_k.fold1), crc_load(buf));
+    buf += 16;
+    len -= 16;
+  }
+
+  // 128 -> 72 -> 64 bits
+  uint64x2_t y = crc_mul(vgetq_lane_u64(x3, 1), crc_clmul_k.x64);
+  uint64_t t = vgetq_lane_u64(y, 0) ^ vgetq_lane_u64(x3, 0);
+  t ^= vgetq_lane_u64(crc_mul(vgetq_lane_u64(y, 1), crc_clmul_k.x64), 0);
+  uint64_t hi = vgetq_lane_u64(crc_mul(t, crc_clmul_k.mu), 1);
+  val = crc_barrett(t, hi);
+  return crc_update_table(val, buf, len);
+}
+
+static int crc_clmul_detect(void) { return 1; }
+
+#else
+
+static uint8_t crc_update_clmul(uint8_t val, const char *buf, size_t len) {
+  return crc_update_slice8(val, buf, len);
+}
+
+static int crc_clmul_detect(void) { return 0; }
+
+#endif
+
+uint8_t crc_calc_clmul(const char *buf, size_t len, uint8_t crc) {
+  return crc_update_clmul(0, buf, len) ^ crc;
+}
+
+int crc_clmul_supported(void) { return crc_has_clmul; }
+
+__attribute__((constructor)) static void crc_init(void) {
+  for (int b = 0; b < 256; ++b) {
+    crc_slice[0][b] = crc_lookup[b];
+    for (int n = 1; n < 8; ++n) {
+      crc_slice[n][b] = crc_lookup[crc_slice[n - 1][b]];
+    }
+  }
+
+  crc_clmul_k.fold4[0] = crc_xpow(576);
+  crc_clmul_k.fold4[1] = crc_xpow(512);
+  crc_clmul_k.fold1[0] = crc_xpow(192);
+  crc_clmul_k.fold1[1] = crc_xpow(128);
+  crc_clmul_k.x64 = crc_xpow(64);
+  // Long division of x^72 by P
+  unsigned __int128 rem = (unsigned __int128)1 << 72;
+  uint64_t mu = 0;
+  for (int i = 72; i >= 8; --i) {
+    if ((rem >> i) & 1) {
+      rem ^= (unsigned __int128)0x107 << (i - 8);
+      if (i - 8 < 64) {
+        mu |= (uint64_t)1 << (i - 8);
+      }
+    }
+  }
+  crc_clmul_k.mu = mu;
+
+  crc_has_clmul = crc_clmul_detect();
+}
+
+// Short runs are faster with a single table lookup per byte
+static uint8_t crc_update(uint8_t val, const char *buf, size_t len) {
+  if (len < 16) {
+    return crc_update_table(val, buf, len);
+  }
+  if (crc_has_clmul) {
+    return crc_update_clmul(val, buf, len);
+  }
+  return crc_update_slice8(val, buf, len);
+}
+
+#elif defined(CRC_TABLE)
+#define crc_update crc_update_table
+#else
+#define crc_update crc_update_bitwise
+#endif
+
+uint8_t crc_calc(const char *buf, size_t len, uint8_t crc) {
+  return crc_update(0, buf, len) ^ crc;
+}
+
+// CRC-16/XMODEM, poly 0x1021
+static const uint16_t crc16_lookup[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0,
+};
+
+static uint16_t crc16_update(uint16_t val, const char *buf, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    val = (val << 8) ^ crc16_lookup[(val >> 8) ^ (uint8_t)buf[i]];
+  }
+  return val;
+}
+
+uint16_t crc16_calc(const char *buf, size_t len, uint16_t crc) {
+  return crc16_update(0, buf, len) ^ crc;
+}
+
+// CRC-32C (Castagnoli), reflected poly 0x82F63B78
+static const uint32_t crc32c_lookup[256] = {
+    0x00000000, 0xF26B8303, 0xE13B70F7, 0x1350F3F4, 0xC79A971F, 0x35F1141C,
+    0x26A1E7E8, 0xD4CA64EB, 0x8AD958CF, 0x78B2DBCC, 0x6BE22838, 0x9989AB3B,
+    0x4D43CFD0, 0xBF284CD3, 0xAC78BF27, 0x5E133C24, 0x105EC76F, 0xE235446C,
+    0xF165B798, 0x030E349B, 0xD7C45070, 0x25AFD373, 0x36FF2087, 0xC494A384,
+    0x9A879FA0, 0x68EC1CA3, 0x7BBCEF57, 0x89D76C54, 0x5D1D08BF, 0xAF768BBC,
+    0xBC267848, 0x4E4DFB4B, 0x20BD8EDE, 0xD2D60DDD, 0xC186FE29, 0x33ED7D2A,
+    0xE72719C1, 0x154C9AC2, 0x061C6936, 0xF477EA35, 0xAA64D611, 0x580F5512,
+    0x4B5FA6E6, 0xB93425E5, 0x6DFE410E, 0x9F95C20D, 0x8CC531F9, 0x7EAEB2FA,
+    0x30E349B1, 0xC288CAB2, 0xD1D83946, 0x23B3BA45, 0xF779DEAE, 0x05125DAD,
+    0x1642AE59, 0xE4292D5A, 0xBA3A117E, 0x4851927D, 0x5B016189, 0xA96AE28A,
+    0x7DA08661, 0x8FCB0562, 0x9C9BF696, 0x6EF07595, 0x417B1DBC, 0xB3109EBF,
+    0xA0406D4B, 0x522BEE48, 0x86E18AA3, 0x748A09A0, 0x67DAFA54, 0x95B17957,
+    0xCBA24573, 0x39C9C670, 0x2A993584, 0xD8F2B687, 0x0C38D26C, 0xFE53516F,
+    0xED03A29B, 0x1F682198, 0x5125DAD3, 0xA34E59D0, 0xB01EAA24, 0x42752927,
+    0x96BF4DCC, 0x64D4CECF, 0x77843D3B, 0x85EFBE38, 0xDBFC821C, 0x2997011F,
+    0x3AC7F2EB, 0xC8AC71E8, 0x1C661503, 0xEE0D9600, 0xFD5D65F4, 0x0F36E6F7,
+    0x61C69362, 0x93AD1061, 0x80FDE395, 0x72966096, 0xA65C047D, 0x5437877E,
+    0x4767748A, 0xB50CF789, 0xEB1FCBAD, 0x197448AE, 0x0A24BB5A, 0xF84F3859,
+    0x2C855CB2, 0xDEEEDFB1, 0xCDBE2C45, 0x3FD5AF46, 0x7198540D, 0x83F3D70E,
+    0x90A324FA, 0x62C8A7F9, 0xB602C312, 0x44694011, 0x5739B3E5, 0xA55230E6,
+    0xFB410CC2, 0x092A8FC1, 0x1A7A7C35, 0xE811FF36, 0x3CDB9BDD, 0xCEB018DE,
+    0xDDE0EB2A, 0x2F8B6829, 0x82F63B78, 0x709DB87B, 0x63CD4B8F, 0x91A6C88C,
+    0x456CAC67, 0xB7072F64, 0xA457DC90, 0x563C5F93, 0x082F63B7, 0xFA44E0B4,
+    0xE9141340, 0x1B7F9043, 0xCFB5F4A8, 0x3DDE77AB, 0x2E8E845F, 0xDCE5075C,
+    0x92A8FC17, 0x60C37F14, 0x73938CE0, 0x81F80FE3, 0x55326B08, 0xA759E80B,
+    0xB4091BFF, 0x466298FC, 0x1871A4D8, 0xEA1A27DB, 0xF94AD42F, 0x0B21572C,
+    0xDFEB33C7, 0x2D80B0C4, 0x3ED04330, 0xCCBBC033, 0xA24BB5A6, 0x502036A5,
+    0x4370C551, 0xB11B4652, 0x65D122B9, 0x97BAA1BA, 0x84EA524E, 0x7681D14D,
+    0x2892ED69, 0xDAF96E6A, 0xC9A99D9E, 0x3BC21E9D, 0xEF087A76, 0x1D63F975,
+    0x0E330A81, 0xFC588982, 0xB21572C9, 0x407EF1CA, 0x532E023E, 0xA145813D,
+    0x758FE5D6, 0x87E466D5, 0x94B49521, 0x66DF1622, 0x38CC2A06, 0xCAA7A905,
+    0xD9F75AF1, 0x2B9CD9F2, 0xFF56BD19, 0x0D3D3E1A, 0x1E6DCDEE, 0xEC064EED,
+    0xC38D26C4, 0x31E6A5C7, 0x22B65633, 0xD0DDD530, 0x0417B1DB, 0xF67C32D8,
+    0xE52CC12C, 0x1747422F, 0x49547E0B, 0xBB3FFD08, 0xA86F0EFC, 0x5A048DFF,
+    0x8ECEE914, 0x7CA56A17, 0x6FF599E3, 0x9D9E1AE0, 0xD3D3E1AB, 0x21B862A8,
+    0x32E8915C, 0xC083125F, 0x144976B4, 0xE622F5B7, 0xF5720643, 0x07198540,
+    0x590AB964, 0xAB613A67, 0xB831C993, 0x4A5A4A90, 0x9E902E7B, 0x6CFBAD78,
+    0x7FAB5E8C, 0x8DC0DD8F, 0xE330A81A, 0x115B2B19, 0x020BD8ED, 0xF0605BEE,
+    0x24AA3F05, 0xD6C1BC06, 0xC5914FF2, 0x37FACCF1, 0x69E9F0D5, 0x9B8273D6,
+    0x88D28022, 0x7AB90321, 0xAE7367CA, 0x5C18E4C9, 0x4F48173D, 0xBD23943E,
+    0xF36E6F75, 0x0105EC76, 0x12551F82, 0xE03E9C81, 0x34F4F86A, 0xC69F7B69,
+    0xD5CF889D, 0x27A40B9E, 0x79B737BA, 0x8BDCB4B9, 0x988C474D, 0x6AE7C44E,
+    0xBE2DA0A5, 0x4C4623A6, 0x5F16D052, 0xAD7D5351,
+};
+
+// The register is kept inverted between updates, so that the CRC of nothing is
+// 0 like the other CRCs, and an update can start from the result of the last
+static uint32_t crc32c_update_table(uint32_t val, const char *buf,
+                                    size_t len) {
+  uint32_t c = ~val;
+  for (size_t i = 0; i < len; ++i) {
+    c = (c >> 8) ^ crc32c_lookup[(c ^ (uint8_t)buf[i]) & 0xFF];
+  }
+  return ~c;
+}
+
+uint32_t crc32c_calc_table(const char *buf, size_t len, uint32_t crc) {
+  return crc32c_update_table(0, buf, len) ^ crc;
+}
+
+#if SCODE_CRC_FAST && defined(__x86_64__)
+#include <nmmintrin.h>
+
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_update_hw(uint32_t val, const char *buf, size_t len) {
+  uint64_t c = ~val;
+  for (; len >= 8; buf += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, buf, 8);
+    c = _mm_crc32_u64(c, word);
+  }
+  uint32_t c32 = c;
+  for (; len > 0; ++buf, --len) {
+    c32 = _mm_crc32_u8(c32, *buf);
+  }
+  return ~c32;
+}
+
+static int crc32c_detect(void) {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+#elif SCODE_CRC_FAST && defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+
+static uint32_t crc32c_update_hw(uint32_t val, const char *buf, size_t len) {
+  uint32_t c = ~val;
+  for (; len >= 8; buf += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, buf, 8);
+    c = __crc32cd(c, word);
+  }
+  for (; len > 0; ++buf, --len) {
+    c = __crc32cb(c, *buf);
+  }
+  return ~c;
+}
+
+static int crc32c_detect(void) { return 1; }
+
+#else
+
+static uint32_t crc32c_update_hw(uint32_t val, const char *buf, size_t len) {
+  return crc32c_update_table(val, buf, len);
+}
+
+static int crc32c_detect(void) { return 0; }
+
+#endif
+
+static int crc32c_has_hw = 0;
+
+#if SCODE_CRC_FAST
+__attribute__((constructor)) static void crc32c_init(void) {
+  crc32c_has_hw = crc32c_detect();
+}
 #endif
 
+int crc32c_hw_supported(void) { return crc32c_has_hw; }
+
+uint32_t crc32c_calc_hw(const char *buf, size_t len, uint32_t crc) {
+  return crc32c_update_hw(0, buf, len) ^ crc;
+}
+
+static uint32_t crc32c_update(uint32_t val, const char *buf, size_t len) {
+  if (crc32c_hw_supported()) {
+    return crc32c_update_hw(val, buf, len);
+  }
+  return crc32c_update_table(val, buf, len);
+}
+
+uint32_t crc32c_calc(const char *buf, size_t len, uint32_t crc) {
+  return crc32c_update(0, buf, len) ^ crc;
+}
+
+// Number of bytes in a checksum, where anything that isn't one of the
+// SCODE_CHECKSUM_X values is a CRC-8
+static uint8_t checksum_width(uint8_t checksum) {
+  if (checksum == SCODE_CHECKSUM_CRC16 || checksum == SCODE_CHECKSUM_CRC32C) {
+    return checksum;
+  }
+  return SCODE_CHECKSUM_CRC8;
+}
+
+// Update the checksum of a binary code
+static uint32_t checksum_update(uint8_t checksum, uint32_t val,
+                                const char *buf, size_t len) {
+  switch (checksum) {
+  case SCODE_CHECKSUM_CRC16:
+    return crc16_update(val, buf, len);
+  case SCODE_CHECKSUM_CRC32C:
+    return crc32c_update(val, buf, len);
+  }
+  return crc_update(val, buf, len);
+}
+
+// Write the null and the checksum that end a binary code of pos bytes
+static size_t checksum_write(uint8_t checksum, char *buf, size_t pos) {
+  uint32_t crc = checksum_update(checksum, 0, buf, pos);
+  buf[pos++] = '\0';
+  for (int i = 0; i < checksum; ++i) {
+    buf[pos++] = crc >> (8 * i);
+  }
+  return pos;
+}
+
 uint16_t swap_endian_16(uint16_t i) {
   return ((i & 0xFF00) >> 8) | ((i & 0x00FF) << 8);
 }
@@ -120,65 +618,315 @@ uint64_t swap_endian_64(uint64_t i) {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Delimiters are found 8, 16 or 32 bytes at a time. Define SCAN_SWAR to use the
+// portable version on any target.
+
+#define SCAN_ONES 0x0101010101010101ull
+#define SCAN_HIGHS 0x8080808080808080ull
+
+static size_t scan_bytes(const char *buf, size_t i, size_t len, uint8_t a,
+                         uint8_t b, uint8_t c) {
+  for (; i < len; ++i) {
+    uint8_t x = buf[i];
+    if (x == a || x == b || x == c) {
+      break;
+    }
+  }
+  return i;
+}
+
+#if defined(__x86_64__) && !defined(SCAN_SWAR)
+#include <immintrin.h>
+
+static int scan_has_avx2;
+
+static size_t scan_sse2(const char *buf, size_t i, size_t len, uint8_t a,
+                        uint8_t b, uint8_t c) {
+  __m128i va = _mm_set1_epi8(a);
+  __m128i vb = _mm_set1_epi8(b);
+  __m128i vc = _mm_set1_epi8(c);
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+    __m128i m = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)),
+        _mm_cmpeq_epi8(v, vc));
+    int mask = _mm_movemask_epi8(m);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return scan_bytes(buf, i, len, a, b, c);
+}
+
+__attribute__((target("avx2"))) static size_t
+scan_avx2(const char *buf, size_t i, size_t len, uint8_t a, uint8_t b,
+          uint8_t c) {
+  __m256i va = _mm256_set1_epi8(a);
+  __m256i vb = _mm256_set1_epi8(b);
+  __m256i vc = _mm256_set1_epi8(c);
+  for (; i + 32 <= len; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(buf + i));
+    __m256i m = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)),
+        _mm256_cmpeq_epi8(v, vc));
+    uint32_t mask = _mm256_movemask_epi8(m);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return scan_sse2(buf, i, len, a, b, c);
+}
+
+__attribute__((constructor)) static void scan_init(void) {
+  __builtin_cpu_init();
+  scan_has_avx2 = __builtin_cpu_supports("avx2");
+}
+
+#elif defined(__aarch64__) && !defined(SCAN_SWAR)
+#include <arm_neon.h>
+
+static size_t scan_neon(const char *buf, size_t i, size_t len, uint8_t a,
+                        uint8_t b, uint8_t c) {
+  uint8x16_t va = vdupq_n_u8(a);
+  uint8x16_t vb = vdupq_n_u8(b);
+  uint8x16_t vc = vdupq_n_u8(c);
+  for (; i + 16 <= len; i += 16) {
+    uint8x16_t v = vld1q_u8((const uint8_t *)(buf + i));
+    uint8x16_t m =
+        vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)), vceqq_u8(v, vc));
+    // Narrow each byte of the mask into a nibble
+    uint64_t mask = vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    if (mask != 0) {
+      return i + (__builtin_ctzll(mask) >> 2);
+    }
+  }
+  return scan_bytes(buf, i, len, a, b, c);
+}
+
+#else
+
+// Set the high bit of every byte in x that is zero. Bytes above a zero byte
+// may be false positives, so only the first match is exact.
+static uint64_t scan_zeros(uint64_t x) {
+  return (x - SCAN_ONES) & ~x & SCAN_HIGHS;
+}
+
+static size_t scan_swar(const char *buf, size_t i, size_t len, uint8_t a,
+                        uint8_t b, uint8_t c) {
+  uint64_t wa = SCAN_ONES * a;
+  uint64_t wb = SCAN_ONES * b;
+  uint64_t wc = SCAN_ONES * c;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t x;
+    memcpy(&x, buf + i, 8);
+    if (scan_zeros(x ^ wa) | scan_zeros(x ^ wb) | scan_zeros(x ^ wc)) {
+      // Let the byte loop find which one matched so that the byte order
+      // doesn't matter
+      break;
+    }
+  }
+  return scan_bytes(buf, i, len, a, b, c);
+}
+
+#endif
+
+/**
+ * Find the next occurrence of any of three bytes
+ *
+ * @param i index to start at
+ * @param len length of the buffer
+ *
+ * @return index of the first match, or len if there are none
+ */
+static size_t scan_delim(const char *buf, size_t i, size_t len, uint8_t a,
+                         uint8_t b, uint8_t c) {
+#if defined(__x86_64__) && !defined(SCAN_SWAR)
+  if (scan_has_avx2) {
+    return scan_avx2(buf, i, len, a, b, c);
+  }
+  return scan_sse2(buf, i, len, a, b, c);
+#elif defined(__aarch64__) && !defined(SCAN_SWAR)
+  return scan_neon(buf, i, len, a, b, c);
+#else
+  return scan_swar(buf, i, len, a, b, c);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+#define ARENA_ALIGN 8
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+static struct scode_arena_block *arena_block(size_t cap) {
+  struct scode_arena_block *block =
+      scode_malloc(ARENA_ALIGN_UP(sizeof(struct scode_arena_block)) + cap);
+  if (block != NULL) {
+    block->next = NULL;
+    block->cap = cap;
+  }
+  return block;
+}
+
+scode_arena_t init_scode_arena(size_t capacity) {
+  scode_arena_t arena;
+  arena.used = 0;
+  arena.flags = 0;
+  arena.head = capacity > 0 ? arena_block(capacity) : NULL;
+  return arena;
+}
+
+scode_arena_t init_scode_arena_static(void *buf, size_t size) {
+  scode_arena_t arena;
+  arena.used = 0;
+  arena.flags = ARENA_FLAG_STATIC;
+  arena.head = NULL;
+  size_t skip = ARENA_ALIGN_UP((uintptr_t)buf) - (uintptr_t)buf;
+  size_t header = ARENA_ALIGN_UP(sizeof(struct scode_arena_block));
+  if (buf != NULL && size > skip + header) {
+    arena.head = (struct scode_arena_block *)((char *)buf + skip);
+    arena.head->next = NULL;
+    arena.head->cap = size - skip - header;
+  }
+  return arena;
+}
+
+void free_scode_arena(scode_arena_t *self) {
+  if (self->flags & ARENA_FLAG_STATIC) {
+    self->head = NULL;
+    self->used = 0;
+    return;
+  }
+  while (self->head != NULL) {
+    struct scode_arena_block *next = self->head->next;
+    scode_free(self->head);
+    self->head = next;
+  }
+  self->used = 0;
+}
+
+void scode_arena_reset(scode_arena_t *self) {
+  self->used = 0;
+  if (self->head == NULL || self->head->next == NULL) {
+    return;
+  }
+  // Replace the blocks with a single block that is big enough for everything
+  // that was allocated, so that the next batch won't need to grow.
+  size_t cap = 0;
+  for (struct scode_arena_block *b = self->head; b != NULL; b = b->next) {
+    cap += b->cap;
+  }
+  free_scode_arena(self);
+  self->head = arena_block(cap);
+}
+
+void *scode_arena_alloc(scode_arena_t *self, size_t size) {
+  size_t start = ARENA_ALIGN_UP(self->used);
+  if (self->head == NULL || start + size > self->head->cap) {
+    if (self->flags & ARENA_FLAG_STATIC) {
+      return NULL;
+    }
+    size_t cap = self->head == NULL ? ARENA_BLOCK_SIZE : self->head->cap * 2;
+    struct scode_arena_block *block = arena_block(MAX(cap, size));
+    if (block == NULL) {
+      return NULL;
+    }
+    block->next = self->head;
+    self->head = block;
+    start = 0;
+  }
+  self->used = start + size;
+  return (char *)self->head + ARENA_ALIGN_UP(sizeof(struct scode_arena_block)) +
+         start;
+}
+
+// Allocate from the arena if there is one, or the heap
+static void *scode_alloc(scode_arena_t *arena, size_t size) {
+  if (arena != NULL) {
+    return scode_arena_alloc(arena, size);
+  }
+  return scode_malloc(size);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 param_t init_param_u8(char param, uint8_t val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_U8 << 5);
   p.u8 = val;
   return p;
 }
 
 param_t init_param_i8(char param, int8_t val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_I8 << 5);
   p.i8 = val;
   return p;
 }
 
 param_t init_param_i16(char param, int16_t val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_I16 << 5);
   p.i16 = val;
   return p;
 }
 
 param_t init_param_i32(char param, int32_t val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_I32 << 5);
   p.i32 = val;
   return p;
 }
 
 param_t init_param_i64(char param, int64_t val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_I64 << 5);
   p.i64 = val;
   return p;
 }
 
 param_t init_param_f32(char param, float val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_F32 << 5);
   p.f32 = val;
   return p;
 }
 
 param_t init_param_f64(char param, double val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_F64 << 5);
   p.f64 = val;
   return p;
 }
 
+// Make room for a string of a length plus its terminator, inside of the param
+// if it fits
+static char *param_str_alloc(param_t *self, size_t length,
+                             scode_arena_t *arena) {
+  if (length <= PARAM_SSO_LEN) {
+    self->flags |= PARAM_FLAG_INLINE;
+    return self->str_inline;
+  }
+  self->flags &= ~PARAM_FLAG_INLINE;
+  self->str = scode_alloc(arena, length + 1);
+  self->str_cap = length < UINT32_MAX ? length + 1 : UINT32_MAX;
+  return self->str;
+}
+
 param_t init_param_str(char param, const char *val) {
-  param_t p;
+  param_t p = {0};
   p.param = (param & 0b00011111) | (PARAM_T_STR << 5);
-  p.str = malloc(strlen(val) + 1);
-  strcpy(p.str, val);
+  size_t length = strlen(val);
+  char *str = param_str_alloc(&p, length, NULL);
+  if (str != NULL) {
+    memcpy(str, val, length + 1);
+  }
   return p;
 }
 
 #define CAST_PARAM                                                             \
-  switch (param_type(self)) {                                                  \
+  switch ((self->param >> 5) & 0b111) {                                        \
   case PARAM_T_I8:                                                             \
     return self->i8;                                                           \
   case PARAM_T_U8:                                                             \
@@ -210,20 +958,33 @@ char param_letter(const param_t *self) {
   return (self->param & 0b00011111) | 0b01000000;
 }
 
+const char *param_str(const param_t *self) {
+  if (param_type(self) != PARAM_T_STR) {
+    return NULL;
+  }
+  return (self->flags & PARAM_FLAG_INLINE) ? self->str_inline : self->str;
+}
+
 void free_param(param_t *self) {
-  if (param_type(self) == PARAM_T_STR && self->str != NULL) {
-    free(self->str);
+  if (param_type(self) == PARAM_T_STR &&
+      (self->flags & PARAM_FLAG_INLINE) == 0 && self->str != NULL) {
+    scode_free(self->str);
     self->str = NULL;
   }
   self->param = 0;
+  self->flags = 0;
 }
 
+// Letter after 'Z', which delta coded binary codes use for their mask
+#define PARAM_DELTA 27
+
 int param_parse_binary(param_t *self, const char *buf, size_t len) {
   int read = 0;
   self->param = BUF_AT(buf, len, 0);
+  self->flags = 0;
   char l = param_letter(self);
 
-  if (l < 'A' || l > 'Z') {
+  if (l < 'A' || l > '@' + PARAM_DELTA) {
     return SCODE_ERROR_PARSE;
   }
 
@@ -258,9 +1019,12 @@ int param_parse_binary(param_t *self, const char *buf, size_t len) {
       }
       length++;
     }
-    self->str = malloc(length + 1);
-    memcpy(self->str, &buf[1], length);
-    self->str[length] = '\0';
+    char *str = param_str_alloc(self, length, NULL);
+    if (str == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    memcpy(str, &buf[1], length);
+    str[length] = '\0';
     read = 2 + length;
     break;
   }
@@ -282,82 +1046,311 @@ int parse_string(param_t *self, const char *buf, size_t len) {
     length++;
   }
 
-  self->str = malloc(length + 1);
-  memcpy(self->str, &buf[1], length);
-  self->str[length] = '\0';
+  char *str = param_str_alloc(self, length, NULL);
+  if (str == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  memcpy(str, &buf[1], length);
+  str[length] = '\0';
   set_type(self, PARAM_T_STR);
   return length + 2;
 }
 
-int parse_number(param_t *self, const char *buf, size_t len) {
-  size_t pos = 0;
-  int is_negative = BUF_AT(buf, len, 0) == '-';
-  if (is_negative) {
-    pos++;
-  }
+#define PARSE_MAX_DIGITS 19  // Most decimal digits that always fit a uint64_t
+// Digits given to the slow path. A halfway point between two doubles has up
+// to 767 significant digits, so any digit after those only has to be known to
+// be nonzero.
+#if DBL_MANT_DIG == 53
+#define PARSE_SLOW_DIGITS 768
+#else
+#define PARSE_SLOW_DIGITS 113
+#endif
 
-  int digits = 0;
-  int precision = 0;
+static const uint64_t parse_pow10[20] = {1ull,
+                                         10ull,
+                                         100ull,
+                                         1000ull,
+                                         10000ull,
+                                         100000ull,
+                                         1000000ull,
+                                         10000000ull,
+                                         100000000ull,
+                                         1000000000ull,
+                                         10000000000ull,
+                                         100000000000ull,
+                                         1000000000000ull,
+                                         10000000000000ull,
+                                         100000000000000ull,
+                                         1000000000000000ull,
+                                         10000000000000000ull,
+                                         100000000000000000ull,
+                                         1000000000000000000ull,
+                                         10000000000000000000ull};
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define PARSE_SWAR 1
+#else
+#define PARSE_SWAR 0
+#endif
 
-  /*
-   * 0001 => 1
-   * 100000 => 1
-   * 100001 => 6
-   */
+#if PARSE_SWAR
+// Number of digits at the start of 8 bytes that have had '0' removed
+static int parse_count_digits(uint64_t v) {
+  // Adding 0x76 sets the high bit of every byte above 9. Bytes that carry
+  // already have their high bit set, and only change bytes after them.
+  uint64_t other = (v | (v + 0x7676767676767676ull)) & 0x8080808080808080ull;
+  return other == 0 ? 8 : __builtin_ctzll(other) >> 3;
+}
 
-  int64_t val = 0;
-  while (1) {
-    if (len <= pos) {
+// Convert 8 digits that have had '0' removed, with the first digit in the
+// lowest byte
+static uint32_t parse_eight_digits(uint64_t v) {
+  v = (v * 10) + (v >> 8);
+  v = (((v & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+       (((v >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >>
+      32;
+  return (uint32_t)v;
+}
+#endif
+
+/**
+ * Read a run of digits, keeping the first PARSE_MAX_DIGITS significant digits
+ *
+ * @param pos position of the first digit, updated to the end of the run
+ * @param mantissa digits that were kept
+ * @param kept number of digits added to the mantissa, including leading zeros
+ * @param sticky set if any digit that was not kept is not zero
+ *
+ * @return number of digits that were not kept
+ */
+static inline size_t parse_digits(const char *buf, size_t *pos, size_t len,
+                           uint64_t *mantissa, size_t *kept, int *sticky) {
+  uint64_t m = *mantissa;
+  size_t i = *pos;
+  size_t dropped = 0;
+#if PARSE_SWAR
+  // Up to 8 digits at a time without branching on each digit. The digits are
+  // shifted to the top so that the empty bytes become leading zeros.
+  while (i + 8 <= len && m < parse_pow10[PARSE_MAX_DIGITS - 8]) {
+    uint64_t v;
+    memcpy(&v, buf + i, 8);
+    v ^= 0x3030303030303030ull;
+    int n = parse_count_digits(v);
+    if (n == 0) {
       break;
     }
-    char c = buf[pos];
-    if (!isdigit(c)) {
+    m = m * parse_pow10[n] + parse_eight_digits(v << (64 - 8 * n));
+    *kept += n;
+    i += n;
+    if (n < 8) {
       break;
     }
-    uint8_t v = c - '0';
-    val = val * 10 + v;
-    pos++;
-    if (digits > 0 || v != 0) {
-      digits++;
+  }
+#endif
+  for (; i < len; ++i) {
+    uint8_t v = buf[i] - '0';
+    if (v > 9) {
+      break;
     }
-    if (v != 0) {
-      precision = digits;
+    if (m < parse_pow10[PARSE_MAX_DIGITS - 1]) {
+      m = m * 10 + v;
+      *kept += 1;
+    } else {
+      dropped++;
+      *sticky |= v != 0;
     }
   }
+  *mantissa = m;
+  *pos = i;
+  return dropped;
+}
 
-  if (buf[pos] == '.') {
-    double f64 = (double)val;
-    pos++;
+// Number of decimal digits in a value that isn't zero
+static int parse_num_digits(uint64_t value) {
+  int digits = ((64 - __builtin_clzll(value)) * 1233) >> 12;
+  return digits + (value >= parse_pow10[digits]);
+}
 
-    uint32_t divisor = 10;
-    while (1) {
-      if (len <= pos) {
-        break;
-      }
-      char c = buf[pos];
-      if (!isdigit(c)) {
-        break;
-      }
-      double v = c - '0';
-      f64 += v / divisor;
-      divisor *= 10;
-      pos++;
-      digits++;
-      if (v != 0) {
-        precision = digits;
+/**
+ * Convert a decimal number with strtod(). This is only used when the number
+ * can't be converted exactly with a fast path.
+ *
+ * Only the digits are given to strtod() so that the locale doesn't matter.
+ */
+static double parse_slow(const char *buf, size_t len, int is_f32) {
+  char tmp[PARSE_SLOW_DIGITS + 24];
+  size_t n = 0;
+  int64_t exponent = 0;
+  int fraction = 0;
+  int dropped = 0; // whether a nonzero digit was dropped
+  for (size_t i = 0; i < len; ++i) {
+    if (buf[i] == '.') {
+      fraction = 1;
+    } else if (n == 0 && buf[i] == '0') {
+      exponent -= fraction;
+    } else if (n < PARSE_SLOW_DIGITS) {
+      tmp[n++] = buf[i];
+      exponent -= fraction;
+    } else {
+      exponent += !fraction;
+      dropped |= buf[i] != '0';
+    }
+  }
+  if (n == 0) {
+    return 0.0;
+  }
+  // A sticky digit keeps the value above a halfway point that it was above
+  if (dropped) {
+    tmp[n++] = '1';
+    exponent--;
+  }
+  tmp[n++] = 'e';
+  if (exponent < 0) {
+    tmp[n++] = '-';
+    exponent = -exponent;
+  }
+  char digits[20];
+  size_t num_digits = 0;
+  do {
+    digits[num_digits++] = '0' + exponent % 10;
+    exponent /= 10;
+  } while (exponent > 0);
+  while (num_digits > 0) {
+    tmp[n++] = digits[--num_digits];
+  }
+  tmp[n] = '\0';
+#if DBL_MANT_DIG == 53
+  if (is_f32) {
+    return strtof(tmp, NULL);
+  }
+#endif
+  return strtod(tmp, NULL);
+}
+
+// Floats are parsed with a single float operation when it isn't done in a
+// wider type. Doubles need that too, and they need to be 64 bit, which they
+// aren't on AVR.
+#if FLT_EVAL_METHOD == 0 || FLT_EVAL_METHOD == 16
+#define PARSE_FAST_F32 1
+
+static const float parse_pow10_f32[11] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                          1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+
+// Move trailing zeros of a mantissa that is too big into the exponent
+static void parse_trim(uint64_t *mantissa, int64_t *exponent, uint64_t limit) {
+  while (*mantissa > limit && *mantissa % 10 == 0) {
+    *mantissa /= 10;
+    *exponent += 1;
+  }
+}
+#else
+#define PARSE_FAST_F32 0
+#endif
+
+#if PARSE_FAST_F32 && DBL_MANT_DIG == 53
+#define PARSE_FAST_F64 1
+
+static const double parse_pow10_f64[23] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+#else
+#define PARSE_FAST_F64 0
+#endif
+
+int parse_number(param_t *self, const char *buf, size_t len) {
+  size_t pos = 0;
+  int is_negative = BUF_AT(buf, len, 0) == '-';
+  if (is_negative) {
+    pos++;
+  }
+
+  /*
+   * Precision is the number of significant digits in the integer, plus the
+   * number of decimals up to the last one that isn't zero
+   *
+   * 0001 => 1
+   * 100000 => 1
+   * 100001 => 6
+   * 0.0012 => 4
+   */
+
+  size_t start = pos;
+  uint64_t mantissa = 0;
+  size_t kept = 0;
+  int sticky = 0;
+  size_t dropped = parse_digits(buf, &pos, len, &mantissa, &kept, &sticky);
+
+  if (pos < len && buf[pos] == '.') {
+    pos++;
+    size_t fraction = pos;
+    uint64_t whole = mantissa;
+    size_t int_kept = kept;
+    parse_digits(buf, &pos, len, &mantissa, &kept, &sticky);
+    // Every digit kept from the fraction lowers the exponent
+    int64_t exponent = (int64_t)dropped - (int64_t)(kept - int_kept);
+
+    size_t decimals = pos - fraction;
+    while (decimals > 0 && buf[fraction + decimals - 1] == '0') {
+      decimals--;
+    }
+    int64_t precision;
+    if (sticky) {
+      precision = PARSE_MAX_DIGITS + 1;
+    } else if (decimals > 0) {
+      precision = whole == 0 ? 0 : parse_num_digits(whole) + dropped;
+      precision += decimals;
+    } else {
+      while (whole != 0 && whole % 10 == 0) {
+        whole /= 10;
       }
+      precision = whole == 0 ? 0 : parse_num_digits(whole);
     }
+
     // Store as a float if less than 7 digits of precision are used.
     if (precision <= 7) {
       set_type(self, PARAM_T_F32);
-      self->f32 = (float)f64;
+#if PARSE_FAST_F32
+      // When the mantissa fits in a float, a single correctly rounded
+      // operation gives the correctly rounded result
+      parse_trim(&mantissa, &exponent, 1ull << FLT_MANT_DIG);
+      if (mantissa <= (1ull << FLT_MANT_DIG) && exponent >= -10 &&
+          exponent <= 10) {
+        float m = (float)mantissa;
+        self->f32 = exponent < 0 ? m / parse_pow10_f32[-exponent]
+                                 : m * parse_pow10_f32[exponent];
+      } else
+#endif
+      {
+        self->f32 = (float)parse_slow(buf + start, pos - start, 1);
+      }
+      if (is_negative) {
+        self->f32 = -self->f32;
+      }
     } else {
       set_type(self, PARAM_T_F64);
-      self->f64 = f64;
+#if PARSE_FAST_F64
+      parse_trim(&mantissa, &exponent, 1ull << DBL_MANT_DIG);
+      if (!sticky && mantissa <= (1ull << DBL_MANT_DIG) && exponent >= -22 &&
+          exponent <= 22) {
+        double m = (double)mantissa;
+        self->f64 = exponent < 0 ? m / parse_pow10_f64[-exponent]
+                                 : m * parse_pow10_f64[exponent];
+      } else
+#endif
+      {
+        self->f64 = parse_slow(buf + start, pos - start, 0);
+      }
+      if (is_negative) {
+        self->f64 = -self->f64;
+      }
     }
   } else {
-    if (is_negative) {
-      val = -val;
+    // Clamp integers that are too big
+    int64_t val;
+    if (dropped > 0 || mantissa > (uint64_t)INT64_MAX) {
+      val = is_negative ? INT64_MIN : INT64_MAX;
+    } else {
+      val = is_negative ? -(int64_t)mantissa : (int64_t)mantissa;
     }
     if (val >= 0 && val <= UINT8_MAX) {
       set_type(self, PARAM_T_U8);
@@ -382,6 +1375,7 @@ int parse_number(param_t *self, const char *buf, size_t len) {
 
 int param_parse_human(param_t *self, const char *buf, size_t len) {
   self->param = toupper(BUF_AT(buf, len, 0));
+  self->flags = 0;
   if (self->param > 'Z' || self->param < 'A') {
     return SCODE_ERROR_PARSE;
   }
@@ -396,36 +1390,41 @@ int param_parse_human(param_t *self, const char *buf, size_t len) {
   return res + 1;
 }
 
-int param_dump_binary(const param_t *self, char *buf, size_t len) {
-  BUF_ASSERT_LEN(len, 1);
+static size_t binary_width(uint8_t type) {
+  // Indexed by PARAM_T_X, strings have no fixed width
+  static const uint8_t widths[8] = {8, 4, 8, 4, 2, 1, 1, 0};
+  return widths[type & 0b111];
+}
+
+// Write a binary param into a buffer that is known to be big enough
+static size_t param_write_binary(const param_t *self, char *buf) {
   buf[0] = self->param;
   switch (param_type(self)) {
   case PARAM_T_U8:
   case PARAM_T_I8:
-    BUF_ASSERT_LEN(len, 2);
     memcpy(&buf[1], &self->u8, 1);
     return 2;
-  case PARAM_T_I16:
-    BUF_ASSERT_LEN(len, 3);
+  case PARAM_T_I16: {
     uint16_t u16 = htol16(self->i16);
     memcpy(&buf[1], &u16, 2);
     return 3;
+  }
   case PARAM_T_I32:
-  case PARAM_T_F32:
-    BUF_ASSERT_LEN(len, 5);
+  case PARAM_T_F32: {
     uint32_t u32 = htol32(self->i32);
     memcpy(&buf[1], &u32, 4);
     return 5;
+  }
   case PARAM_T_I64:
-  case PARAM_T_F64:
-    BUF_ASSERT_LEN(len, 9);
+  case PARAM_T_F64: {
     uint64_t u64 = htol64(self->i64);
     memcpy(&buf[1], &u64, 8);
     return 9;
+  }
   case PARAM_T_STR: {
-    uint8_t length = (uint8_t)strlen(self->str);
-    BUF_ASSERT_LEN(len, (size_t)length + 2);
-    memcpy(&buf[1], self->str, length);
+    const char *str = param_str(self);
+    uint8_t length = (uint8_t)strlen(str);
+    memcpy(&buf[1], str, length);
     buf[1 + length] = '\0';
     return length + 2;
   }
@@ -433,369 +1432,2245 @@ int param_dump_binary(const param_t *self, char *buf, size_t len) {
   return 0;
 }
 
-int format_int(int64_t value, char *buf, size_t len) {
-  size_t pos = 0;
-  int is_negative = value < 0;
-  if (is_negative) {
-    value = -value;
-    BUF_ASSERT_LEN(len, pos + 1);
-    buf[pos++] = '-';
-  }
-  char temp[20];
-  int i = 0;
-  while (value > 0) {
-    temp[i] = (value % 10) + '0';
-    value /= 10;
-    i++;
-  }
-  if (i == 0) {
-    temp[i++] = '0';
-  }
-  BUF_ASSERT_LEN(len, i + pos);
-
-  for (--i; i >= 0; --i) {
-    buf[pos++] = temp[i];
-  }
-  return pos;
+int param_dump_binary(const param_t *self, char *buf, size_t len) {
+  BUF_ASSERT_LEN(len, (size_t)UNWRAP(param_dump_binary_size(self)));
+  return param_write_binary(self, buf);
 }
 
-int param_dump_human(const param_t *self, char *buf, size_t len) {
-  char letter = param_letter(self);
-  BUF_ASSERT_LEN(len, 1);
-  buf[0] = letter;
-  size_t pos = 1;
-
+param_t param_narrow(const param_t *self) {
+  param_t p = *self;
   uint8_t type = param_type(self);
-  if (type == PARAM_T_STR) {
-    // dump string
-    size_t length = strlen(self->str);
-    int contains_single_quote = 0;
-    int contains_double_quote = 0;
-    for (size_t i = 0; i < length; ++i) {
-      if (self->str[i] == '\'') {
-        contains_single_quote = 1;
-      }
-      if (self->str[i] == '"') {
-        contains_double_quote = 1;
-      }
-      if (contains_single_quote && contains_double_quote) {
-        return SCODE_ERROR_DUMP;
-      }
+  if (type == PARAM_T_F64) {
+    // NaN is never equal to itself, so it is left alone
+    if ((double)(float)self->f64 == self->f64) {
+      set_type(&p, PARAM_T_F32);
+      p.f32 = (float)self->f64;
     }
-    char quote = contains_single_quote ? '"' : '\'';
-    BUF_ASSERT_LEN(len, length + 2 + pos);
-    buf[pos++] = quote;
-    memcpy(&buf[pos], self->str, length);
-    pos += length;
-    buf[pos++] = quote;
-  } else if (type == PARAM_T_F32 || type == PARAM_T_F64) {
-    // dump float
-    double value = param_cast_f64(self);
-    if (value < 0) {
-      BUF_ASSERT_LEN(len, pos + 1);
-      buf[pos++] = '-';
-      value = -value;
-    }
-    int64_t base = (int64_t)value;
-    value = value - base;
-    if (value > 0.9999) {
-      base += 1;
-      value -= 0.9999;
-    }
-    pos += UNWRAP(format_int(base, buf + pos, len - pos));
-
-    BUF_ASSERT_LEN(len, pos + 1);
-    buf[pos++] = '.';
-    if (value < 0.0001) {
-      BUF_ASSERT_LEN(len, pos + 1);
-      buf[pos++] = '0';
-    }
-
-    while (value > 0.0001) {
-      value *= 10;
-      uint8_t digit = (uint8_t)value;
-      value -= digit;
-      if (value > 0.9999 && digit < 9) {
-        digit += 1;
-        value -= 0.9999;
-      }
-      BUF_ASSERT_LEN(len, pos + 1);
-      buf[pos++] = digit + '0';
+  } else if (type != PARAM_T_STR && type != PARAM_T_F32) {
+    // The same types that parsing a human integer picks
+    int64_t val = param_cast_i64(self);
+    if (val >= 0 && val <= UINT8_MAX) {
+      set_type(&p, PARAM_T_U8);
+      p.u8 = (uint8_t)val;
+    } else if (val >= INT8_MIN && val <= INT8_MAX) {
+      set_type(&p, PARAM_T_I8);
+      p.i8 = (int8_t)val;
+    } else if (val >= INT16_MIN && val <= INT16_MAX) {
+      set_type(&p, PARAM_T_I16);
+      p.i16 = (int16_t)val;
+    } else if (val >= INT32_MIN && val <= INT32_MAX) {
+      set_type(&p, PARAM_T_I32);
+      p.i32 = (int32_t)val;
     }
-  } else {
-    // dump number
-    int64_t value = param_cast_i64(self);
-    pos += UNWRAP(format_int(value, buf + pos, len - pos));
   }
-  return pos;
+  return p;
 }
 
-////////////////////////////////////////////////////////////////////////////////
+int param_dump_binary_size(const param_t *self) {
+  if (param_type(self) == PARAM_T_STR) {
+    const char *str = param_str(self);
+    // The string couldn't be allocated
+    if (str == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    return (uint8_t)strlen(str) + 2;
+  }
+  return binary_width(param_type(self)) + 1;
+}
 
-code_t init_code(char letter, uint8_t number, size_t num_params) {
-  code_t self;
-  self.category = (letter & 0b00011111) | 0b11000000;
-  self.number = number;
-  if (num_params == 0) {
-    self.params = NULL;
+static const char format_lut[201] = "00010203040506070809"
+                                    "10111213141516171819"
+                                    "20212223242526272829"
+                                    "30313233343536373839"
+                                    "40414243444546474849"
+                                    "50515253545556575859"
+                                    "60616263646566676869"
+                                    "70717273747576777879"
+                                    "80818283848586878889"
+                                    "90919293949596979899";
+
+// Write the digits of value so that they end just before end, two at a time
+static char *format_digits(uint64_t value, char *end) {
+  while (value >= 100) {
+    uint32_t r = value % 100;
+    value /= 100;
+    end -= 2;
+    memcpy(end, &format_lut[r * 2], 2);
+  }
+  if (value >= 10) {
+    end -= 2;
+    memcpy(end, &format_lut[value * 2], 2);
   } else {
-    self.params = malloc(sizeof(param_t) * (num_params + 1));
-    self.params[num_params].param = 0;
-    self.params[num_params].str = NULL;
+    *--end = '0' + value;
   }
-  return self;
+  return end;
 }
 
-void free_code(code_t *self) {
-  if (self->params != NULL) {
-    for (int i = 0; self->params[i].param != 0; ++i) {
-      free_param(&self->params[i]);
-    }
-    free(self->params);
-    self->params = NULL;
+int format_int(int64_t value, char *buf, size_t len) {
+  char temp[20];
+  char *end = temp + sizeof(temp);
+  uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+  char *start = format_digits(magnitude, end);
+  size_t pos = 0;
+  BUF_ASSERT_LEN(len, (value < 0) + (size_t)(end - start));
+  if (value < 0) {
+    buf[pos++] = '-';
   }
+  memcpy(buf + pos, start, end - start);
+  return pos + (end - start);
 }
 
-struct param_list {
-  param_t param;
-  struct param_list *next;
+// Number of bytes format_int() writes
+static size_t format_int_size(int64_t value) {
+  uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+  size_t n = 1;
+  while (magnitude >= 100) {
+    magnitude /= 100;
+    n += 2;
+  }
+  return (value < 0) + n + (magnitude >= 10);
+}
+
+/*
+ * Shortest float formatting with Grisu2
+ *
+ * Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately
+ * with Integers". The digits always read back as the same value, and are the
+ * shortest possible for nearly every value.
+ */
+
+typedef struct {
+  uint64_t f;
+  int e;
+} diyfp_t;
+
+#define GRISU_ALPHA -60
+#define GRISU_POWERS_MIN -300
+#define GRISU_POWERS_STEP 8
+
+// Normalized 10^k ~= f * 2^e
+static const struct {
+  uint64_t f;
+  int16_t e;
+  int16_t k;
+} grisu_powers[] = {
+    {0xAB70FE17C79AC6CA, -1060, -300},
+    {0xFF77B1FCBEBCDC4F, -1034, -292},
+    {0xBE5691EF416BD60C, -1007, -284},
+    {0x8DD01FAD907FFC3C, -980, -276},
+    {0xD3515C2831559A83, -954, -268},
+    {0x9D71AC8FADA6C9B5, -927, -260},
+    {0xEA9C227723EE8BCB, -901, -252},
+    {0xAECC49914078536D, -874, -244},
+    {0x823C12795DB6CE57, -847, -236},
+    {0xC21094364DFB5637, -821, -228},
+    {0x9096EA6F3848984F, -794, -220},
+    {0xD77485CB25823AC7, -768, -212},
+    {0xA086CFCD97BF97F4, -741, -204},
+    {0xEF340A98172AACE5, -715, -196},
+    {0xB23867FB2A35B28E, -688, -188},
+    {0x84C8D4DFD2C63F3B, -661, -180},
+    {0xC5DD44271AD3CDBA, -635, -172},
+    {0x936B9FCEBB25C996, -608, -164},
+    {0xDBAC6C247D62A584, -582, -156},
+    {0xA3AB66580D5FDAF6, -555, -148},
+    {0xF3E2F893DEC3F126, -529, -140},
+    {0xB5B5ADA8AAFF80B8, -502, -132},
+    {0x87625F056C7C4A8B, -475, -124},
+    {0xC9BCFF6034C13053, -449, -116},
+    {0x964E858C91BA2655, -422, -108},
+    {0xDFF9772470297EBD, -396, -100},
+    {0xA6DFBD9FB8E5B88F, -369, -92},
+    {0xF8A95FCF88747D94, -343, -84},
+    {0xB94470938FA89BCF, -316, -76},
+    {0x8A08F0F8BF0F156B, -289, -68},
+    {0xCDB02555653131B6, -263, -60},
+    {0x993FE2C6D07B7FAC, -236, -52},
+    {0xE45C10C42A2B3B06, -210, -44},
+    {0xAA242499697392D3, -183, -36},
+    {0xFD87B5F28300CA0E, -157, -28},
+    {0xBCE5086492111AEB, -130, -20},
+    {0x8CBCCC096F5088CC, -103, -12},
+    {0xD1B71758E219652C, -77, -4},
+    {0x9C40000000000000, -50, 4},
+    {0xE8D4A51000000000, -24, 12},
+    {0xAD78EBC5AC620000, 3, 20},
+    {0x813F3978F8940984, 30, 28},
+    {0xC097CE7BC90715B3, 56, 36},
+    {0x8F7E32CE7BEA5C70, 83, 44},
+    {0xD5D238A4ABE98068, 109, 52},
+    {0x9F4F2726179A2245, 136, 60},
+    {0xED63A231D4C4FB27, 162, 68},
+    {0xB0DE65388CC8ADA8, 189, 76},
+    {0x83C7088E1AAB65DB, 216, 84},
+    {0xC45D1DF942711D9A, 242, 92},
+    {0x924D692CA61BE758, 269, 100},
+    {0xDA01EE641A708DEA, 295, 108},
+    {0xA26DA3999AEF774A, 322, 116},
+    {0xF209787BB47D6B85, 348, 124},
+    {0xB454E4A179DD1877, 375, 132},
+    {0x865B86925B9BC5C2, 402, 140},
+    {0xC83553C5C8965D3D, 428, 148},
+    {0x952AB45CFA97A0B3, 455, 156},
+    {0xDE469FBD99A05FE3, 481, 164},
+    {0xA59BC234DB398C25, 508, 172},
+    {0xF6C69A72A3989F5C, 534, 180},
+    {0xB7DCBF5354E9BECE, 561, 188},
+    {0x88FCF317F22241E2, 588, 196},
+    {0xCC20CE9BD35C78A5, 614, 204},
+    {0x98165AF37B2153DF, 641, 212},
+    {0xE2A0B5DC971F303A, 667, 220},
+    {0xA8D9D1535CE3B396, 694, 228},
+    {0xFB9B7CD9A4A7443C, 720, 236},
+    {0xBB764C4CA7A44410, 747, 244},
+    {0x8BAB8EEFB6409C1A, 774, 252},
+    {0xD01FEF10A657842C, 800, 260},
+    {0x9B10A4E5E9913129, 827, 268},
+    {0xE7109BFBA19C0C9D, 853, 276},
+    {0xAC2820D9623BF429, 880, 284},
+    {0x80444B5E7AA7CF85, 907, 292},
+    {0xBF21E44003ACDD2D, 933, 300},
+    {0x8E679C2F5E44FF8F, 960, 308},
+    {0xD433179D9C8CB841, 986, 316},
+    {0x9E19DB92B4E31BA9, 1013, 324},
 };
 
-void free_param_list(struct param_list *self) {
-  while (self != NULL) {
-    struct param_list *temp = self;
-    free_param(&self->param);
-    self = self->next;
-    free(temp);
-  }
+static diyfp_t diyfp_mul(diyfp_t x, diyfp_t y) {
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & 0xFFFFFFFF;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & 0xFFFFFFFF;
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+  uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+  mid += 1u << 31; // round
+  diyfp_t r = {ac + (ad >> 32) + (bc >> 32) + (mid >> 32), x.e + y.e + 64};
+  return r;
 }
 
-int code_parse_args_human(struct param_list **params, size_t *param_len,
-                          const char *buf, size_t len) {
-  struct param_list *last_param = *params;
-  while (last_param != NULL && last_param->next != NULL) {
-    last_param = last_param->next;
+static diyfp_t diyfp_normalize(diyfp_t x) {
+  int shift = __builtin_clzll(x.f);
+  diyfp_t r = {x.f << shift, x.e - shift};
+  return r;
+}
+
+// Round the last digit towards w while staying in the boundaries
+static void grisu_round(char *digits, int n, uint64_t dist, uint64_t delta,
+                        uint64_t rest, uint64_t ten_k) {
+  while (rest < dist && delta - rest >= ten_k &&
+         (rest + ten_k < dist || dist - rest > rest + ten_k - dist)) {
+    digits[n - 1]--;
+    rest += ten_k;
   }
-  size_t pos = 0;
+}
 
-  while (1) {
-    if (len <= pos) {
-      break;
-    }
-    char next = buf[pos];
-    if (isspace(next)) {
-      pos++;
-      if (next == '\n') {
-        break;
-      }
-      if (next == '\r') {
-        break;
-      }
-      continue;
-    }
-    param_t param;
-    pos += UNWRAP(param_parse_human(&param, buf + pos, len - pos));
-    struct param_list *new_param = malloc(sizeof(struct param_list));
-    memcpy(&new_param->param, &param, sizeof(param_t));
-    new_param->next = NULL;
-    if (last_param == NULL) {
-      *params = new_param;
-      last_param = new_param;
-    } else {
-      last_param->next = new_param;
-      last_param = new_param;
+/**
+ * Generate the digits of a value between m_minus and m_plus, closest to w
+ *
+ * @param exponent decimal exponent, adjusted by the number of digits
+ *
+ * @return number of digits
+ */
+static int grisu_digits(char *digits, int *exponent, diyfp_t m_minus,
+                        diyfp_t w, diyfp_t m_plus) {
+  uint64_t delta = m_plus.f - m_minus.f;
+  uint64_t dist = m_plus.f - w.f;
+  int shift = -m_plus.e;
+  uint64_t one = (uint64_t)1 << shift;
+  uint32_t p1 = m_plus.f >> shift;
+  uint64_t p2 = m_plus.f & (one - 1);
+  int n = 0;
+
+  // Write all of the integer digits at once to avoid dividing by a variable
+  char whole[10];
+  char *end = whole + sizeof(whole);
+  char *start = format_digits(p1, end);
+  int k = end - start;
+  uint32_t pow10 = parse_pow10[k - 1];
+  while (k > 0) {
+    digits[n] = *start++;
+    p1 -= (digits[n++] - '0') * pow10;
+    k--;
+    uint64_t rest = ((uint64_t)p1 << shift) + p2;
+    if (rest <= delta) {
+      *exponent += k;
+      grisu_round(digits, n, dist, delta, rest, (uint64_t)pow10 << shift);
+      return n;
     }
-    (*param_len)++;
+    pow10 /= 10;
   }
 
-  return pos;
+  int m = 0;
+  do {
+    p2 *= 10;
+    digits[n++] = '0' + (p2 >> shift);
+    p2 &= one - 1;
+    m++;
+    delta *= 10;
+    dist *= 10;
+  } while (p2 > delta);
+  *exponent -= m;
+  grisu_round(digits, n, dist, delta, p2, one);
+  return n;
 }
 
-int code_parse_args_binary(struct param_list **params, size_t *param_len,
-                           uint8_t *crc, const char *buf, size_t len) {
-  struct param_list *last_param = *params;
-  while (last_param != NULL && last_param->next != NULL) {
-    last_param = last_param->next;
+/**
+ * Find the shortest digits that read back as value
+ *
+ * @param value finite value above zero
+ * @param is_f32 whether value should read back as a float
+ * @param digits at least 18 bytes
+ * @param exponent value = digits * 10^exponent
+ *
+ * @return number of digits
+ */
+static int format_shortest(double value, int is_f32, char *digits,
+                           int *exponent) {
+  uint64_t f;
+  int e;
+  int bias;
+  int precision;
+  if (is_f32 || DBL_MANT_DIG != 53) {
+    float v = value;
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    f = bits & 0x7FFFFF;
+    e = (bits >> 23) & 0xFF;
+    bias = 127 + 23;
+    precision = 24;
+  } else {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    f = bits & 0xFFFFFFFFFFFFFull;
+    e = (bits >> 52) & 0x7FF;
+    bias = 1023 + 52;
+    precision = 53;
+  }
+  // The lower boundary is closer when f is a power of two
+  int lower_closer = f == 0 && e > 1;
+  if (e == 0) {
+    e = 1 - bias;
+  } else {
+    f |= (uint64_t)1 << (precision - 1);
+    e -= bias;
   }
-  size_t pos = 0;
 
-  while (1) {
-    uint8_t next = BUF_AT(buf, len, pos);
-    if (next == '\0') {
-      pos++;
+  diyfp_t v = {f, e};
+  diyfp_t m_plus = diyfp_normalize((diyfp_t){2 * f + 1, e - 1});
+  diyfp_t m_minus = lower_closer ? (diyfp_t){4 * f - 1, e - 2}
+                                 : (diyfp_t){2 * f - 1, e - 1};
+  m_minus.f <<= m_minus.e - m_plus.e;
+  m_minus.e = m_plus.e;
+  v = diyfp_normalize(v);
+
+  // Scale by a power of ten so that the exponent is in [alpha, gamma]
+  int t = GRISU_ALPHA - m_plus.e - 1;
+  int k = (t * 78913) / (1 << 18) + (t > 0);
+  int index = (-GRISU_POWERS_MIN + k + GRISU_POWERS_STEP - 1) /
+              GRISU_POWERS_STEP;
+  diyfp_t c = {grisu_powers[index].f, grisu_powers[index].e};
+
+  diyfp_t w = diyfp_mul(v, c);
+  diyfp_t w_minus = diyfp_mul(m_minus, c);
+  diyfp_t w_plus = diyfp_mul(m_plus, c);
+  // Keep a one unit safety margin for the rounding in diyfp_mul
+  w_minus.f += 1;
+  w_plus.f -= 1;
+
+  *exponent = -grisu_powers[index].k;
+  return grisu_digits(digits, exponent, w_minus, w, w_plus);
+}
+
+#if PARSE_FAST_F64
+#define FORMAT_FAST_DECIMALS 6
+
+/**
+ * Find the digits of a value with only a few decimals, such as one that was
+ * parsed from a human code. This is much faster than Grisu for those values.
+ *
+ * The digits are checked by converting them back the same way parse_number()
+ * would.
+ *
+ * @return number of digits, or 0 if the value has too many decimals
+ */
+static int format_few_decimals(double value, int is_f32, char *digits,
+                               int *exponent) {
+  double limit = is_f32 ? (1 << FLT_MANT_DIG) : (1ull << DBL_MANT_DIG);
+  for (int d = 0; d <= FORMAT_FAST_DECIMALS; ++d) {
+    double scaled = value * parse_pow10_f64[d];
+    if (scaled >= limit) {
       break;
     }
-    param_t param;
-    pos += UNWRAP(param_parse_binary(&param, buf + pos, len - pos));
-    struct param_list *new_param = malloc(sizeof(struct param_list));
-    memcpy(&new_param->param, &param, sizeof(param_t));
-    new_param->next = NULL;
-    if (last_param == NULL) {
-      *params = new_param;
-      last_param = new_param;
-    } else {
-      last_param->next = new_param;
-      last_param = new_param;
+    uint64_t m = (uint64_t)(scaled + 0.5);
+    int exact = is_f32 ? (float)m / parse_pow10_f32[d] == (float)value
+                       : (double)m / parse_pow10_f64[d] == value;
+    if (exact && m != 0) {
+      char *end = digits + 20;
+      char *start = format_digits(m, end);
+      memmove(digits, start, end - start);
+      *exponent = -d;
+      return end - start;
     }
-    (*param_len)++;
   }
-  *crc = BUF_AT(buf, len, pos);
-  pos++;
-
-  return pos;
+  return 0;
 }
+#endif
 
-int code_parse(code_t *self, const char *buf, size_t len) {
-  param_t code = {0};
-  size_t pos = 0;
-  struct param_list *params = NULL;
-  size_t params_len = 0;
+// Enough 32 bit words for a mantissa times 10^255
+#define FORMAT_EXACT_WORDS 30
 
-  while (pos < len) {
-    if (!isspace(buf[pos]) || buf[pos] == '\n' || buf[pos] == '\r') {
-      break;
-    }
-    pos++;
+// Get a bit of a number that is stored in words, which is 0 outside of them
+static uint32_t format_exact_bit(const uint32_t *words, int num_words,
+                                 int bit) {
+  if (bit < 0 || bit >= 32 * num_words) {
+    return 0;
   }
-  uint8_t first = BUF_AT(buf, len, pos);
-
-  if (first & 0x80) {
-    size_t start = pos;
-    uint8_t crc;
-    pos += UNWRAP(param_parse_binary(&code, buf + pos, len - pos));
-    int res = code_parse_args_binary(&params, &params_len, &crc, buf + pos,
-                                     len - pos);
+  return (words[bit / 32] >> (bit % 32)) & 1;
+}
 
-    if (res < 0) {
-      free_param(&code);
-      free_param_list(params);
-      return res;
+/**
+ * Round a value times 10^decimals to an integer, with halves rounded up. This
+ * uses the exact value of the double, since the shortest digits of it might
+ * already be rounded up to a half.
+ *
+ * @return rounded value, which must be below 2^64
+ */
+static uint64_t format_exact(double value, int decimals) {
+  int e;
+  uint64_t f;
+#if DBL_MANT_DIG == 53
+  memcpy(&f, &value, sizeof(f));
+  e = (f >> 52) & 0x7FF;
+  f &= 0xFFFFFFFFFFFFF;
+  if (e == 0) {
+    e = 1;
+  } else {
+    f |= 1ull << 52;
+  }
+  e -= 1075;
+#else
+  f = (uint64_t)ldexp(frexp(value, &e), DBL_MANT_DIG);
+  e -= DBL_MANT_DIG;
+#endif
+  if (decimals < 20 && e < 0 && e > -128) {
+    // The product fits in two 64 bit words
+    uint64_t p = parse_pow10[decimals];
+    uint64_t bd = (f & 0xFFFFFFFF) * (p & 0xFFFFFFFF);
+    uint64_t ad = (f >> 32) * (p & 0xFFFFFFFF);
+    uint64_t bc = (f & 0xFFFFFFFF) * (p >> 32);
+    uint64_t mid = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+    uint64_t lo = mid << 32 | (bd & 0xFFFFFFFF);
+    uint64_t hi = (f >> 32) * (p >> 32) + (ad >> 32) + (bc >> 32) + (mid >> 32);
+    int k = -e;
+    if (k < 64) {
+      return (lo >> k | hi << (64 - k)) + ((lo >> (k - 1)) & 1);
     }
-    pos += res;
-
-    if (crc_calc(buf + start, pos - 2 - start, crc) != 0) {
-      free_param(&code);
-      free_param_list(params);
-      return SCODE_ERROR_CRC;
+    return (hi >> (k - 64)) + (k == 64 ? lo >> 63 : (hi >> (k - 65)) & 1);
+  }
+  uint32_t words[FORMAT_EXACT_WORDS] = {(uint32_t)f, (uint32_t)(f >> 32)};
+  int num_words = 2;
+  for (int i = 0; i < decimals; ++i) {
+    uint64_t carry = 0;
+    for (int j = 0; j < num_words; ++j) {
+      carry += (uint64_t)words[j] * 10;
+      words[j] = (uint32_t)carry;
+      carry >>= 32;
     }
+    if (carry != 0 && num_words < FORMAT_EXACT_WORDS) {
+      words[num_words++] = (uint32_t)carry;
+    }
+  }
+  // value * 10^decimals = words * 2^e
+  uint64_t rounded = 0;
+  for (int i = 63; i >= 0; --i) {
+    rounded = rounded << 1 | format_exact_bit(words, num_words, i - e);
+  }
+  return rounded + format_exact_bit(words, num_words, -e - 1);
+}
 
-    self->category = first;
+// Round the digits of a value to a number of decimals, returning the new number
+// of digits
+static int format_round(char *digits, int n, int *point, int decimals,
+                        double value) {
+  int keep = *point + decimals;
+  if (keep >= n) {
+    return n;
+  }
+  if (keep < 0) {
+    return 0;
+  }
+  // Fewer digits are kept than the shortest digits have, so they fit
+  uint64_t rounded = format_exact(value, decimals);
+  if (rounded == 0) {
+    return 0;
+  }
+  char *end = digits + 20;
+  char *start = format_digits(rounded, end);
+  n = end - start;
+  memmove(digits, start, n);
+  *point = n - decimals;
+  return n;
+}
 
-    while (pos < len) {
-      if (!isspace(buf[pos])) {
-        break;
-      }
-      pos++;
+// The layout of a float in fixed notation
+typedef struct {
+  char digits[24];
+  int n;        // number of significant digits
+  int point;    // number of digits before the decimal point
+  int whole;    // number of digits written before the decimal point
+  int fraction; // number of digits written after the decimal point
+  int is_negative;
+} float_format_t;
+
+/**
+ * Find the digits of a float in fixed notation. There is always a decimal point
+ * so that it is read back as a float.
+ *
+ * @param decimals number of decimals to write, or below zero for the shortest
+ * value that reads back the same
+ *
+ * @return number of bytes the float takes, or SCODE_ERROR_DUMP
+ */
+static int format_float_layout(float_format_t *self, double value, int is_f32,
+                               int decimals) {
+  if (!isfinite(value)) {
+    return SCODE_ERROR_DUMP;
+  }
+  int n = 0;
+  int exponent = 0;
+  self->is_negative = signbit(value) != 0;
+  if (value != 0) {
+    value = self->is_negative ? -value : value;
+#if PARSE_FAST_F64
+    n = format_few_decimals(value, is_f32, self->digits, &exponent);
+    if (n == 0)
+#endif
+    {
+      n = format_shortest(value, is_f32, self->digits, &exponent);
     }
-
+  }
+  int point = n + exponent;
+  if (decimals >= 0) {
+    n = format_round(self->digits, n, &point, decimals, value);
+    self->fraction = decimals > 0 ? decimals : 1;
   } else {
-    // Find a comment if it exists
-    size_t comment = len;
-    size_t eol = SIZE_MAX;
-    size_t eoc = SIZE_MAX;
-    for (size_t i = pos; i < len; ++i) {
-      if (buf[i] == ';' && comment > i) {
-        comment = i;
-      } else if (buf[i] == '\n' || buf[i] == '\r') {
-        eol = i + 1;
-        eoc = i;
-        break;
-      }
-    }
+    self->fraction = point >= n ? 1 : n - point;
+  }
+  self->n = n;
+  self->point = point;
+  self->whole = point > 0 ? point : 1;
+  return self->is_negative + self->whole + 1 + self->fraction;
+}
 
-    if (eoc >= len) {
-      return SCODE_ERROR_BUFFER;
+static int format_float(double value, int is_f32, int decimals, char *buf,
+                        size_t len) {
+  float_format_t f;
+  size_t size = UNWRAP(format_float_layout(&f, value, is_f32, decimals));
+  BUF_ASSERT_LEN(len, size);
+  size_t pos = 0;
+  if (f.is_negative) {
+    buf[pos++] = '-';
+  }
+  for (int i = f.point - f.whole; i < f.point + f.fraction; ++i) {
+    if (i == f.point) {
+      buf[pos++] = '.';
     }
+    buf[pos++] = i >= 0 && i < f.n ? f.digits[i] : '0';
+  }
+  return pos;
+}
 
-    len = MIN(comment, eoc);
-
-    if (pos - len == 0) {
-      return SCODE_ERROR_EMPTY;
+// Pick the quote for a human string, or return 0 if it contains both
+static char format_quote(const char *str, size_t length) {
+  int contains_single_quote = 0;
+  int contains_double_quote = 0;
+  for (size_t i = 0; i < length; ++i) {
+    if (str[i] == '\'') {
+      contains_single_quote = 1;
     }
-
-    pos += UNWRAP(param_parse_human(&code, buf + pos, len - pos));
-    int res = code_parse_args_human(&params, &params_len, buf + pos, len - pos);
-
-    if (res < 0) {
-      free_param(&code);
-      free_param_list(params);
-      return res;
+    if (str[i] == '"') {
+      contains_double_quote = 1;
+    }
+    if (contains_single_quote && contains_double_quote) {
+      return 0;
     }
-    pos += res;
-
-    self->category = param_letter(&code);
-    pos = eol;
   }
+  return contains_single_quote ? '"' : '\'';
+}
 
-  self->number = param_cast_u8(&code);
-  free_param(&code);
+static int param_dump_human_decimals(const param_t *self, char *buf,
+                                    size_t len, int decimals) {
+  char letter = param_letter(self);
+  BUF_ASSERT_LEN(len, 1);
+  buf[0] = letter;
+  size_t pos = 1;
 
-  param_t *param_arr = NULL;
-  if (params_len > 0) {
-    param_arr = malloc(sizeof(param_t) * (params_len + 1));
-    struct param_list *item = params;
-    int i = 0;
-    while (item != NULL) {
-      memcpy(&param_arr[i], &item->param, sizeof(param_t));
-      struct param_list *temp = item;
-      item = item->next;
-      free(temp);
-      i++;
+  uint8_t type = param_type(self);
+  if (type == PARAM_T_STR) {
+    // dump string
+    const char *str = param_str(self);
+    if (str == NULL) {
+      return SCODE_ERROR_MEMORY;
     }
-    param_arr[params_len].param = 0;
-    param_arr[params_len].str = NULL;
+    size_t length = strlen(str);
+    char quote = format_quote(str, length);
+    if (quote == 0) {
+      return SCODE_ERROR_DUMP;
+    }
+    BUF_ASSERT_LEN(len, length + 2 + pos);
+    buf[pos++] = quote;
+    memcpy(&buf[pos], str, length);
+    pos += length;
+    buf[pos++] = quote;
+  } else if (type == PARAM_T_F32 || type == PARAM_T_F64) {
+    // dump float
+    pos += UNWRAP(format_float(param_cast_f64(self), type == PARAM_T_F32,
+                               decimals, buf + pos, len - pos));
+  } else {
+    // dump number
+    int64_t value = param_cast_i64(self);
+    pos += UNWRAP(format_int(value, buf + pos, len - pos));
   }
-  self->params = param_arr;
-
   return pos;
 }
 
-int code_dump_binary(const code_t *self, char *buf, size_t len) {
-  size_t pos = 0;
-  param_t start = init_param_u8(self->category, self->number);
-  pos += UNWRAP(param_dump_binary(&start, buf, len));
-  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
-    pos += UNWRAP(param_dump_binary(&self->params[i], buf + pos, len - pos));
+int param_dump_human(const param_t *self, char *buf, size_t len) {
+  return param_dump_human_decimals(self, buf, len, -1);
+}
+
+int param_dump_human_fixed(const param_t *self, char *buf, size_t len,
+                           uint8_t decimals) {
+  return param_dump_human_decimals(self, buf, len, decimals);
+}
+
+static int param_dump_human_decimals_size(const param_t *self, int decimals) {
+  uint8_t type = param_type(self);
+  if (type == PARAM_T_STR) {
+    const char *str = param_str(self);
+    if (str == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    size_t length = strlen(str);
+    if (format_quote(str, length) == 0) {
+      return SCODE_ERROR_DUMP;
+    }
+    return length + 3;
   }
-  uint8_t crc = crc_calc(buf, pos, 0);
-  BUF_SET(buf, len, pos, '\0');
-  pos++;
-  BUF_SET(buf, len, pos, crc);
-  pos++;
+  if (type == PARAM_T_F32 || type == PARAM_T_F64) {
+    float_format_t f;
+    return 1 + UNWRAP(format_float_layout(&f, param_cast_f64(self),
+                                          type == PARAM_T_F32, decimals));
+  }
+  return 1 + format_int_size(param_cast_i64(self));
+}
 
-  return pos;
+int param_dump_human_size(const param_t *self) {
+  return param_dump_human_decimals_size(self, -1);
 }
 
-int code_dump_human(const code_t *self, char *buf, size_t len) {
-  size_t pos = 0;
+int param_dump_human_fixed_size(const param_t *self, uint8_t decimals) {
+  return param_dump_human_decimals_size(self, decimals);
+}
+
+uint8_t param_view_cast_u8(const param_view_t *self) { CAST_PARAM; }
+int8_t param_view_cast_i8(const param_view_t *self) { CAST_PARAM; }
+int16_t param_view_cast_i16(const param_view_t *self) { CAST_PARAM; }
+int32_t param_view_cast_i32(const param_view_t *self) { CAST_PARAM; }
+int64_t param_view_cast_i64(const param_view_t *self) { CAST_PARAM; }
+float param_view_cast_f32(const param_view_t *self) { CAST_PARAM; }
+double param_view_cast_f64(const param_view_t *self) { CAST_PARAM; }
+
+uint8_t param_view_type(const param_view_t *self) {
+  return (self->param >> 5) & 0b111;
+}
+
+char param_view_letter(const param_view_t *self) {
+  return (self->param & 0b00011111) | 0b01000000;
+}
+
+int param_view_parse(param_view_t *self, const char *buf, size_t len,
+                     int is_binary) {
+  uint8_t type = (BUF_AT(buf, len, 0) >> 5) & 0b111;
+  char quote = len > 1 ? buf[1] : '\0';
+  size_t offset;
+
+  if (is_binary && type == PARAM_T_STR) {
+    self->param = buf[0];
+    offset = 1;
+    quote = '\0';
+  } else if (!is_binary && (quote == '"' || quote == '\'')) {
+    self->param = (toupper(buf[0]) & 0b00011111) | (PARAM_T_STR << 5);
+    offset = 2;
+  } else {
+    // Numbers don't use the heap, so the normal parsers can be used
+    param_t param;
+    int res = is_binary ? param_parse_binary(&param, buf, len)
+                        : param_parse_human(&param, buf, len);
+    if (res < 0) {
+      return res;
+    }
+    self->param = param.param;
+    self->i64 = param.i64;
+    self->len = 0;
+    return res;
+  }
+
+  char l = param_view_letter(self);
+  if (l < 'A' || l > (is_binary ? '@' + PARAM_DELTA : 'Z') ||
+      (!is_binary && !isalpha(buf[0]))) {
+    return SCODE_ERROR_PARSE;
+  }
+  size_t end = scan_delim(buf, offset, len, quote, quote, quote);
+  if (end >= len) {
+    return SCODE_ERROR_BUFFER;
+  }
+  self->str = &buf[offset];
+  self->len = end - offset;
+  return end + 1;
+}
+
+static int param_view_copy_to(param_t *p, const param_view_t *self,
+                              scode_arena_t *arena) {
+  p->param = self->param;
+  p->flags = 0;
+  if (param_view_type(self) == PARAM_T_STR) {
+    char *str = param_str_alloc(p, self->len, arena);
+    if (str == NULL) {
+      p->param = 0;
+      return SCODE_ERROR_MEMORY;
+    }
+    memcpy(str, self->str, self->len);
+    str[self->len] = '\0';
+  } else {
+    p->i64 = self->i64;
+  }
+  return 0;
+}
+
+// Copy a view into a param that was already in use, writing over its heap
+// string if it has one that is big enough
+static int param_view_copy_into(param_t *p, const param_view_t *self) {
+  if (param_type(p) == PARAM_T_STR && (p->flags & PARAM_FLAG_INLINE) == 0 &&
+      p->str != NULL) {
+    if (param_view_type(self) == PARAM_T_STR && self->len > PARAM_SSO_LEN &&
+        self->len < p->str_cap) {
+      p->param = self->param;
+      memcpy(p->str, self->str, self->len);
+      p->str[self->len] = '\0';
+      return 0;
+    }
+    scode_free(p->str);
+  }
+  return param_view_copy_to(p, self, NULL);
+}
+
+param_t param_view_copy(const param_view_t *self) {
+  param_t p;
+  param_view_copy_to(&p, self, NULL);
+  return p;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+code_t init_code(char letter, uint8_t number, size_t num_params) {
+  code_t self;
+  self.category = (letter & 0b00011111) | 0b11000000;
+  self.number = number;
+  self.flags = 0;
+  self.num_params = num_params;
+  self.params_cap = num_params;
+  self.mask = 0;
+  self.params = NULL;
+  if (num_params > 0) {
+    self.params = scode_malloc(sizeof(param_t) * (num_params + 1));
+  }
+  if (self.params == NULL) {
+    self.num_params = 0;
+    self.params_cap = 0;
+  } else {
+    self.params[num_params].param = 0;
+    self.params[num_params].str = NULL;
+  }
+  return self;
+}
+
+// Point a code at storage for its params, which has room for a terminator
+static int code_alloc_params(code_t *self, size_t num_params,
+                             scode_arena_t *arena) {
+  self->params_cap = 0;
+  if (num_params == 0) {
+    self->params = NULL;
+    return 0;
+  }
+#if SCODE_INLINE_PARAMS > 0
+  if (arena == NULL && num_params <= SCODE_INLINE_PARAMS) {
+    self->params = self->inline_params;
+    self->flags |= CODE_FLAG_INLINE;
+    return 0;
+  }
+#endif
+  self->params = scode_alloc(arena, sizeof(param_t) * (num_params + 1));
+  if (self->params == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  if (arena == NULL) {
+    self->params_cap = num_params;
+  }
+  return 0;
+}
+
+int init_code_into(code_t *self, char letter, uint8_t number,
+                   size_t num_params) {
+  self->category = (letter & 0b00011111) | 0b11000000;
+  self->number = number;
+  self->flags = 0;
+  self->num_params = num_params;
+  self->mask = 0;
+  if (code_alloc_params(self, num_params, NULL) < 0) {
+    self->num_params = 0;
+    return SCODE_ERROR_MEMORY;
+  }
+  if (num_params > 0) {
+    self->params[num_params].param = 0;
+    self->params[num_params].str = NULL;
+  }
+  return 0;
+}
+
+void code_move(code_t *self, code_t *from) {
+  *self = *from;
+#if SCODE_INLINE_PARAMS > 0
+  if (from->flags & CODE_FLAG_INLINE) {
+    self->params = self->inline_params;
+  }
+#endif
+  from->params = NULL;
+  from->num_params = 0;
+  from->params_cap = 0;
+  from->mask = 0;
+  from->flags = 0;
+}
+
+int code_copy(code_t *self, const code_t *from) {
+  *self = *from;
+  self->flags = from->flags & CODE_FLAG_LOOKUP;
+  if (code_alloc_params(self, from->num_params, NULL) < 0) {
+    self->num_params = 0;
+    self->mask = 0;
+    self->flags = 0;
+    return SCODE_ERROR_MEMORY;
+  }
+  if (from->num_params == 0) {
+    return 0;
+  }
+  // Strings can't be shared, so each copy gets its own
+  memcpy(self->params, from->params, sizeof(param_t) * (from->num_params + 1));
+  for (size_t i = 0; i < from->num_params; ++i) {
+    param_t *param = &self->params[i];
+    const char *str = param_str(&from->params[i]);
+    if (str == NULL || (param->flags & PARAM_FLAG_INLINE)) {
+      continue;
+    }
+    size_t length = strlen(str);
+    param->str = scode_malloc(length + 1);
+    if (param->str == NULL) {
+      // End the code here, the params after it still share their strings
+      self->params[i + 1].param = 0;
+      free_code(self);
+      return SCODE_ERROR_MEMORY;
+    }
+    memcpy(param->str, str, length + 1);
+    param->str_cap = length < UINT32_MAX ? length + 1 : UINT32_MAX;
+  }
+  return 0;
+}
+
+void free_code(code_t *self) {
+  self->num_params = 0;
+  self->params_cap = 0;
+  self->mask = 0;
+  if (self->flags & CODE_FLAG_ARENA) {
+    // The arena owns everything
+    self->params = NULL;
+    self->flags = 0;
+    return;
+  }
+  if (self->params != NULL) {
+    for (int i = 0; self->params[i].param != 0; ++i) {
+      free_param(&self->params[i]);
+    }
+    if ((self->flags & CODE_FLAG_INLINE) == 0) {
+      scode_free(self->params);
+    }
+    self->params = NULL;
+  }
+  self->flags = 0;
+}
+
+// Letters are stored as their offset from '@', so 'A' is 1
+#define LOOKUP_INDEX(param) (((param) & 0b00011111) - 1)
+
+// Add a param to the lookup table, keeping the first param of each letter
+static inline void code_lookup_add(code_t *self, size_t i) {
+  uint32_t index = LOOKUP_INDEX(self->params[i].param);
+  if (index < 26 && (self->mask & (1u << index)) == 0) {
+    self->mask |= 1u << index;
+    self->lookup[index] = i;
+  }
+}
+
+void code_update_lookup(code_t *self) {
+  self->mask = 0;
+  self->num_params = 0;
+  while (self->params != NULL && self->params[self->num_params].param != 0) {
+    self->num_params++;
+  }
+  // Indexes are stored in a byte, so very long codes are searched instead
+  if (self->num_params > UINT8_MAX) {
+    self->flags &= ~CODE_FLAG_LOOKUP;
+    return;
+  }
+  for (size_t i = 0; i < self->num_params; ++i) {
+    code_lookup_add(self, i);
+  }
+  self->flags |= CODE_FLAG_LOOKUP;
+}
+
+param_t *code_get_param(const code_t *self, char letter) {
+  if (!isalpha((uint8_t)letter) || self->params == NULL) {
+    return NULL;
+  }
+  uint32_t index = LOOKUP_INDEX(letter);
+  if (self->flags & CODE_FLAG_LOOKUP) {
+    if ((self->mask & (1u << index)) == 0) {
+      return NULL;
+    }
+    return &self->params[self->lookup[index]];
+  }
+  for (param_t *param = self->params; param->param != 0; ++param) {
+    if ((uint32_t)LOOKUP_INDEX(param->param) == index) {
+      return param;
+    }
+  }
+  return NULL;
+}
+
+int code_has_param(const code_t *self, char letter) {
+  return code_get_param(self, letter) != NULL;
+}
+
+#define PARSER_LEAD 0      // Skipping whitespace before a code
+#define PARSER_EMPTY 1     // Skipping a line without a code
+#define PARSER_SKIP 2      // Skipping the rest of an invalid code
+#define PARSER_SKIP_CRC 3  // Skipping the checksum of an invalid binary code
+#define PARSER_SKIP_FRAME 4 // Skipping the rest of an invalid frame
+#define PARSER_H_VALUE 5   // Start of a human value
+#define PARSER_H_NUMBER 6  // Inside of a human number
+#define PARSER_H_STRING 7  // Inside of a human string
+#define PARSER_H_SEP 8     // Between human params
+#define PARSER_H_COMMENT 9 // Inside of a comment after a human code
+#define PARSER_B_PARAM 10  // Start of a binary param
+#define PARSER_B_VALUE 11  // Inside of a fixed width binary value
+#define PARSER_B_STRING 12 // Inside of a binary string
+#define PARSER_B_CRC 13    // Binary checksum
+#define PARSER_F_LENGTH 14 // Length of a framed binary code
+#define PARSER_F_CODE 15   // First byte of a framed binary code
+
+#define FRAME_LENGTH_BITS 28 // a frame length is a varint of up to 4 bytes
+#define FRAME_MIN_CODE 4     // the code, its number, the null and the CRC
+
+static void parser_reset(code_parser_t *self) {
+  uint8_t state = self->state;
+  size_t remaining = self->remaining;
+  uint8_t checksum = self->checksum;
+  memset(self, 0, sizeof(code_parser_t));
+  self->checksum = checksum;
+  if (state == PARSER_SKIP) {
+    self->state = state;
+  } else if (state == PARSER_SKIP_CRC || state == PARSER_SKIP_FRAME) {
+    self->state = state;
+    self->remaining = remaining;
+  }
+}
+
+static int parser_idle(const code_parser_t *self) {
+  return self->state <= PARSER_SKIP_FRAME;
+}
+
+// Skip over a line ending, treating "\r\n" as a single line ending if the
+// '\n' has already been received
+static size_t parser_eol(const char *buf, size_t len, size_t i) {
+  if (buf[i] == '\r' && i + 1 < len && buf[i + 1] == '\n') {
+    return i + 2;
+  }
+  return i + 1;
+}
+
+// Drop an invalid frame up to its end, even if that hasn't been received yet
+static int parser_frame_error(code_parser_t *self, size_t len, int error) {
+  if (self->frame <= len) {
+    self->state = PARSER_LEAD;
+    self->scan = self->frame;
+  } else {
+    self->state = PARSER_SKIP_FRAME;
+    self->remaining = self->frame - len;
+    self->scan = len;
+  }
+  return error;
+}
+
+static int parser_error(code_parser_t *self, const char *buf, size_t len,
+                        size_t i) {
+  if (self->frame != 0) {
+    return parser_frame_error(self, len, SCODE_ERROR_PARSE);
+  }
+  char c = buf[i];
+  if (c == '\n' || c == '\r') {
+    self->state = PARSER_LEAD;
+    self->scan = parser_eol(buf, len, i);
+  } else {
+    self->state = c == '\0' ? PARSER_SKIP_CRC : PARSER_SKIP;
+    self->remaining = checksum_width(self->checksum);
+    self->scan = i + 1;
+  }
+  return SCODE_ERROR_PARSE;
+}
+
+/**
+ * Read any new bytes of the pending code
+ *
+ * @param buf pending code
+ * @param len number of bytes received so far
+ *
+ * @return number of bytes in the code once it is complete, SCODE_ERROR_BUFFER
+ * if more data is needed, or another SCODE_ERROR_X error. When an error other
+ * than SCODE_ERROR_BUFFER is returned, self->scan bytes should be dropped.
+ */
+static int parser_feed(code_parser_t *self, const char *buf, size_t len) {
+  const uint8_t checksum = checksum_width(self->checksum);
+  for (size_t i = self->scan; i < len; ++i) {
+    uint8_t c = buf[i];
+    switch (self->state) {
+    case PARSER_LEAD:
+      if (c == '\n' || c == '\r') {
+        self->scan = parser_eol(buf, len, i);
+        return SCODE_ERROR_EMPTY;
+      }
+      if (isspace(c)) {
+        continue;
+      }
+      self->start = i;
+      if (c == ';') {
+        self->state = PARSER_EMPTY;
+      } else if (c & 0x80) {
+        self->state = PARSER_B_PARAM;
+        goto binary_param;
+      } else if (isalpha(c)) {
+        self->state = PARSER_H_VALUE;
+      } else if (c == CODE_FRAME_SYNC) {
+        self->state = PARSER_F_LENGTH;
+      } else {
+        return parser_error(self, buf, len, i);
+      }
+      break;
+    case PARSER_EMPTY:
+      i = scan_delim(buf, i, len, '\n', '\r', '\n');
+      if (i < len) {
+        self->scan = parser_eol(buf, len, i);
+        return SCODE_ERROR_EMPTY;
+      }
+      break;
+    case PARSER_SKIP:
+      i = scan_delim(buf, i, len, '\n', '\r', '\0');
+      if (i >= len) {
+        break;
+      }
+      if (buf[i] == '\0') {
+        self->state = PARSER_SKIP_CRC;
+        self->remaining = checksum;
+      } else {
+        self->state = PARSER_LEAD;
+        i = parser_eol(buf, len, i) - 1;
+      }
+      break;
+    case PARSER_SKIP_CRC:
+      if (--self->remaining == 0) {
+        self->state = PARSER_LEAD;
+      }
+      break;
+    case PARSER_SKIP_FRAME:
+      if (self->remaining > len - i) {
+        self->remaining -= len - i;
+        i = len;
+        break;
+      }
+      i += self->remaining - 1;
+      self->state = PARSER_LEAD;
+      break;
+
+    case PARSER_H_VALUE:
+      if (c == '"' || c == '\'') {
+        self->quote = c;
+        self->state = PARSER_H_STRING;
+      } else if (c == '-' || isdigit(c)) {
+        self->quote = 0;
+        self->state = PARSER_H_NUMBER;
+      } else if (c == '.') {
+        self->quote = '.';
+        self->state = PARSER_H_NUMBER;
+      } else {
+        return parser_error(self, buf, len, i);
+      }
+      break;
+    case PARSER_H_NUMBER:
+      if (isdigit(c)) {
+        break;
+      }
+      if (c == '.' && self->quote == 0) {
+        self->quote = '.';
+        break;
+      }
+      self->num_values++;
+      self->state = PARSER_H_SEP;
+      goto human_sep;
+    case PARSER_H_STRING:
+      i = scan_delim(buf, i, len, self->quote, '\n', '\r');
+      if (i >= len) {
+        break;
+      }
+      c = buf[i];
+      if (c == self->quote) {
+        self->num_values++;
+        self->state = PARSER_H_SEP;
+      } else if (c == '\n' || c == '\r') {
+        return parser_error(self, buf, len, i);
+      }
+      break;
+    case PARSER_H_SEP:
+    human_sep:
+      if (c == '\n' || c == '\r') {
+        self->content = i;
+        self->scan = parser_eol(buf, len, i);
+        return self->scan;
+      }
+      if (c == ';') {
+        self->content = i;
+        self->state = PARSER_H_COMMENT;
+      } else if (isalpha(c)) {
+        self->state = PARSER_H_VALUE;
+      } else if (!isspace(c)) {
+        return parser_error(self, buf, len, i);
+      }
+      break;
+    case PARSER_H_COMMENT:
+      i = scan_delim(buf, i, len, '\n', '\r', '\n');
+      if (i < len) {
+        self->scan = parser_eol(buf, len, i);
+        return self->scan;
+      }
+      break;
+
+    case PARSER_F_LENGTH:
+      // The bits of the length are collected in remaining, and token counts
+      // how many have been read
+      self->remaining |= (size_t)(c & 0x7F) << self->token;
+      self->token += 7;
+      if (c & 0x80) {
+        if (self->token >= FRAME_LENGTH_BITS) {
+          return parser_error(self, buf, len, i);
+        }
+        break;
+      }
+      if (self->remaining < FRAME_MIN_CODE) {
+        return parser_error(self, buf, len, i);
+      }
+      self->frame = i + 1 + self->remaining;
+      self->state = PARSER_F_CODE;
+      break;
+    case PARSER_F_CODE:
+      // The length is only trusted once it is followed by a binary code
+      if ((c & 0x80) == 0) {
+        self->frame = 0;
+        return parser_error(self, buf, len, i);
+      }
+      self->start = i;
+      self->state = PARSER_B_PARAM;
+      goto binary_param;
+
+    case PARSER_B_PARAM:
+    binary_param:
+      // A framed code must leave room for its null and checksum
+      if (self->frame != 0 && i + 1 + checksum > self->frame) {
+        return parser_error(self, buf, len, i);
+      }
+      if (c == '\0') {
+        self->content = i;
+        self->remaining = checksum;
+        self->state = PARSER_B_CRC;
+        break;
+      }
+      if ((c & 0b00011111) < 1 || (c & 0b00011111) > PARAM_DELTA) {
+        return parser_error(self, buf, len, i);
+      }
+      self->token = i;
+      if ((c >> 5) == PARAM_T_STR) {
+        self->state = PARSER_B_STRING;
+      } else {
+        self->remaining = binary_width(c >> 5);
+        self->state = PARSER_B_VALUE;
+      }
+      break;
+    case PARSER_B_VALUE:
+      if (--self->remaining == 0) {
+        goto binary_end;
+      }
+      break;
+    case PARSER_B_STRING: {
+      size_t end = self->frame != 0 ? MIN(len, self->frame) : len;
+      i = scan_delim(buf, i, end, '\0', '\0', '\0');
+      if (i >= end) {
+        if (end < len) {
+          return parser_error(self, buf, len, end);
+        }
+        break;
+      }
+    }
+    binary_end:
+      self->crc = checksum_update(checksum, self->crc, buf + self->token,
+                                  i + 1 - self->token);
+      self->num_values++;
+      self->state = PARSER_B_PARAM;
+      break;
+    case PARSER_B_CRC:
+      // The checksum that was received is xored into the one that was
+      // calculated, which leaves 0 if they match
+      self->crc ^= (uint32_t)c << (8 * (checksum - self->remaining));
+      if (--self->remaining > 0) {
+        break;
+      }
+      if (self->frame != 0 && i + 1 != self->frame) {
+        return parser_error(self, buf, len, i);
+      }
+      self->state = PARSER_LEAD;
+      self->scan = i + 1;
+      if (self->crc != 0) {
+        return SCODE_ERROR_CRC;
+      }
+      while (self->scan < len && isspace(buf[self->scan])) {
+        self->scan++;
+      }
+      return self->scan;
+    }
+  }
+  self->scan = len;
+  return SCODE_ERROR_BUFFER;
+}
+
+/**
+ * Read the next value of a complete code
+ *
+ * @param pos position of the value, this is moved past the value
+ *
+ * @return any error codes
+ */
+static int parser_value(param_view_t *view, const char *buf, size_t *pos,
+                        size_t end, int is_binary) {
+  if (!is_binary) {
+    while (isspace(buf[*pos])) {
+      (*pos)++;
+    }
+  }
+  *pos += UNWRAP(param_view_parse(view, buf + *pos, end - *pos, is_binary));
+  return 0;
+}
+
+// Read the code number of a complete code
+static int parser_code(const code_parser_t *parser, uint8_t *category,
+                       uint8_t *number, const char *buf, size_t *pos,
+                       const code_view_t *decoded) {
+  if (decoded != NULL) {
+    *category = decoded->category;
+    *number = decoded->number;
+    *pos = parser->start;
+    return 1;
+  }
+  int is_binary = (buf[parser->start] & 0x80) != 0;
+  param_view_t code;
+  *pos = parser->start;
+  UNWRAP(parser_value(&code, buf, pos, parser->content, is_binary));
+  *category = is_binary ? buf[parser->start] : param_view_letter(&code);
+  *number = param_view_cast_u8(&code);
+  return is_binary;
+}
+
+// Read the next param of a complete code, or take it from a view of the code
+// that was already decoded
+static int parser_param(param_view_t *view, const code_view_t *decoded,
+                        size_t i, const char *buf, size_t *pos, size_t end,
+                        int is_binary) {
+  if (decoded != NULL) {
+    *view = decoded->params[i];
+    return 0;
+  }
+  return parser_value(view, buf, pos, end, is_binary);
+}
+
+/**
+ * Build a code out of a complete code that was read by parser_feed()
+ *
+ * @param arena where to allocate the params, or NULL for the heap
+ * @param decoded view of the code to build it from instead, or NULL
+ */
+static int parser_build(const code_parser_t *parser, code_t *self,
+                        const char *buf, scode_arena_t *arena,
+                        const code_view_t *decoded) {
+  size_t pos;
+  size_t num_params =
+      decoded != NULL ? decoded->num_params : parser->num_values - 1;
+  int is_binary = UNWRAP(
+      parser_code(parser, &self->category, &self->number, buf, &pos, decoded));
+
+  self->flags = arena != NULL ? CODE_FLAG_ARENA : 0;
+  self->num_params = num_params;
+  self->mask = 0;
+  if (num_params <= UINT8_MAX) {
+    self->flags |= CODE_FLAG_LOOKUP;
+  }
+  UNWRAP(code_alloc_params(self, num_params, arena));
+  if (num_params == 0) {
+    return 0;
+  }
+  for (size_t i = 0; i < num_params; ++i) {
+    param_view_t view;
+    int res = parser_param(&view, decoded, i, buf, &pos, parser->content,
+                           is_binary);
+    if (res >= 0) {
+      res = param_view_copy_to(&self->params[i], &view, arena);
+    }
+    if (res < 0) {
+      self->params[i].param = 0;
+      free_code(self);
+      return res;
+    }
+    code_lookup_add(self, i);
+  }
+  self->params[num_params].param = 0;
+  self->params[num_params].str = NULL;
+  return 0;
+}
+
+/**
+ * Build a code out of a complete code, reusing the memory the code already has
+ *
+ * @param decoded view of the code to build it from instead, or NULL
+ */
+static int parser_build_into(const code_parser_t *parser, code_t *self,
+                             const char *buf, const code_view_t *decoded) {
+  size_t num_params =
+      decoded != NULL ? decoded->num_params : parser->num_values - 1;
+  size_t old_params = 0;
+  size_t pos;
+  int is_binary = UNWRAP(
+      parser_code(parser, &self->category, &self->number, buf, &pos, decoded));
+  if (self->flags & CODE_FLAG_ARENA) {
+    self->params = NULL;
+  }
+  while (self->params != NULL && self->params[old_params].param != 0) {
+    old_params++;
+  }
+  if (self->params == NULL) {
+    self->flags = 0;
+    UNWRAP(code_alloc_params(self, num_params, NULL));
+  }
+
+  // Grow the array if the code doesn't fit. A heap array is kept even when a
+  // later code would fit inline, so that switching back and forth is free.
+  int is_inline = (self->flags & CODE_FLAG_INLINE) != 0;
+  size_t cap = is_inline ? SCODE_INLINE_PARAMS : self->params_cap;
+  if (num_params > cap) {
+    cap = MAX(num_params, cap * 2);
+    param_t *params = is_inline ? NULL : self->params;
+    params = scode_realloc(params, sizeof(param_t) * (cap + 1));
+    if (params == NULL) {
+      free_code(self);
+      return SCODE_ERROR_MEMORY;
+    }
+#if SCODE_INLINE_PARAMS > 0
+    if (is_inline) {
+      memcpy(params, self->inline_params, sizeof(param_t) * (old_params + 1));
+    }
+#endif
+    self->params = params;
+    self->params_cap = cap;
+    is_inline = 0;
+  }
+
+  self->flags = is_inline ? CODE_FLAG_INLINE : 0;
+  if (num_params <= UINT8_MAX) {
+    self->flags |= CODE_FLAG_LOOKUP;
+  }
+  self->num_params = num_params;
+  self->mask = 0;
+  for (size_t i = 0; i < num_params; ++i) {
+    param_view_t view;
+    int res = parser_param(&view, decoded, i, buf, &pos, parser->content,
+                           is_binary);
+    if (res >= 0) {
+      res = i < old_params ? param_view_copy_into(&self->params[i], &view)
+                           : param_view_copy_to(&self->params[i], &view, NULL);
+    }
+    if (res < 0) {
+      for (size_t j = i; j < old_params; ++j) {
+        free_param(&self->params[j]);
+      }
+      self->params[i].param = 0;
+      free_code(self);
+      return res;
+    }
+    code_lookup_add(self, i);
+  }
+  for (size_t i = num_params; i < old_params; ++i) {
+    free_param(&self->params[i]);
+  }
+  if (self->params != NULL) {
+    self->params[num_params].param = 0;
+    self->params[num_params].str = NULL;
+  }
+  return 0;
+}
+
+/**
+ * Build a code view out of a complete code that was read by parser_feed()
+ */
+static int parser_build_view(const code_parser_t *parser, code_view_t *self,
+                             param_view_t *params, const char *buf) {
+  size_t pos;
+  int is_binary = UNWRAP(
+      parser_code(parser, &self->category, &self->number, buf, &pos, NULL));
+
+  self->params = params;
+  self->num_params = parser->num_values - 1;
+  for (size_t i = 0; i < self->num_params; ++i) {
+    UNWRAP(parser_value(&params[i], buf, &pos, parser->content, is_binary));
+  }
+  return 0;
+}
+
+int code_parse(code_t *self, const char *buf, size_t len) {
+  return code_parse_checksum(self, buf, len, SCODE_CHECKSUM_CRC8);
+}
+
+int code_parse_checksum(code_t *self, const char *buf, size_t len,
+                        uint8_t checksum) {
+  code_parser_t parser = {0};
+  parser.checksum = checksum;
+  int res = parser_feed(&parser, buf, len);
+  if (res < 0) {
+    return res;
+  }
+  UNWRAP(parser_build(&parser, self, buf, NULL, NULL));
+  return res;
+}
+
+int code_parse_arena(code_t *self, const char *buf, size_t len,
+                     scode_arena_t *arena) {
+  code_parser_t parser = {0};
+  int res = parser_feed(&parser, buf, len);
+  if (res < 0) {
+    return res;
+  }
+  UNWRAP(parser_build(&parser, self, buf, arena, NULL));
+  return res;
+}
+
+// Drop the rest of an invalid code, returning the number of bytes skipped
+static size_t parser_skip(code_parser_t *self, const char *buf, size_t len) {
+  size_t i = 0;
+  if (self->state == PARSER_SKIP_FRAME) {
+    if (self->remaining > len) {
+      return len;
+    }
+    self->state = PARSER_LEAD;
+    return self->remaining;
+  }
+  if (self->state == PARSER_SKIP) {
+    i = scan_delim(buf, 0, len, '\n', '\r', '\0');
+    if (i >= len) {
+      return len;
+    }
+    if (buf[i] != '\0') {
+      self->state = PARSER_LEAD;
+      return parser_eol(buf, len, i);
+    }
+    self->state = PARSER_SKIP_CRC;
+    self->remaining = checksum_width(self->checksum);
+    i++;
+  }
+  if (self->state == PARSER_SKIP_CRC) {
+    size_t n = MIN(self->remaining, len - i);
+    self->remaining -= n;
+    i += n;
+    if (self->remaining == 0) {
+      self->state = PARSER_LEAD;
+    }
+  }
+  return i;
+}
+
+// Find the next code after any empty lines. An invalid code is skipped, and
+// pos is moved past everything that was read. A complete code is left for the
+// caller to build at pos.
+static int parser_next(code_parser_t *self, const char *buf, size_t len,
+                       size_t *pos) {
+  int res;
+  while ((res = parser_feed(self, buf + *pos, len - *pos)) ==
+         SCODE_ERROR_EMPTY) {
+    *pos += self->scan;
+    parser_reset(self);
+  }
+  if (res < 0 && res != SCODE_ERROR_BUFFER) {
+    *pos += self->scan;
+    parser_reset(self);
+    *pos += parser_skip(self, buf + *pos, len - *pos);
+  }
+  return res;
+}
+
+int code_parse_next(code_t *self, const char *buf, size_t len,
+                    size_t *consumed, scode_arena_t *arena) {
+  return code_parse_next_checksum(self, buf, len, consumed, arena,
+                                  SCODE_CHECKSUM_CRC8);
+}
+
+int code_parse_next_checksum(code_t *self, const char *buf, size_t len,
+                             size_t *consumed, scode_arena_t *arena,
+                             uint8_t checksum) {
+  code_parser_t parser = {0};
+  parser.checksum = checksum;
+  size_t pos = 0;
+  int res = parser_next(&parser, buf, len, &pos);
+  if (res > 0) {
+    res = parser_build(&parser, self, buf + pos, arena, NULL);
+    pos += parser.scan;
+  }
+  *consumed = pos;
+  return res;
+}
+
+int code_parse_next_view(code_view_t *self, param_view_t *params,
+                         size_t max_params, const char *buf, size_t len,
+                         size_t *consumed) {
+  return code_parse_next_view_checksum(self, params, max_params, buf, len,
+                                       consumed, SCODE_CHECKSUM_CRC8);
+}
+
+int code_parse_next_view_checksum(code_view_t *self, param_view_t *params,
+                                  size_t max_params, const char *buf,
+                                  size_t len, size_t *consumed,
+                                  uint8_t checksum) {
+  code_parser_t parser = {0};
+  parser.checksum = checksum;
+  size_t pos = 0;
+  int res = parser_next(&parser, buf, len, &pos);
+  if (res > 0) {
+    if (parser.num_values - 1 > max_params) {
+      *consumed = pos + parser.scan;
+      return SCODE_ERROR_MEMORY;
+    }
+    res = parser_build_view(&parser, self, params, buf + pos);
+    pos += parser.scan;
+  }
+  *consumed = pos;
+  return res;
+}
+
+int code_parse_view(code_view_t *self, param_view_t *params, size_t max_params,
+                    const char *buf, size_t len) {
+  return code_parse_view_checksum(self, params, max_params, buf, len,
+                                  SCODE_CHECKSUM_CRC8);
+}
+
+int code_parse_view_checksum(code_view_t *self, param_view_t *params,
+                             size_t max_params, const char *buf, size_t len,
+                             uint8_t checksum) {
+  code_parser_t parser = {0};
+  parser.checksum = checksum;
+  int res = parser_feed(&parser, buf, len);
+  if (res < 0) {
+    return res;
+  }
+  if (parser.num_values - 1 > max_params) {
+    return SCODE_ERROR_MEMORY;
+  }
+  UNWRAP(parser_build_view(&parser, self, params, buf));
+  return res;
+}
+
+void scode_quant_set(scode_quant_t *self, char letter, double scale,
+                     uint8_t type) {
+  int index = LOOKUP_INDEX(letter);
+  if (index >= 0 && index < 26) {
+    self->scale[index] = scale;
+    self->type[index] = type;
+  }
+}
+
+// Get the param that is sent for a param of a quantized letter
+static param_t param_quantize(const param_t *self,
+                              const scode_quant_t *profile) {
+  uint8_t type = param_type(self);
+  // Binary params can have letters after 'Z', which are never quantized
+  uint32_t index = LOOKUP_INDEX(self->param);
+  if (type == PARAM_T_STR || index >= 26 || profile->scale[index] == 0) {
+    return param_narrow(self);
+  }
+  double scale = profile->scale[index];
+  param_t p = *self;
+  double value = param_cast_f64(self);
+  // Checked before rounding so that NaN and huge values never get converted
+  double steps = value * scale;
+  double rounding = steps < 0 ? -0.5 : 0.5;
+  if (profile->type[index] == PARAM_T_I16) {
+    if (steps > INT16_MIN - 0.5 && steps < INT16_MAX + 0.5) {
+      set_type(&p, PARAM_T_I16);
+      p.i16 = (int16_t)(steps + rounding);
+      return p;
+    }
+  } else if (steps > INT32_MIN - 0.5 && steps < INT32_MAX + 0.5) {
+    set_type(&p, PARAM_T_I32);
+    p.i32 = (int32_t)(steps + rounding);
+    return p;
+  }
+  // Floats are never dequantized, so a value that doesn't fit is sent as one
+  if (type != PARAM_T_F32) {
+    set_type(&p, PARAM_T_F64);
+    p.f64 = value;
+  }
+  return param_narrow(&p);
+}
+
+// Get the type and value of a quantized param from its steps. A float is
+// used while it can tell the steps apart.
+static uint8_t param_dequantize(int64_t steps, double scale, double *value) {
+  *value = steps / scale;
+  if (steps >= -(1 << FLT_MANT_DIG) && steps <= (1 << FLT_MANT_DIG)) {
+    return PARAM_T_F32;
+  }
+  return PARAM_T_F64;
+}
+
+void code_dequantize(code_t *self, const scode_quant_t *profile) {
+  if (!code_is_binary(self)) {
+    return;
+  }
+  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
+    param_t *p = &self->params[i];
+    uint8_t type = param_type(p);
+    uint32_t index = LOOKUP_INDEX(p->param);
+    if (index >= 26 || profile->scale[index] == 0 || type == PARAM_T_STR ||
+        type == PARAM_T_F32 || type == PARAM_T_F64) {
+      continue;
+    }
+    double scale = profile->scale[index];
+    double value;
+    type = param_dequantize(param_cast_i64(p), scale, &value);
+    set_type(p, type);
+    if (type == PARAM_T_F32) {
+      p->f32 = (float)value;
+    } else {
+      p->f64 = value;
+    }
+  }
+}
+
+// Dequantize the params of a view of a binary code
+static void code_view_dequantize(param_view_t *params, size_t num_params,
+                                 const scode_quant_t *profile) {
+  for (size_t i = 0; i < num_params; ++i) {
+    param_view_t *p = &params[i];
+    uint8_t type = param_view_type(p);
+    uint32_t index = LOOKUP_INDEX(p->param);
+    if (index >= 26 || profile->scale[index] == 0 || type == PARAM_T_STR ||
+        type == PARAM_T_F32 || type == PARAM_T_F64) {
+      continue;
+    }
+    double scale = profile->scale[index];
+    double value;
+    type = param_dequantize(param_view_cast_i64(p), scale, &value);
+    p->param = (p->param & 0b00011111) | (type << 5);
+    if (type == PARAM_T_F32) {
+      p->f32 = (float)value;
+    } else {
+      p->f64 = value;
+    }
+  }
+}
+
+code_delta_t init_code_delta(void) {
+  code_delta_t self;
+  code_delta_reset(&self);
+  return self;
+}
+
+void code_delta_reset(code_delta_t *self) {
+  self->known = 0;
+  self->num_prev = 0;
+}
+
+static int param_is_int(const param_t *self) {
+  uint8_t type = param_type(self);
+  return type != PARAM_T_STR && type != PARAM_T_F32 && type != PARAM_T_F64;
+}
+
+// Whether a param can be rebuilt from the last value of its letter. Floats
+// have to be the same bits, so that -0.0 isn't turned into 0.0.
+static int delta_same(const param_t *self, const param_t *last) {
+  uint8_t type = param_type(self);
+  if (type == PARAM_T_STR) {
+    return 0;
+  }
+  if (type == PARAM_T_F32 || type == PARAM_T_F64 || !param_is_int(last)) {
+    return type == param_type(last) &&
+           memcmp(&self->i64, &last->i64, binary_width(type)) == 0;
+  }
+  return param_cast_i64(self) == param_cast_i64(last);
+}
+
+// Remember a param of the code that was just sent or rebuilt, in order
+static void delta_remember(code_delta_t *self, uint8_t param, int64_t bits) {
+  uint32_t index = LOOKUP_INDEX(param);
+  // Letters after 'Z' are always sent in full, like in delta_plan()
+  if (index >= 26) {
+    return;
+  }
+  if ((param >> 5) == PARAM_T_STR) {
+    self->known &= ~(1u << index);
+  } else {
+    self->last[index].param = param;
+    self->last[index].i64 = bits;
+    self->known |= 1u << index;
+  }
+  if (self->num_prev < CODE_DELTA_PREV) {
+    self->prev[self->num_prev++] = index;
+  }
+}
+
+/**
+ * Decide how a param is sent in a delta coded code
+ *
+ * @param p param as it would be sent on its own, which is replaced by the
+ * difference if that is shorter
+ * @param sent number of params that were sent so far
+ * @param repeat mask of the params of the last code that are repeated
+ * @param diff mask of the params that are sent as a difference
+ *
+ * @return whether the param is sent
+ */
+static int delta_plan(const code_delta_t *self, param_t *p, size_t sent,
+                      uint32_t *repeat, uint32_t *diff) {
+  uint32_t index = LOOKUP_INDEX(p->param);
+  if (index >= 26 || (self->known & (1u << index)) == 0) {
+    return 1;
+  }
+  const param_t *last = &self->last[index];
+  if (delta_same(p, last)) {
+    for (size_t i = 0; i < self->num_prev; ++i) {
+      if (self->prev[i] == index && (*repeat & (1u << i)) == 0) {
+        *repeat |= 1u << i;
+        return 0;
+      }
+    }
+  }
+  if (sent < 32 && param_is_int(p) && param_is_int(last)) {
+    int64_t val = param_cast_i64(p);
+    int64_t from = param_cast_i64(last);
+    // Both are kept small enough that the difference can't overflow
+    if (val >= INT32_MIN && val <= INT32_MAX && from >= INT32_MIN &&
+        from <= INT32_MAX) {
+      param_t d = init_param_i64('A' + index, val - from);
+      d = param_narrow(&d);
+      if (binary_width(param_type(&d)) < binary_width(param_type(p))) {
+        *p = d;
+        *diff |= 1u << sent;
+      }
+    }
+  }
+  return 1;
+}
+
+// The param as it is sent before delta coding
+static param_t delta_encode(const param_t *self, const scode_quant_t *quant) {
+  return quant != NULL ? param_quantize(self, quant) : param_narrow(self);
+}
+
+/**
+ * Make the param that tells the receiver how a code was delta coded
+ *
+ * The low bits are the params of the last code that are repeated, and the
+ * bits above those are the params that are sent as a difference.
+ */
+static param_t delta_mask(const code_delta_t *self, uint32_t repeat,
+                          uint32_t diff) {
+  param_t p = init_param_i64('A', repeat | (uint64_t)diff << self->num_prev);
+  p = param_narrow(&p);
+  p.param = (p.param & 0b11100000) | PARAM_DELTA;
+  return p;
+}
+
+int code_dump_binary_delta(const code_t *self, char *buf, size_t len,
+                           code_delta_t *state, const scode_quant_t *quant) {
+  return code_dump_binary_delta_checksum(self, buf, len, state, quant,
+                                         SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_delta_checksum(const code_t *self, char *buf, size_t len,
+                                    code_delta_t *state,
+                                    const scode_quant_t *quant,
+                                    uint8_t checksum) {
+  checksum = checksum_width(checksum);
+  // Decisions are made against the state before the code
+  code_delta_t before = *state;
+  uint32_t repeat = 0;
+  uint32_t diff = 0;
+  size_t sent = 0;
+  // The code, the null and the checksum
+  size_t size = 3 + checksum;
+  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
+    param_t p = delta_encode(&self->params[i], quant);
+    if (delta_plan(&before, &p, sent, &repeat, &diff)) {
+      size += UNWRAP(param_dump_binary_size(&p));
+      sent++;
+    }
+  }
+  param_t mask = delta_mask(&before, repeat, diff);
+  if (repeat != 0 || diff != 0) {
+    size += param_dump_binary_size(&mask);
+  }
+  BUF_ASSERT_LEN(len, size);
+
+  buf[0] = (self->category & 0b00011111) | (PARAM_T_U8 << 5);
+  buf[1] = self->number;
+  size_t pos = 2;
+  if (repeat != 0 || diff != 0) {
+    pos += param_write_binary(&mask, buf + pos);
+  }
+  // Remember the code the way the receiver rebuilds it
+  uint32_t repeated = 0;
+  uint32_t diffs = 0;
+  state->num_prev = 0;
+  sent = 0;
+  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
+    param_t p = delta_encode(&self->params[i], quant);
+    param_t rebuilt = p;
+    if (delta_plan(&before, &p, sent, &repeated, &diffs)) {
+      pos += param_write_binary(&p, buf + pos);
+      delta_remember(state, rebuilt.param, rebuilt.i64);
+      sent++;
+    }
+  }
+  for (size_t i = 0; i < before.num_prev; ++i) {
+    if (repeat & (1u << i)) {
+      const param_t *last = &before.last[before.prev[i]];
+      delta_remember(state, last->param, last->i64);
+    }
+  }
+
+  return checksum_write(checksum, buf, pos);
+}
+
+// View of a number in a param
+static param_view_t delta_view(const param_t *self) {
+  param_view_t view;
+  view.param = self->param;
+  view.i64 = self->i64;
+  view.len = 0;
+  return view;
+}
+
+/**
+ * Rebuild a delta coded binary code in place
+ *
+ * @param params params of the code, with room after them for the params of the
+ * last code
+ */
+static int delta_decode(code_delta_t *self, code_view_t *code,
+                        param_view_t *params) {
+  uint64_t mask = 0;
+  size_t n = 0;
+  for (size_t i = 0; i < code->num_params; ++i) {
+    if ((params[i].param & 0b00011111) == PARAM_DELTA) {
+      mask = (uint64_t)param_view_cast_i64(&params[i]);
+    } else {
+      params[n++] = params[i];
+    }
+  }
+  uint32_t repeat = (uint32_t)(mask & ((1ull << self->num_prev) - 1));
+  uint64_t diff = mask >> self->num_prev;
+  if (n < 64 && diff >> n != 0) {
+    goto fail;
+  }
+  for (size_t i = 0; i < n && diff != 0; ++i) {
+    if ((diff & (1ull << i)) == 0) {
+      continue;
+    }
+    uint32_t index = LOOKUP_INDEX(params[i].param);
+    uint8_t type = param_view_type(&params[i]);
+    const param_t *last = &self->last[index];
+    if ((self->known & (1u << index)) == 0 || !param_is_int(last) ||
+        type == PARAM_T_STR || type == PARAM_T_F32 || type == PARAM_T_F64) {
+      goto fail;
+    }
+    int64_t val = param_cast_i64(last) + param_view_cast_i64(&params[i]);
+    param_t p = init_param_i64('A' + index, val);
+    p = param_narrow(&p);
+    params[i] = delta_view(&p);
+  }
+  for (size_t i = 0; i < self->num_prev; ++i) {
+    if (repeat & (1u << i)) {
+      if ((self->known & (1u << self->prev[i])) == 0) {
+        goto fail;
+      }
+      params[n++] = delta_view(&self->last[self->prev[i]]);
+    }
+  }
+  code->num_params = n;
+
+  self->num_prev = 0;
+  for (size_t i = 0; i < n; ++i) {
+    delta_remember(self, params[i].param, params[i].i64);
+  }
+  return 0;
+
+fail:
+  code_delta_reset(self);
+  return SCODE_ERROR_PARSE;
+}
+
+// Write a binary code into a buffer that is known to be big enough. Each
+// param is quantized if there is a profile, or else narrowed if narrow is set.
+static size_t code_write_binary(const code_t *self, char *buf, int narrow,
+                                const scode_quant_t *quant, uint8_t checksum) {
+  buf[0] = (self->category & 0b00011111) | (PARAM_T_U8 << 5);
+  buf[1] = self->number;
+  size_t pos = 2;
+  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
+    const param_t *p = &self->params[i];
+    param_t encoded;
+    if (quant != NULL) {
+      encoded = param_quantize(p, quant);
+      p = &encoded;
+    } else if (narrow) {
+      encoded = param_narrow(p);
+      p = &encoded;
+    }
+    pos += param_write_binary(p, buf + pos);
+  }
+  return checksum_write(checksum, buf, pos);
+}
+
+int code_dump_binary(const code_t *self, char *buf, size_t len) {
+  return code_dump_binary_checksum(self, buf, len, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_checksum(const code_t *self, char *buf, size_t len,
+                              uint8_t checksum) {
+  int size = UNWRAP(code_dump_binary_checksum_size(self, checksum));
+  BUF_ASSERT_LEN(len, (size_t)size);
+  return code_write_binary(self, buf, 0, NULL, checksum_width(checksum));
+}
+
+int code_dump_binary_narrow(const code_t *self, char *buf, size_t len) {
+  return code_dump_binary_narrow_checksum(self, buf, len, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_narrow_checksum(const code_t *self, char *buf, size_t len,
+                                     uint8_t checksum) {
+  int size = UNWRAP(code_dump_binary_narrow_checksum_size(self, checksum));
+  BUF_ASSERT_LEN(len, (size_t)size);
+  return code_write_binary(self, buf, 1, NULL, checksum_width(checksum));
+}
+
+int code_dump_binary_quant(const code_t *self, char *buf, size_t len,
+                           const scode_quant_t *profile) {
+  return code_dump_binary_quant_checksum(self, buf, len, profile,
+                                         SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_quant_checksum(const code_t *self, char *buf, size_t len,
+                                    const scode_quant_t *profile,
+                                    uint8_t checksum) {
+  int size =
+      UNWRAP(code_dump_binary_quant_checksum_size(self, profile, checksum));
+  BUF_ASSERT_LEN(len, (size_t)size);
+  return code_write_binary(self, buf, 1, profile, checksum_width(checksum));
+}
+
+int code_dump_binary_batch(const code_t *codes, size_t num_codes, char *buf,
+                           size_t len, size_t *offsets) {
+  return code_dump_binary_batch_checksum(codes, num_codes, buf, len, offsets,
+                                         SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_batch_checksum(const code_t *codes, size_t num_codes,
+                                    char *buf, size_t len, size_t *offsets,
+                                    uint8_t checksum) {
+  size_t pos = 0;
+  for (size_t i = 0; i < num_codes; ++i) {
+    int size = UNWRAP(code_dump_binary_checksum_size(&codes[i], checksum));
+    BUF_ASSERT_LEN(len - pos, (size_t)size);
+    if (offsets != NULL) {
+      offsets[i] = pos;
+    }
+    pos += code_write_binary(&codes[i], buf + pos, 0, NULL,
+                             checksum_width(checksum));
+  }
+  return pos;
+}
+
+// Length of the header in front of a framed code of code_len bytes
+static size_t frame_header_size(size_t code_len) {
+  size_t size = 2;
+  for (; code_len >= 0x80; code_len >>= 7) {
+    size++;
+  }
+  return size;
+}
+
+static size_t frame_write_header(char *buf, size_t code_len) {
+  size_t pos = 0;
+  buf[pos++] = CODE_FRAME_SYNC;
+  for (; code_len >= 0x80; code_len >>= 7) {
+    buf[pos++] = (code_len & 0x7F) | 0x80;
+  }
+  buf[pos++] = code_len;
+  return pos;
+}
+
+int code_dump_binary_framed(const code_t *self, char *buf, size_t len) {
+  return code_dump_binary_framed_checksum(self, buf, len, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_framed_checksum(const code_t *self, char *buf, size_t len,
+                                     uint8_t checksum) {
+  size_t size = UNWRAP(code_dump_binary_checksum_size(self, checksum));
+  size_t header = frame_header_size(size);
+  BUF_ASSERT_LEN(len, header + size);
+  frame_write_header(buf, size);
+  return header + code_write_binary(self, buf + header, 0, NULL,
+                                    checksum_width(checksum));
+}
+
+int code_frame(char *buf, size_t len, size_t code_len) {
+  size_t header = frame_header_size(code_len);
+  if (code_len >> FRAME_LENGTH_BITS != 0) {
+    return SCODE_ERROR_BUFFER;
+  }
+  BUF_ASSERT_LEN(len, header + code_len);
+  memmove(buf + header, buf, code_len);
+  frame_write_header(buf, code_len);
+  return header + code_len;
+}
+
+int code_frame_size(const char *buf, size_t len, size_t *header) {
+  if (len == 0) {
+    return SCODE_ERROR_BUFFER;
+  }
+  if ((uint8_t)buf[0] != CODE_FRAME_SYNC) {
+    return SCODE_ERROR_PARSE;
+  }
+  size_t code_len = 0;
+  for (size_t i = 1; i * 7 <= FRAME_LENGTH_BITS; ++i) {
+    if (i >= len) {
+      return SCODE_ERROR_BUFFER;
+    }
+    uint8_t c = buf[i];
+    code_len |= (size_t)(c & 0x7F) << (7 * (i - 1));
+    if ((c & 0x80) == 0) {
+      if (code_len < FRAME_MIN_CODE) {
+        return SCODE_ERROR_PARSE;
+      }
+      *header = i + 1;
+      return i + 1 + code_len;
+    }
+  }
+  return SCODE_ERROR_PARSE;
+}
+
+static int code_dump_human_decimals(const code_t *self, char *buf, size_t len,
+                                   int decimals) {
+  size_t pos = 0;
   param_t start = init_param_u8(self->category, self->number);
   pos += UNWRAP(param_dump_human(&start, buf, len));
-  BUF_SET(buf, len, pos, ' ');
-  pos++;
   for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
-    pos += UNWRAP(param_dump_human(&self->params[i], buf + pos, len - pos));
     BUF_SET(buf, len, pos, ' ');
     pos++;
+    pos += UNWRAP(param_dump_human_decimals(&self->params[i], buf + pos,
+                                            len - pos, decimals));
   }
-  buf[pos - 1] = '\r';
   BUF_SET(buf, len, pos, '\n');
   pos++;
-  buf[pos] = '\0';
+  if (pos < len) {
+    buf[pos] = '\0';
+  }
   return pos;
 }
 
+int code_dump_human(const code_t *self, char *buf, size_t len) {
+  return code_dump_human_decimals(self, buf, len, -1);
+}
+
+int code_dump_human_fixed(const code_t *self, char *buf, size_t len,
+                          uint8_t decimals) {
+  return code_dump_human_decimals(self, buf, len, decimals);
+}
+
+// Number of bytes code_write_binary() writes
+static int code_binary_size(const code_t *self, int narrow,
+                            const scode_quant_t *quant, uint8_t checksum) {
+  // The code, its params, and the null and checksum at the end
+  size_t size = 3 + checksum;
+  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
+    const param_t *p = &self->params[i];
+    param_t encoded;
+    if (quant != NULL) {
+      encoded = param_quantize(p, quant);
+      p = &encoded;
+    } else if (narrow) {
+      encoded = param_narrow(p);
+      p = &encoded;
+    }
+    size += UNWRAP(param_dump_binary_size(p));
+  }
+  return size;
+}
+
+int code_dump_binary_size(const code_t *self) {
+  return code_binary_size(self, 0, NULL, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_checksum_size(const code_t *self, uint8_t checksum) {
+  return code_binary_size(self, 0, NULL, checksum_width(checksum));
+}
+
+int code_dump_binary_narrow_size(const code_t *self) {
+  return code_binary_size(self, 1, NULL, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_narrow_checksum_size(const code_t *self,
+                                          uint8_t checksum) {
+  return code_binary_size(self, 1, NULL, checksum_width(checksum));
+}
+
+int code_dump_binary_quant_size(const code_t *self,
+                                const scode_quant_t *profile) {
+  return code_binary_size(self, 1, profile, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_quant_checksum_size(const code_t *self,
+                                         const scode_quant_t *profile,
+                                         uint8_t checksum) {
+  return code_binary_size(self, 1, profile, checksum_width(checksum));
+}
+
+int code_dump_binary_framed_size(const code_t *self) {
+  return code_dump_binary_framed_checksum_size(self, SCODE_CHECKSUM_CRC8);
+}
+
+int code_dump_binary_framed_checksum_size(const code_t *self,
+                                          uint8_t checksum) {
+  size_t size =
+      UNWRAP(code_binary_size(self, 0, NULL, checksum_width(checksum)));
+  return frame_header_size(size) + size;
+}
+
+static int code_dump_human_decimals_size(const code_t *self, int decimals) {
+  // The letter, number and line ending
+  size_t size = 2 + format_int_size(self->number);
+  for (int i = 0; self->params != NULL && self->params[i].param != 0; ++i) {
+    size += 1 + UNWRAP(param_dump_human_decimals_size(&self->params[i],
+                                                      decimals));
+  }
+  return size;
+}
+
+int code_dump_human_size(const code_t *self) {
+  return code_dump_human_decimals_size(self, -1);
+}
+
+int code_dump_human_fixed_size(const code_t *self, uint8_t decimals) {
+  return code_dump_human_decimals_size(self, decimals);
+}
+
+int code_dump_binary_alloc(const code_t *self, char **buf) {
+  *buf = NULL;
+  int size = UNWRAP(code_dump_binary_size(self));
+  char *out = scode_malloc(size);
+  if (out == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  int res = code_dump_binary(self, out, size);
+  if (res < 0) {
+    scode_free(out);
+    return res;
+  }
+  *buf = out;
+  return res;
+}
+
+static int code_dump_human_decimals_alloc(const code_t *self, char **buf,
+                                         int decimals) {
+  *buf = NULL;
+  int size = UNWRAP(code_dump_human_decimals_size(self, decimals));
+  char *out = scode_malloc(size + 1);
+  if (out == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  int res = code_dump_human_decimals(self, out, size + 1, decimals);
+  if (res < 0) {
+    scode_free(out);
+    return res;
+  }
+  *buf = out;
+  return res;
+}
+
+int code_dump_human_alloc(const code_t *self, char **buf) {
+  return code_dump_human_decimals_alloc(self, buf, -1);
+}
+
+int code_dump_human_fixed_alloc(const code_t *self, char **buf,
+                                uint8_t decimals) {
+  return code_dump_human_decimals_alloc(self, buf, decimals);
+}
+
 char code_letter(const code_t *self) {
   return (self->category & 0b00011111) | 0b01000000;
 }
 
 int code_is_binary(const code_t *self) { return (self->category & 0x80) != 0; }
 
+char code_view_letter(const code_view_t *self) {
+  return (self->category & 0b00011111) | 0b01000000;
+}
+
+int code_view_is_binary(const code_view_t *self) {
+  return (self->category & 0x80) != 0;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void free_code_stream(code_stream_t *self) {
-  if (self->buf != NULL) {
-    free(self->buf);
-    self->buf = NULL;
+  if (self->buf != NULL && (self->flags & CODE_STREAM_FLAG_STATIC) == 0) {
+    scode_free(self->buf);
+  }
+  self->buf = NULL;
+  self->cap = 0;
+  if (self->views != NULL) {
+    scode_free(self->views);
+    self->views = NULL;
+    self->views_cap = 0;
   }
 }
 
@@ -804,100 +3679,277 @@ code_stream_t init_code_stream(size_t capacity) {
   stream.end = 0;
   stream.pos = 0;
   stream.cap = capacity;
-  if (capacity > 0) {
-    stream.buf = malloc(capacity);
-  } else {
-    stream.buf = NULL;
+  stream.max_cap = 0;
+  stream.quant = NULL;
+  stream.delta = NULL;
+  stream.flags = 0;
+  memset(&stream.parser, 0, sizeof(code_parser_t));
+  stream.views = NULL;
+  stream.views_cap = 0;
+  stream.buf = capacity > 0 ? scode_malloc(capacity) : NULL;
+  if (stream.buf == NULL) {
+    stream.cap = 0;
   }
   return stream;
 }
 
-void code_stream_update(code_stream_t *self, const char *buf, size_t len) {
-  size_t new_end = self->end + len;
-  if (new_end > self->cap) {
-    // Not enough space
-    if (new_end - self->pos <= self->cap) {
-      // Move around data
-      memmove(self->buf, &self->buf[self->pos], self->end - self->pos);
-      self->end = self->end - self->pos;
-      self->pos = 0;
-    } else {
-      // Allocate some new data
-      char *new_buf = malloc(new_end - self->pos);
-      if (self->buf != NULL) {
-        memcpy(new_buf, &self->buf[self->pos], self->end - self->pos);
-        free(self->buf);
-      }
-      self->buf = new_buf;
-      self->cap = new_end - self->pos;
-      self->end = self->end - self->pos;
+code_stream_t init_code_stream_static(char *buf, size_t capacity) {
+  code_stream_t stream = init_code_stream(0);
+  stream.flags = CODE_STREAM_FLAG_STATIC;
+  if (buf != NULL) {
+    stream.buf = buf;
+    stream.cap = capacity;
+    stream.max_cap = capacity;
+  }
+  return stream;
+}
+
+void code_stream_set_quant(code_stream_t *self, const scode_quant_t *profile) {
+  self->quant = profile;
+}
+
+void code_stream_set_delta(code_stream_t *self, code_delta_t *state) {
+  self->delta = state;
+}
+
+void code_stream_set_checksum(code_stream_t *self, uint8_t checksum) {
+  self->parser.checksum = checksum_width(checksum);
+}
+
+void code_stream_set_limit(code_stream_t *self, size_t max_capacity) {
+  // A static buffer is always the limit
+  if ((self->flags & CODE_STREAM_FLAG_STATIC) == 0) {
+    self->max_cap = max_capacity;
+  }
+}
+
+// Make room for len more bytes, returning how many of them fit
+static size_t code_stream_reserve(code_stream_t *self, size_t len) {
+  size_t live = self->end - self->pos;
+  size_t max = self->max_cap != 0 ? self->max_cap : SIZE_MAX;
+  if (self->end + len <= self->cap) {
+    return len;
+  }
+
+  // Moving the data down costs as much as the data that is left. That is only
+  // paid for by the space it frees when at least as much has been popped, so
+  // otherwise grow and keep moves rare.
+  if ((live + len > self->cap || self->pos < live) && self->cap < max &&
+      (self->flags & CODE_STREAM_FLAG_STATIC) == 0) {
+    size_t cap = 16;
+    while ((cap < live + len || cap <= self->cap) && cap < max) {
+      cap <<= 1;
+    }
+    cap = MIN(cap, max);
+    char *buf = scode_malloc(cap);
+    if (buf != NULL) {
+      if (live > 0) {
+        memcpy(buf, &self->buf[self->pos], live);
+      }
+      scode_free(self->buf);
+      self->buf = buf;
+      self->cap = cap;
+      self->end = live;
       self->pos = 0;
     }
   }
+  if (self->end + len > self->cap && self->pos > 0) {
+    memmove(self->buf, &self->buf[self->pos], live);
+    self->end = live;
+    self->pos = 0;
+  }
+  return MIN(len, self->cap - self->end);
+}
 
-  memcpy(&self->buf[self->end], buf, len);
-  self->end += len;
+size_t code_stream_update(code_stream_t *self, const char *buf, size_t len) {
+  len = code_stream_reserve(self, len);
+  if (len > 0) {
+    memcpy(&self->buf[self->end], buf, len);
+    self->end += len;
+  }
+  return len;
 }
 
-int code_stream_pop(code_stream_t *self, code_t *code) {
+static void code_stream_consume(code_stream_t *self) {
+  self->pos += self->parser.scan;
+  parser_reset(&self->parser);
+}
+
+/**
+ * Read until the next complete code in the stream
+ *
+ * @return length of the code, or an SCODE_ERROR_X error
+ *
+ * When a code is found, it starts at self->pos and code_stream_consume() should
+ * be called once it has been built.
+ */
+static int code_stream_next(code_stream_t *self) {
   if (self->buf == NULL) {
     return SCODE_ERROR_BUFFER;
   }
-  int result = code_parse(code, &self->buf[self->pos], self->end - self->pos);
-  if (result > 0) {
-    self->pos += result;
-    return 0;
-  }
-  // Skip the code if an error occurred (except for buffer errors)
-  // This will not guarentee that the code is skipped, but that should be
-  // okay since if it is not, then the "next" code should be invalid.
-  switch (result) {
-  case SCODE_ERROR_PARSE:
-  case SCODE_ERROR_DUMP:
-    // Skip until after null termination
-    while (self->pos < self->end) {
-      char c = self->buf[self->pos++];
-      if (c == '\0') {
-        if (self->pos < self->end) {
-          self->pos++;
+  while (1) {
+    int result = parser_feed(&self->parser, &self->buf[self->pos],
+                             self->end - self->pos);
+    if (result == SCODE_ERROR_BUFFER) {
+      // Nothing that has been read so far is needed anymore
+      if (parser_idle(&self->parser)) {
+        code_stream_consume(self);
+      } else if (self->max_cap != 0 &&
+                 (self->end - self->pos >= self->max_cap ||
+                  self->parser.frame > self->max_cap)) {
+        // The code can't fit, so drop it and skip the rest of it. A frame is
+        // dropped as soon as its length is known.
+        if (self->parser.frame != 0) {
+          parser_frame_error(&self->parser, self->parser.scan, 0);
+        } else {
+          self->parser.state = PARSER_SKIP;
         }
-        break;
-      }
-      if (c == '\r') {
-        break;
-      }
-      if (c == '\n') {
-        break;
+        code_stream_consume(self);
+        return SCODE_ERROR_MEMORY;
       }
+      return result;
     }
-    break;
-  case SCODE_ERROR_CRC:
-    // Skip until after null termination
-    while (self->pos < self->end) {
-      char c = self->buf[self->pos++];
-      if (c == '\0') {
-        if (self->pos < self->end) {
-          self->pos++;
-        }
-        break;
-      }
+    if (result > 0) {
+      return result;
     }
-    break;
-  case SCODE_ERROR_EMPTY:
-    // Skip until newline and try again
-    while (self->pos < self->end) {
-      char c = self->buf[self->pos++];
-      if (c == '\n') {
-        break;
-      }
-      if (c == '\r') {
-        break;
+    // The code is popped even if an error occurred. If the code could not be
+    // parsed, the rest of it is skipped on the next call.
+    code_stream_consume(self);
+    if (result != SCODE_ERROR_EMPTY) {
+      return result;
+    }
+  }
+}
+
+/**
+ * Build a view of the code that code_stream_next() found, undoing its delta
+ * coding if the stream has a delta state
+ *
+ * @param views where the params of the view were put
+ */
+static int code_stream_build_view(code_stream_t *self, code_view_t *code,
+                                  param_view_t **views) {
+  size_t num_params = self->parser.num_values - 1;
+  if (self->delta != NULL) {
+    // Room for the params that are repeated from the last code
+    num_params += self->delta->num_prev;
+  }
+  if (num_params > SCODE_INLINE_PARAMS && num_params > self->views_cap) {
+    size_t cap = MAX(num_params, self->views_cap * 2);
+    param_view_t *grown =
+        scode_realloc(self->views, sizeof(param_view_t) * cap);
+    if (grown == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    self->views = grown;
+    self->views_cap = cap;
+  }
+  *views = self->views;
+#if SCODE_INLINE_PARAMS > 0
+  // Small codes don't need the heap at all
+  if (num_params <= SCODE_INLINE_PARAMS) {
+    *views = self->inline_views;
+  }
+#endif
+  UNWRAP(parser_build_view(&self->parser, code, *views,
+                           &self->buf[self->pos]));
+  if (self->delta != NULL && code_view_is_binary(code)) {
+    return delta_decode(self->delta, code, *views);
+  }
+  return 0;
+}
+
+/**
+ * Pop the next code, reusing the memory of the code if into is set
+ *
+ * @param arena where to allocate the params, or NULL for the heap
+ */
+static int code_stream_pop_code(code_stream_t *self, code_t *code,
+                                scode_arena_t *arena, int into) {
+  int result = code_stream_next(self);
+  if (result > 0) {
+    const char *buf = &self->buf[self->pos];
+    code_view_t decoded;
+    const code_view_t *from = NULL;
+    if (self->delta != NULL) {
+      param_view_t *views;
+      result = code_stream_build_view(self, &decoded, &views);
+      from = &decoded;
+    }
+    if (result >= 0) {
+      result = into ? parser_build_into(&self->parser, code, buf, from)
+                    : parser_build(&self->parser, code, buf, arena, from);
+    }
+    code_stream_consume(self);
+    if (result == 0 && self->quant != NULL) {
+      code_dequantize(code, self->quant);
+    }
+  }
+  if (result < 0 && result != SCODE_ERROR_BUFFER && self->delta != NULL) {
+    code_delta_reset(self->delta);
+  }
+  return result;
+}
+
+int code_stream_pop(code_stream_t *self, code_t *code) {
+  return code_stream_pop_code(self, code, NULL, 0);
+}
+
+int code_stream_pop_into(code_stream_t *self, code_t *code) {
+  return code_stream_pop_code(self, code, NULL, 1);
+}
+
+int code_stream_pop_arena(code_stream_t *self, code_t *code,
+                          scode_arena_t *arena) {
+  return code_stream_pop_code(self, code, arena, 0);
+}
+
+int code_stream_skip(code_stream_t *self) {
+  if (self->buf == NULL) {
+    return SCODE_ERROR_BUFFER;
+  }
+  if (self->parser.state == PARSER_LEAD && self->parser.scan == 0) {
+    while (self->pos < self->end && isspace(self->buf[self->pos])) {
+      self->pos++;
+    }
+    size_t live = self->end - self->pos;
+    size_t header;
+    int size = code_frame_size(&self->buf[self->pos], live, &header);
+    if (size == SCODE_ERROR_BUFFER) {
+      return size;
+    }
+    if (size > 0) {
+      // The frame is dropped without being parsed, and any of it that hasn't
+      // been received yet is dropped as it comes in
+      if ((size_t)size > live) {
+        self->parser.state = PARSER_SKIP_FRAME;
+        self->parser.remaining = size - live;
+        size = live;
       }
+      self->pos += size;
+      return 0;
     }
-    return code_stream_pop(self, code);
-  case SCODE_ERROR_BUFFER:
-    break;
   }
+  int result = code_stream_next(self);
+  if (result > 0) {
+    code_stream_consume(self);
+    result = 0;
+  }
+  return result;
+}
 
+int code_stream_pop_view(code_stream_t *self, code_view_t *code) {
+  int result = code_stream_next(self);
+  if (result > 0) {
+    param_view_t *views;
+    result = code_stream_build_view(self, code, &views);
+    code_stream_consume(self);
+    if (result == 0 && self->quant != NULL && code_view_is_binary(code)) {
+      code_view_dequantize(views, code->num_params, self->quant);
+    }
+  }
+  if (result < 0 && result != SCODE_ERROR_BUFFER && self->delta != NULL) {
+    code_delta_reset(self->delta);
+  }
   return result;
 }
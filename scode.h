@@ -7,6 +7,12 @@
 extern "C" {
 #endif
 
+// Define SCODE_NO_MALLOC to build the library without the heap. Streams and
+// arenas then need caller provided buffers, codes keep their params inline and
+// short strings in the params, and anything that doesn't fit fails with
+// SCODE_ERROR_MEMORY.
+// #define SCODE_NO_MALLOC
+
 #define BYTEORDER_LITTLE_ENDIAN 0 // Little endian machine.
 #define BYTEORDER_BIG_ENDIAN 1    // Big endian machine.
 
@@ -98,6 +104,152 @@ uint64_t swap_endian_64(uint64_t i);
  */
 uint8_t crc_calc(const char *buf, size_t len, uint8_t crc);
 
+// Use the larger and faster CRC implementations on 64 bit hosts. The smaller
+// lookup table is used everywhere else.
+#if !defined(SCODE_CRC_FAST)
+#if defined(__x86_64__) || defined(__aarch64__)
+#define SCODE_CRC_FAST 1
+#else
+#define SCODE_CRC_FAST 0
+#endif
+#endif
+
+/**
+ * Run the CRC-8 algorithm one bit at a time.
+ *
+ * crc_calc() will pick the fastest implementation available, so these are
+ * only needed if you want to compare the implementations.
+ */
+uint8_t crc_calc_bitwise(const char *buf, size_t len, uint8_t crc);
+/**
+ * Run the CRC-8 algorithm with one table lookup per byte.
+ */
+uint8_t crc_calc_table(const char *buf, size_t len, uint8_t crc);
+
+#if SCODE_CRC_FAST
+/**
+ * Run the CRC-8 algorithm eight bytes at a time with eight lookup tables.
+ */
+uint8_t crc_calc_slice8(const char *buf, size_t len, uint8_t crc);
+/**
+ * Run the CRC-8 algorithm with carry-less multiplication (PCLMULQDQ or PMULL)
+ *
+ * This should only be used if crc_clmul_supported() is true.
+ */
+uint8_t crc_calc_clmul(const char *buf, size_t len, uint8_t crc);
+/**
+ * Check whether the cpu supports carry-less multiplication
+ *
+ * @return whether crc_calc_clmul() can be used
+ */
+int crc_clmul_supported(void);
+#endif
+
+/**
+ * Run CRC-16/XMODEM (poly 0x1021) on the provided buffer. The crc input works
+ * the same way as for crc_calc().
+ */
+uint16_t crc16_calc(const char *buf, size_t len, uint16_t crc);
+/**
+ * Run CRC-32C (Castagnoli) on the provided buffer, with the CRC32 instructions
+ * of SSE4.2 or ARMv8 when the cpu has them. The crc input works the same way
+ * as for crc_calc().
+ */
+uint32_t crc32c_calc(const char *buf, size_t len, uint32_t crc);
+/**
+ * Run CRC-32C with one table lookup per byte.
+ */
+uint32_t crc32c_calc_table(const char *buf, size_t len, uint32_t crc);
+/**
+ * Run CRC-32C with the CRC32 instructions. This should only be used if
+ * crc32c_hw_supported() is true.
+ */
+uint32_t crc32c_calc_hw(const char *buf, size_t len, uint32_t crc);
+/**
+ * Check whether the cpu has CRC32 instructions
+ *
+ * @return whether crc32c_calc_hw() can be used
+ */
+int crc32c_hw_supported(void);
+
+// Checksums that end binary codes, which are also their widths in bytes. The
+// checksum is little endian on the wire, after the null that ends the params.
+// CRC-8 is enough for short motion codes, and is what the functions without a
+// checksum argument use. Links that carry long strings or bulk data can agree
+// on a wider one, and both ends must use the same one.
+#define SCODE_CHECKSUM_CRC8 1   // CRC-8 (poly 0x07), the default
+#define SCODE_CHECKSUM_CRC16 2  // CRC-16/XMODEM
+#define SCODE_CHECKSUM_CRC32C 4 // CRC-32C
+
+/**
+ * Bump allocator for parsing many codes without using the heap for each one
+ *
+ * Memory is taken from large blocks, and everything is released at once with
+ * scode_arena_reset() or free_scode_arena().
+ */
+struct scode_arena_block {
+  struct scode_arena_block *next;
+  size_t cap; // usable bytes after the header
+};
+
+#define ARENA_FLAG_STATIC 0x01 // The block belongs to the caller
+
+typedef struct {
+  struct scode_arena_block *head;
+  size_t used; // bytes used in the head block
+  uint8_t flags;
+} scode_arena_t;
+
+/**
+ * Initialize a new arena
+ *
+ * @param capacity size of the first block (more blocks are added as needed)
+ *
+ * @return new arena
+ */
+scode_arena_t init_scode_arena(size_t capacity);
+/**
+ * Initialize an arena that allocates from a caller provided buffer
+ *
+ * The arena never grows, so allocations fail once the buffer is full. The
+ * buffer is not freed by free_scode_arena().
+ *
+ * @param buf buffer to allocate from
+ * @param size size of the buffer
+ *
+ * @return new arena
+ */
+scode_arena_t init_scode_arena_static(void *buf, size_t size);
+/**
+ * Free all of the memory in the arena
+ */
+void free_scode_arena(scode_arena_t *self);
+/**
+ * Release everything that was allocated from the arena so that it can be
+ * reused.
+ *
+ * If the arena had to grow, its blocks are merged into a single block so that
+ * the next batch of the same size will not need to allocate.
+ */
+void scode_arena_reset(scode_arena_t *self);
+/**
+ * Allocate memory from the arena
+ *
+ * @param size number of bytes
+ *
+ * @return 8 byte aligned memory, or NULL if the heap is out of memory
+ */
+void *scode_arena_alloc(scode_arena_t *self, size_t size);
+
+#define PARAM_SSO_LEN 7       // Longest string that is stored in the param
+#define PARAM_FLAG_INLINE 0x01 // The string is in str_inline
+
+/**
+ * A parameter of a code
+ *
+ * Short strings are stored inside of the param rather than on the heap, so use
+ * param_str() to read a string instead of str.
+ */
 typedef struct {
   union {
     uint8_t u8;
@@ -108,8 +260,11 @@ typedef struct {
     float f32;
     double f64;
     char *str;
+    char str_inline[PARAM_SSO_LEN + 1];
   };
   uint8_t param;
+  uint8_t flags;
+  uint32_t str_cap; // size of a heap string, so that it can be reused
 } param_t;
 
 #define PARAM_T_STR 0b111
@@ -126,6 +281,7 @@ typedef struct {
 #define SCODE_ERROR_BUFFER -4
 #define SCODE_ERROR_CRC -5
 #define SCODE_ERROR_EMPTY -6
+#define SCODE_ERROR_MEMORY -7
 
 /**
  * Initialize u8 parameter
@@ -193,8 +349,11 @@ param_t init_param_f64(char param, double val);
 /**
  * Initialize string parameter
  *
- * This will create new data on the heap, so free_param() should be called after
- * use
+ * Strings longer than PARAM_SSO_LEN are copied to the heap, so free_param()
+ * should be called after use
+ *
+ * If the heap copy can't be allocated, param_str() returns NULL and dumping
+ * the param or a code holding it fails with SCODE_ERROR_MEMORY
  *
  * @param param parameter letter
  * @param val string value
@@ -257,6 +416,12 @@ uint8_t param_type(const param_t *self);
  * Get the letter that this param represents
  */
 char param_letter(const param_t *self);
+/**
+ * Get the value of a string parameter
+ *
+ * @return null terminated string, or NULL if the param is not a string
+ */
+const char *param_str(const param_t *self);
 
 /**
  * Free any heap memory
@@ -301,11 +466,179 @@ int param_dump_binary(const param_t *self, char *buf, size_t len);
  * @return number of bytes written
  */
 int param_dump_human(const param_t *self, char *buf, size_t len);
+/**
+ * Dump the parameter as a human readable parameter, with floats rounded to a
+ * fixed number of decimals.
+ *
+ * Floats always have at least one decimal so that they are read back as
+ * floats.
+ *
+ * @param buf buffer
+ * @param len length of buffer
+ * @param decimals number of decimals to write for floats
+ *
+ * @return number of bytes written
+ */
+int param_dump_human_fixed(const param_t *self, char *buf, size_t len,
+                           uint8_t decimals);
+/**
+ * Get a copy of the parameter in the narrowest type that holds its value
+ * exactly
+ *
+ * Integers get the same type that parsing them from a human code would give,
+ * and doubles that a float holds exactly become floats. Floats stay floats and
+ * integers stay integers, so that the value reads back the same. The copy
+ * shares the string of the parameter and should not be freed.
+ *
+ * @return narrowed parameter
+ */
+param_t param_narrow(const param_t *self);
+/**
+ * Get the number of bytes param_dump_binary() writes for the parameter
+ *
+ * @return number of bytes
+ */
+int param_dump_binary_size(const param_t *self);
+/**
+ * Get the number of bytes param_dump_human() writes for the parameter
+ *
+ * @return number of bytes or SCODE_ERROR_DUMP
+ */
+int param_dump_human_size(const param_t *self);
+/**
+ * Get the number of bytes param_dump_human_fixed() writes for the parameter
+ *
+ * @param decimals number of decimals to write for floats
+ *
+ * @return number of bytes or SCODE_ERROR_DUMP
+ */
+int param_dump_human_fixed_size(const param_t *self, uint8_t decimals);
 
+/**
+ * A parameter that borrows its string from the buffer it was parsed from
+ *
+ * Unlike param_t, str is not null terminated, and does not need to be freed.
+ * Views are only valid for as long as the parsed buffer is.
+ */
+typedef struct {
+  union {
+    uint8_t u8;
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+    float f32;
+    double f64;
+    const char *str;
+  };
+  size_t len; // length of str
+  uint8_t param;
+} param_view_t;
+
+/**
+ * Cast the value into a u8
+ *
+ * @return uint8_t version of value
+ */
+uint8_t param_view_cast_u8(const param_view_t *self);
+/**
+ * Cast the value into an i8
+ *
+ * @return int8_t version of value
+ */
+int8_t param_view_cast_i8(const param_view_t *self);
+/**
+ * Cast the value into an i16
+ *
+ * @return int16_t version of value
+ */
+int16_t param_view_cast_i16(const param_view_t *self);
+/**
+ * Cast the value into an i32
+ *
+ * @return int32_t version of value
+ */
+int32_t param_view_cast_i32(const param_view_t *self);
+/**
+ * Cast the value into an i64
+ *
+ * @return int64_t version of value
+ */
+int64_t param_view_cast_i64(const param_view_t *self);
+/**
+ * Cast the value into an f32
+ *
+ * @return float version of value
+ */
+float param_view_cast_f32(const param_view_t *self);
+/**
+ * Cast the value into an f64
+ *
+ * @return double version of value
+ */
+double param_view_cast_f64(const param_view_t *self);
+
+/**
+ * Get the value type of this parameter
+ *
+ * @return parameter type
+ */
+uint8_t param_view_type(const param_view_t *self);
+
+/**
+ * Get the letter that this param represents
+ */
+char param_view_letter(const param_view_t *self);
+
+/**
+ * Parse a parameter without copying any strings
+ *
+ * @param buf buffer
+ * @param len length of buffer
+ * @param is_binary whether the parameter is binary or human
+ *
+ * @return number of bytes read or one of the SCODE_ERROR_X errors
+ */
+int param_view_parse(param_view_t *self, const char *buf, size_t len,
+                     int is_binary);
+
+/**
+ * Copy a view into a parameter that owns its string
+ *
+ * @return new parameter, free_param() should be called after use
+ */
+param_t param_view_copy(const param_view_t *self);
+
+// Number of params that a code can hold without using the heap. Set this to 0
+// to make codes smaller when a lot of them are kept in memory.
+#ifndef SCODE_INLINE_PARAMS
+#define SCODE_INLINE_PARAMS 8
+#endif
+
+#define CODE_FLAG_ARENA 0x01  // The params are owned by an scode_arena_t
+#define CODE_FLAG_LOOKUP 0x02 // mask and lookup are up to date
+#define CODE_FLAG_INLINE 0x04 // The params are stored in inline_params
+
+/**
+ * A code and its params
+ *
+ * Small codes keep their params inside of the code, so params may point into
+ * the code itself, and a code copied with = would point at the params of the
+ * code it was copied from. Use code_move() to hand a code over, or
+ * code_copy() to keep both.
+ */
 typedef struct {
   param_t *params;
+  size_t num_params; // number of params, not counting the terminator
+  size_t params_cap; // number of params that fit in a heap params array
+  uint32_t mask;     // bit (letter - 'A') is set for each letter in params
   uint8_t category;
   uint8_t number;
+  uint8_t flags;
+  uint8_t lookup[26]; // index of the first param with each letter
+#if SCODE_INLINE_PARAMS > 0
+  param_t inline_params[SCODE_INLINE_PARAMS + 1];
+#endif
 } code_t;
 
 /**
@@ -321,6 +654,35 @@ typedef struct {
  * @return initialized code
  */
 code_t init_code(char letter, uint8_t number, size_t num_params);
+/**
+ * Initialize a new code in place
+ *
+ * This is the same as init_code(), but up to SCODE_INLINE_PARAMS params are
+ * stored in the code instead of on the heap.
+ *
+ * @param letter code letter
+ * @param number code number
+ * @param num_params The number of params in this code
+ *
+ * @return 0 for success, or SCODE_ERROR_MEMORY
+ */
+int init_code_into(code_t *self, char letter, uint8_t number,
+                   size_t num_params);
+/**
+ * Move a code to a new place
+ *
+ * The params are moved with it, and the old code is left empty.
+ */
+void code_move(code_t *self, code_t *from);
+/**
+ * Copy a code to a new place
+ *
+ * The copy gets its own params and strings, so both codes have to be freed.
+ * Params that were in an arena are copied to the heap.
+ *
+ * @return 0 for success, or SCODE_ERROR_MEMORY in which case self is empty
+ */
+int code_copy(code_t *self, const code_t *from);
 
 /**
  * Free the code from memory
@@ -341,6 +703,57 @@ void free_code(code_t *self);
  * If an error occurs, then the code does not need to freed.
  */
 int code_parse(code_t *self, const char *buf, size_t len);
+/**
+ * Parse a code string into a code object, with binary codes ending in a
+ * checksum other than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes parsed or one of the SCODE_ERROR_X errors
+ */
+int code_parse_checksum(code_t *self, const char *buf, size_t len,
+                        uint8_t checksum);
+/**
+ * Parse the next code in a buffer that holds many codes
+ *
+ * Empty lines and comments before the code are skipped. If the code is
+ * invalid, the rest of it is skipped as well so that the next call starts at
+ * the following code.
+ *
+ * @param buf buffer to parse
+ * @param len length of buffer
+ * @param consumed number of bytes that were used
+ * @param arena arena to allocate from, or NULL to use the heap
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER if the buffer doesn't hold a
+ * complete code, or the error of a code that was skipped
+ */
+int code_parse_next(code_t *self, const char *buf, size_t len,
+                    size_t *consumed, scode_arena_t *arena);
+/**
+ * Parse the next code in a buffer like code_parse_next(), with binary codes
+ * ending in a checksum other than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ */
+int code_parse_next_checksum(code_t *self, const char *buf, size_t len,
+                             size_t *consumed, scode_arena_t *arena,
+                             uint8_t checksum);
+/**
+ * Parse a code string into a code object using an arena
+ *
+ * The params and any strings are allocated from the arena, so they are
+ * released when the arena is reset. free_code() does not need to be called,
+ * but it is safe to.
+ *
+ * @param buf buffer to parse
+ * @param len length of buffer
+ * @param arena arena to allocate from
+ *
+ * @return number of bytes parsed or one of the SCODE_ERROR_X errors
+ */
+int code_parse_arena(code_t *self, const char *buf, size_t len,
+                     scode_arena_t *arena);
 
 /**
  * Dump the code object into a human code string.
@@ -354,10 +767,24 @@ int code_parse(code_t *self, const char *buf, size_t len);
  */
 int code_dump_binary(const code_t *self, char *buf, size_t len);
 /**
- * Dump the code object into a binary code string.
+ * Dump the code object into a binary code that ends with a checksum other
+ * than CRC-8
  *
- * This will append a null terminator to the end of the string (not included in
- * the return number)
+ * Each of the other binary dumps has a _checksum variant as well.
+ *
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_checksum(const code_t *self, char *buf, size_t len,
+                              uint8_t checksum);
+/**
+ * Dump the code object into a human code string.
+ *
+ * This will append a null terminator to the end of the string if there is room
+ * for it (not included in the return number)
  *
  * @param buf buffer to write to
  * @param len maximum length of the buffer
@@ -365,6 +792,331 @@ int code_dump_binary(const code_t *self, char *buf, size_t len);
  * @return number of bytes written or one of the SCODE_ERROR_X errors
  */
 int code_dump_human(const code_t *self, char *buf, size_t len);
+/**
+ * Dump the code object into a human code string, with floats rounded to a
+ * fixed number of decimals.
+ *
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ * @param decimals number of decimals to write for floats
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_human_fixed(const code_t *self, char *buf, size_t len,
+                          uint8_t decimals);
+/**
+ * Get the number of bytes code_dump_binary() writes for the code, so that a
+ * buffer of exactly the right size can be used
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_size(const code_t *self);
+/**
+ * Get the number of bytes code_dump_binary_checksum() writes for the code
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_checksum_size(const code_t *self, uint8_t checksum);
+/**
+ * Dump the code object into a binary code, with each param in the narrowest
+ * type that holds its value exactly (see param_narrow()). Codes that were
+ * built with wide types such as init_param_f64() get shorter, and parse back
+ * to the same values.
+ *
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_narrow(const code_t *self, char *buf, size_t len);
+/**
+ * Get the number of bytes code_dump_binary_narrow() writes for the code
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_narrow_size(const code_t *self);
+/**
+ * Dump the code like code_dump_binary_narrow(), ending with a checksum other
+ * than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_narrow_checksum(const code_t *self, char *buf, size_t len,
+                                     uint8_t checksum);
+/**
+ * Get the number of bytes code_dump_binary_narrow_checksum() writes
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_narrow_checksum_size(const code_t *self,
+                                          uint8_t checksum);
+
+/**
+ * How the params of each letter are quantized in binary codes
+ *
+ * A quantized param is sent as the integer number of steps its value is away
+ * from zero, which is much shorter than a float when only some precision is
+ * needed. Both ends of a link must use the same profile. Values that don't fit
+ * in the integer type are sent as floats instead.
+ */
+typedef struct {
+  double scale[26]; // steps per unit for each letter, or 0 to send it as is
+  uint8_t type[26]; // PARAM_T_I16 or PARAM_T_I32 for each letter
+} scode_quant_t;
+
+/**
+ * Quantize the params of a letter
+ *
+ * For example, a scale of 1000 and PARAM_T_I32 sends millimeters with a
+ * resolution of one micrometer.
+ *
+ * @param letter param letter
+ * @param scale steps per unit, or 0 to stop quantizing the letter
+ * @param type PARAM_T_I16 or PARAM_T_I32
+ */
+void scode_quant_set(scode_quant_t *self, char letter, double scale,
+                     uint8_t type);
+/**
+ * Dump the code object into a binary code, with the params of the letters in
+ * the profile quantized. The other params are written as with
+ * code_dump_binary_narrow().
+ *
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ * @param profile quantization profile
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_quant(const code_t *self, char *buf, size_t len,
+                           const scode_quant_t *profile);
+/**
+ * Get the number of bytes code_dump_binary_quant() writes for the code
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_quant_size(const code_t *self,
+                                const scode_quant_t *profile);
+/**
+ * Dump the code like code_dump_binary_quant(), ending with a checksum other
+ * than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_quant_checksum(const code_t *self, char *buf, size_t len,
+                                    const scode_quant_t *profile,
+                                    uint8_t checksum);
+/**
+ * Get the number of bytes code_dump_binary_quant_checksum() writes
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_quant_checksum_size(const code_t *self,
+                                         const scode_quant_t *profile,
+                                         uint8_t checksum);
+/**
+ * Turn the quantized params of a parsed binary code back into floats, so that
+ * param_cast_f32() and param_cast_f64() give the values that were sent.
+ * Integer params of the letters in the profile are taken to be steps. Human
+ * codes are left alone.
+ *
+ * @param profile quantization profile the code was sent with
+ */
+void code_dequantize(code_t *self, const scode_quant_t *profile);
+
+#define CODE_DELTA_PREV 31 // params of the last code that can be repeated
+
+/**
+ * State shared by the two ends of a delta coded stream of binary codes
+ *
+ * Each code is sent relative to the codes before it. Params that are the same
+ * as in the last code are dropped, and integer params are sent as the
+ * difference from the last value of their letter when that is shorter. The
+ * receiver rebuilds the full codes with code_stream_set_delta().
+ *
+ * Both ends start with init_code_delta() and must see the same codes, so after
+ * the receiver reports an error both ends have to call code_delta_reset().
+ */
+typedef struct {
+  param_t last[26];              // last number of each letter
+  uint32_t known;                // bit (letter - 'A') is set for each in last
+  uint8_t prev[CODE_DELTA_PREV]; // letters of the params of the last code
+  uint8_t num_prev;
+} code_delta_t;
+
+code_delta_t init_code_delta(void);
+/**
+ * Forget the codes that were sent, so that the next code is sent in full
+ */
+void code_delta_reset(code_delta_t *self);
+/**
+ * Dump the code object into a binary code relative to the codes before it
+ *
+ * A param with the letter after 'Z' holds a mask of the positions of the
+ * params in the last code that are repeated, followed by a mask of the params
+ * that are sent as differences. The receiver puts the repeated params after
+ * the ones that were sent.
+ *
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ * @param state state of the stream, which is only updated if the code fits
+ * @param quant quantization profile for the params, or NULL to narrow them
+ * as code_dump_binary_narrow() does
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_delta(const code_t *self, char *buf, size_t len,
+                           code_delta_t *state, const scode_quant_t *quant);
+/**
+ * Dump the code like code_dump_binary_delta(), ending with a checksum other
+ * than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_delta_checksum(const code_t *self, char *buf, size_t len,
+                                    code_delta_t *state,
+                                    const scode_quant_t *quant,
+                                    uint8_t checksum);
+/**
+ * Dump a batch of codes into one buffer as binary codes, one after another
+ *
+ * Each code is checked before it is written, so when the batch doesn't fit,
+ * SCODE_ERROR_BUFFER is returned and only whole codes are left in buf.
+ *
+ * @param codes codes to dump
+ * @param num_codes number of codes
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ * @param offsets if not NULL, set to where each of the codes starts in buf
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_batch(const code_t *codes, size_t num_codes, char *buf,
+                           size_t len, size_t *offsets);
+/**
+ * Dump a batch of codes like code_dump_binary_batch(), with each ending in a
+ * checksum other than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_batch_checksum(const code_t *codes, size_t num_codes,
+                                    char *buf, size_t len, size_t *offsets,
+                                    uint8_t checksum);
+
+#define CODE_FRAME_SYNC 0x02 // first byte of a framed binary code
+#define CODE_FRAME_HEADER 5  // longest header, the sync byte and the length
+
+/**
+ * Dump a code as a framed binary code
+ *
+ * The binary code comes after a header of CODE_FRAME_SYNC and the length of
+ * the code as a varint of up to four bytes. The sync byte can't start a human
+ * or binary code, so framed codes can be mixed with both. A receiver can skip
+ * a frame without parsing it, and an invalid frame is dropped up to the end
+ * that its length gives instead of up to the next null.
+ *
+ * @param buf buffer to write to
+ * @param len maximum length of the buffer
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_framed(const code_t *self, char *buf, size_t len);
+/**
+ * Get the number of bytes code_dump_binary_framed() writes for the code
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_framed_size(const code_t *self);
+/**
+ * Dump a code like code_dump_binary_framed(), ending with a checksum other
+ * than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_framed_checksum(const code_t *self, char *buf, size_t len,
+                                     uint8_t checksum);
+/**
+ * Get the number of bytes code_dump_binary_framed_checksum() writes
+ *
+ * @return number of bytes
+ */
+int code_dump_binary_framed_checksum_size(const code_t *self,
+                                          uint8_t checksum);
+/**
+ * Put a frame header in front of a binary code that was dumped at the start of
+ * buf by any of the binary dumps, moving the code up to make room for it
+ *
+ * @param len maximum length of the buffer
+ * @param code_len length of the binary code
+ *
+ * @return length of the frame or SCODE_ERROR_BUFFER
+ */
+int code_frame(char *buf, size_t len, size_t code_len);
+/**
+ * Get the length of the frame at the start of buf from its header
+ *
+ * The category and number of the code start at buf[*header], so frames can
+ * be filtered before they are parsed.
+ *
+ * @param header set to the length of the header
+ *
+ * @return length of the frame, SCODE_ERROR_BUFFER if the header is incomplete,
+ * or SCODE_ERROR_PARSE if buf doesn't start with a frame
+ */
+int code_frame_size(const char *buf, size_t len, size_t *header);
+/**
+ * Get the number of bytes code_dump_human() writes for the code, not counting
+ * the null terminator
+ *
+ * @return number of bytes or SCODE_ERROR_DUMP
+ */
+int code_dump_human_size(const code_t *self);
+/**
+ * Get the number of bytes code_dump_human_fixed() writes for the code, not
+ * counting the null terminator
+ *
+ * @param decimals number of decimals to write for floats
+ *
+ * @return number of bytes or SCODE_ERROR_DUMP
+ */
+int code_dump_human_fixed_size(const code_t *self, uint8_t decimals);
+/**
+ * Dump the code object into a binary code in a new heap buffer
+ *
+ * @param buf set to the new buffer, which must be freed with free()
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_binary_alloc(const code_t *self, char **buf);
+/**
+ * Dump the code object into a null terminated human code string in a new heap
+ * buffer
+ *
+ * @param buf set to the new buffer, which must be freed with free()
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_human_alloc(const code_t *self, char **buf);
+/**
+ * Dump the code object into a null terminated human code string in a new heap
+ * buffer, with floats rounded to a fixed number of decimals.
+ *
+ * @param buf set to the new buffer, which must be freed with free()
+ * @param decimals number of decimals to write for floats
+ *
+ * @return number of bytes written or one of the SCODE_ERROR_X errors
+ */
+int code_dump_human_fixed_alloc(const code_t *self, char **buf,
+                                uint8_t decimals);
 
 /**
  * Get the letter that this code uses
@@ -372,6 +1124,29 @@ int code_dump_human(const code_t *self, char *buf, size_t len);
  * @return letter
  */
 char code_letter(const code_t *self);
+/**
+ * Find the param with a letter
+ *
+ * This is a table lookup for parsed codes. Codes that were built by hand are
+ * searched one param at a time until code_update_lookup() is called.
+ *
+ * @param letter letter of the param
+ *
+ * @return the first param with the letter, or NULL if there is none
+ */
+param_t *code_get_param(const code_t *self, char letter);
+/**
+ * Check if the code has a param with a letter
+ *
+ * @param letter letter of the param
+ *
+ * @return whether there is a param with the letter
+ */
+int code_has_param(const code_t *self, char letter);
+/**
+ * Rebuild the param lookup table after the params were changed by hand
+ */
+void code_update_lookup(code_t *self);
 /**
  * Check if this code was in binary form when it was parsed.
  *
@@ -381,11 +1156,128 @@ char code_letter(const code_t *self);
  */
 int code_is_binary(const code_t *self);
 
+/**
+ * A code whose string parameters point into the buffer it was parsed from
+ *
+ * Parsing a view does not use the heap. A view does not need to be freed, but
+ * it is only valid for as long as the parsed buffer and params array are.
+ */
+typedef struct {
+  const param_view_t *params;
+  size_t num_params;
+  uint8_t category;
+  uint8_t number;
+} code_view_t;
+
+/**
+ * Parse a code string into a code view
+ *
+ * @param params array to store the parameters in
+ * @param max_params length of params
+ * @param buf buffer to parse
+ * @param len length of buffer
+ *
+ * @return number of bytes parsed or one of the SCODE_ERROR_X errors
+ *
+ * SCODE_ERROR_MEMORY is returned if the code has more than max_params params.
+ */
+int code_parse_view(code_view_t *self, param_view_t *params, size_t max_params,
+                    const char *buf, size_t len);
+/**
+ * Parse a code string into a code view like code_parse_view(), with binary
+ * codes ending in a checksum other than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return number of bytes parsed or one of the SCODE_ERROR_X errors
+ */
+int code_parse_view_checksum(code_view_t *self, param_view_t *params,
+                             size_t max_params, const char *buf, size_t len,
+                             uint8_t checksum);
+/**
+ * Parse the next code in a buffer into a view, without using the heap
+ *
+ * This works like code_parse_next(), but the code borrows from the buffer the
+ * same way as with code_parse_view().
+ *
+ * @param params array to store the params in
+ * @param max_params length of the params array
+ * @param buf buffer to parse
+ * @param len length of buffer
+ * @param consumed number of bytes that were used
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER if the buffer doesn't hold a
+ * complete code, SCODE_ERROR_MEMORY if the code has more than max_params
+ * params, or the error of a code that was skipped. After SCODE_ERROR_MEMORY,
+ * consumed is the length of the code, so it can be parsed again with a larger
+ * array or skipped.
+ */
+int code_parse_next_view(code_view_t *self, param_view_t *params,
+                         size_t max_params, const char *buf, size_t len,
+                         size_t *consumed);
+/**
+ * Parse the next code in a buffer into a view like code_parse_next_view(),
+ * with binary codes ending in a checksum other than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ */
+int code_parse_next_view_checksum(code_view_t *self, param_view_t *params,
+                                  size_t max_params, const char *buf,
+                                  size_t len, size_t *consumed,
+                                  uint8_t checksum);
+
+/**
+ * Get the letter that this code uses
+ *
+ * @return letter
+ */
+char code_view_letter(const code_view_t *self);
+/**
+ * Check if this code was in binary form when it was parsed.
+ *
+ * @return whether the parsed code was binary
+ */
+int code_view_is_binary(const code_view_t *self);
+
+/**
+ * Resumable parser state
+ *
+ * This is used by code_stream_t to remember how far it got into a partially
+ * received code, so that each byte only has to be looked at once. All offsets
+ * are relative to the start of the pending code. You should not need to touch
+ * any of these fields.
+ */
+typedef struct {
+  size_t scan;       // Number of bytes that have been consumed so far
+  size_t start;      // Offset of the first byte of the code
+  size_t token;      // Offset of the binary value being read
+  size_t content;    // End of the parameters (comment, newline, or NULL)
+  size_t remaining;  // Bytes left in a fixed width binary value
+  size_t num_values; // Number of values read (including the code itself)
+  size_t frame;      // End of a framed binary code, or 0 if it isn't framed
+  uint32_t crc;       // Checksum of the binary code so far
+  uint8_t checksum;   // SCODE_CHECKSUM_X of binary codes, or 0 for CRC-8
+  uint8_t state;
+  uint8_t quote; // Closing quote of a string, or whether a number has a '.'
+} code_parser_t;
+
+#define CODE_STREAM_FLAG_STATIC 0x01 // The buffer belongs to the caller
+
 typedef struct {
   size_t end;
   size_t pos;
   size_t cap;
+  size_t max_cap; // largest the buffer may grow to, or 0 for no limit
   char *buf;
+  code_parser_t parser;
+  param_view_t *views; // params of the last view popped
+  size_t views_cap;
+#if SCODE_INLINE_PARAMS > 0
+  param_view_t inline_views[SCODE_INLINE_PARAMS]; // used for small codes
+#endif
+  const scode_quant_t *quant; // profile popped codes are dequantized with
+  code_delta_t *delta;        // state popped codes are delta decoded with
+  uint8_t flags;
 } code_stream_t;
 
 /**
@@ -400,17 +1292,81 @@ void free_code_stream(code_stream_t *self);
  * @return new code stream
  */
 code_stream_t init_code_stream(size_t capacity);
+/**
+ * Initialize a code stream that uses a caller provided buffer
+ *
+ * The stream never allocates. code_stream_update() only takes as much data as
+ * fits, and codes longer than the buffer are dropped with SCODE_ERROR_MEMORY.
+ * Popped views use storage in the stream for up to SCODE_INLINE_PARAMS params.
+ *
+ * @param buf buffer to store received data in
+ * @param capacity size of the buffer
+ *
+ * @return new code stream
+ */
+code_stream_t init_code_stream_static(char *buf, size_t capacity);
 
 /**
- * Add data to the input buffer and parse any ready codes
+ * Limit how large the buffer of a code stream may grow
+ *
+ * Once the limit is reached, code_stream_update() only takes as much data as
+ * fits, and a code that is longer than the limit is dropped with
+ * SCODE_ERROR_MEMORY.
+ *
+ * @param max_capacity largest buffer size, or 0 for no limit
+ */
+void code_stream_set_limit(code_stream_t *self, size_t max_capacity);
+
+/**
+ * Select the checksum that binary codes end with in this stream. Streams use
+ * CRC-8 until this is called, and it should only be changed between codes.
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ */
+void code_stream_set_checksum(code_stream_t *self, uint8_t checksum);
+
+/**
+ * Dequantize the binary codes popped from the stream, as code_dequantize()
+ * does. Views are dequantized too.
+ *
+ * @param profile quantization profile, which must outlive the stream, or NULL
+ * to stop dequantizing
+ */
+void code_stream_set_quant(code_stream_t *self, const scode_quant_t *profile);
+
+/**
+ * Rebuild the full codes of a stream sent with code_dump_binary_delta(). The
+ * codes are dequantized after they are rebuilt if there is a profile.
+ *
+ * An error from a pop resets the state, so that later codes that depend on
+ * the lost code fail with SCODE_ERROR_PARSE instead of being wrong.
+ *
+ * @param state state of the stream, which must outlive the stream, or NULL to
+ * stop delta decoding
+ */
+void code_stream_set_delta(code_stream_t *self, code_delta_t *state);
+
+/**
+ * Add data to the input buffer
+ *
+ * The buffer grows to the next power of two when it is full, and data that has
+ * already been popped is only moved out of the way when that is cheaper than
+ * growing.
  *
  * @param buf input buffer
  * @param len length of buffer
+ *
+ * @return number of bytes added, which is less than len if the buffer is at its
+ * limit. Pop some codes and then add the rest.
  */
-void code_stream_update(code_stream_t *self, const char *buf, size_t len);
+size_t code_stream_update(code_stream_t *self, const char *buf, size_t len);
 /**
  * Pop the next available code from the buffer.
  *
+ * Parsing resumes where the last call left off, so a code is returned as soon
+ * as its newline (or binary CRC) has been received without having to re-read
+ * the data before it.
+ *
  * @param code code to populate
  *
  * @return 0 for success, below zero for an error.
@@ -418,6 +1374,55 @@ void code_stream_update(code_stream_t *self, const char *buf, size_t len);
  * If a code could not be parsed, it is still popped.
  */
 int code_stream_pop(code_stream_t *self, code_t *code);
+/**
+ * Pop the next available code from the buffer into an arena.
+ *
+ * @param code code to populate
+ * @param arena arena to allocate the params from
+ *
+ * @return 0 for success, below zero for an error.
+ */
+int code_stream_pop_arena(code_stream_t *self, code_t *code,
+                          scode_arena_t *arena);
+/**
+ * Pop the next available code from the buffer without copying it.
+ *
+ * The view's strings point into the stream's buffer, so the view is only
+ * valid until the next call to code_stream_pop(), code_stream_pop_view(), or
+ * code_stream_update(). Once the stream has seen a code with as many params,
+ * this does not use the heap.
+ *
+ * @param code code view to populate
+ *
+ * @return 0 for success, below zero for an error.
+ */
+int code_stream_pop_view(code_stream_t *self, code_view_t *code);
+/**
+ * Get the next code from the stream, reusing the memory of a code
+ *
+ * The params array and any heap strings of the code are kept and written over
+ * when they are big enough, so popping into the same code again and again
+ * stops allocating once it has seen the largest code. The code must have been
+ * zeroed or filled in by another function first. free_code() should be called
+ * once the code is not needed anymore.
+ *
+ * @param code code to reuse
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int code_stream_pop_into(code_stream_t *self, code_t *code);
+/**
+ * Drop the next code from the stream without building it
+ *
+ * A framed binary code is dropped by its length without being parsed, even if
+ * it hasn't all been received yet. Other codes are parsed up to their end. A
+ * code that is delta coded against a dropped code can't be rebuilt.
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER if no code could be dropped yet,
+ * or one of the other SCODE_ERROR_X errors for an invalid code, which is
+ * dropped as well
+ */
+int code_stream_skip(code_stream_t *self);
 
 #if defined(__cplusplus)
 }
@@ -458,6 +1463,7 @@ public:
   double cast_f64() const { return param_cast_f64(&this->param); }
 
   char letter() const { return param_letter(&this->param); }
+  const char *str() const { return param_str(&this->param); }
 
   param_t *replace() {
     free_param(&this->param);
@@ -470,22 +1476,34 @@ public:
   code_t code;
 
   Code() : code({0}) {}
-  Code(code_t &&code) : code(code) {
-    code.params = nullptr;
+  Code(code_t &&code) : code({0}) {
+    code_move(&this->code, &code);
     code.category = 0;
     code.number = 0;
   }
-  Code(char letter, uint8_t number, size_t num_params)
-      : code(init_code(letter, number, num_params)) {}
-  Code(Code &&other) : code(other.code) {
-    other.code.params = nullptr;
+  Code(char letter, uint8_t number, size_t num_params) : code({0}) {
+    init_code_into(&this->code, letter, number, num_params);
+  }
+  Code(Code &&other) : code({0}) {
+    code_move(&this->code, &other.code);
     other.code.category = 0;
     other.code.number = 0;
   }
-  Code(Code &other) = delete;
+  Code(const Code &other) : code({0}) { code_copy(&this->code, &other.code); }
 
   ~Code() { free_code(&this->code); }
 
+  Code &operator=(Code &&other) {
+    if (this != &other) {
+      free_code(&this->code);
+      code_move(&this->code, &other.code);
+      other.code.category = 0;
+      other.code.number = 0;
+    }
+    return *this;
+  }
+  Code &operator=(const Code &other) = delete;
+
   int dump_binary(char *buf, size_t len) const {
     return code_dump_binary(&this->code, buf, len);
   }
@@ -493,15 +1511,57 @@ public:
   int dump_human(char *buf, size_t len) const {
     return code_dump_human(&this->code, buf, len);
   }
+  int dump_human(char *buf, size_t len, uint8_t decimals) const {
+    return code_dump_human_fixed(&this->code, buf, len, decimals);
+  }
+  int dump_binary_narrow(char *buf, size_t len,
+                         uint8_t checksum = SCODE_CHECKSUM_CRC8) const {
+    return code_dump_binary_narrow_checksum(&this->code, buf, len, checksum);
+  }
+  int dump_binary(char *buf, size_t len, const scode_quant_t &profile,
+                  uint8_t checksum = SCODE_CHECKSUM_CRC8) const {
+    return code_dump_binary_quant_checksum(&this->code, buf, len, &profile,
+                                           checksum);
+  }
+  int dump_binary(char *buf, size_t len, code_delta_t &state,
+                  const scode_quant_t *quant = nullptr,
+                  uint8_t checksum = SCODE_CHECKSUM_CRC8) const {
+    return code_dump_binary_delta_checksum(&this->code, buf, len, &state,
+                                           quant, checksum);
+  }
+  int dump_binary(char *buf, size_t len, uint8_t checksum) const {
+    return code_dump_binary_checksum(&this->code, buf, len, checksum);
+  }
+  int dump_binary_size() const { return code_dump_binary_size(&this->code); }
+  int dump_binary_size(uint8_t checksum) const {
+    return code_dump_binary_checksum_size(&this->code, checksum);
+  }
+  int dump_binary_framed(char *buf, size_t len,
+                         uint8_t checksum = SCODE_CHECKSUM_CRC8) const {
+    return code_dump_binary_framed_checksum(&this->code, buf, len, checksum);
+  }
+  int dump_human_size() const { return code_dump_human_size(&this->code); }
+  int dump_human_size(uint8_t decimals) const {
+    return code_dump_human_fixed_size(&this->code, decimals);
+  }
 
   char letter() const { return code_letter(&this->code); }
   bool is_binary() const { return code_is_binary(&this->code); }
+  size_t num_params() const { return this->code.num_params; }
+  param_t *get_param(char letter) const {
+    return code_get_param(&this->code, letter);
+  }
+  bool has_param(char letter) const {
+    return code_has_param(&this->code, letter);
+  }
 
   void set_param(size_t i, Param &&param) {
     code.params[i] = param.param;
+    code.flags &= ~CODE_FLAG_LOOKUP;
     param.param.str = nullptr;
     param.param.param = 0;
   }
+  void update_lookup() { code_update_lookup(&this->code); }
 
   code_t *replace() {
     free_code(&this->code);
@@ -509,6 +1569,25 @@ public:
   }
 };
 
+class Arena {
+public:
+  scode_arena_t arena;
+
+  Arena() : arena({0}) {}
+  Arena(size_t capacity) : arena(init_scode_arena(capacity)) {}
+  Arena(void *buf, size_t size) : arena(init_scode_arena_static(buf, size)) {}
+  Arena(Arena &&other) : arena(other.arena) {
+    other.arena.head = nullptr;
+    other.arena.used = 0;
+  }
+  Arena(Arena &other) = delete;
+
+  ~Arena() { free_scode_arena(&this->arena); }
+
+  void reset() { scode_arena_reset(&this->arena); }
+  void *alloc(size_t size) { return scode_arena_alloc(&this->arena, size); }
+};
+
 class CodeStream {
 public:
   code_stream_t code_stream;
@@ -519,23 +1598,53 @@ public:
     code_stream.pos = 0;
     code_stream.cap = 0;
     code_stream.buf = nullptr;
+    code_stream.parser = code_parser_t();
+    code_stream.views = nullptr;
+    code_stream.views_cap = 0;
   }
   CodeStream(size_t capacity) : code_stream(init_code_stream(capacity)) {}
+  CodeStream(char *buf, size_t capacity)
+      : code_stream(init_code_stream_static(buf, capacity)) {}
   CodeStream(CodeStream &&other) : code_stream(other.code_stream) {
     other.code_stream.buf = nullptr;
     other.code_stream.cap = 0;
     other.code_stream.pos = 0;
     other.code_stream.end = 0;
+    other.code_stream.parser = code_parser_t();
+    other.code_stream.views = nullptr;
+    other.code_stream.views_cap = 0;
   }
   CodeStream(CodeStream &other) = delete;
 
   ~CodeStream() { free_code_stream(&this->code_stream); }
 
-  void update(const char *buf, size_t len) {
-    code_stream_update(&this->code_stream, buf, len);
+  size_t update(const char *buf, size_t len) {
+    return code_stream_update(&this->code_stream, buf, len);
+  }
+  void set_limit(size_t max_capacity) {
+    code_stream_set_limit(&this->code_stream, max_capacity);
+  }
+  void set_checksum(uint8_t checksum) {
+    code_stream_set_checksum(&this->code_stream, checksum);
+  }
+  void set_quant(const scode_quant_t *profile) {
+    code_stream_set_quant(&this->code_stream, profile);
+  }
+  void set_delta(code_delta_t *state) {
+    code_stream_set_delta(&this->code_stream, state);
   }
 
   int pop(code_t *code) { return code_stream_pop(&this->code_stream, code); }
+  int pop(code_t *code, Arena &arena) {
+    return code_stream_pop_arena(&this->code_stream, code, &arena.arena);
+  }
+  int pop_view(code_view_t *code) {
+    return code_stream_pop_view(&this->code_stream, code);
+  }
+  int pop(Code &code) {
+    return code_stream_pop_into(&this->code_stream, &code.code);
+  }
+  int skip() { return code_stream_skip(&this->code_stream); }
 };
 
 #endif
@@ -0,0 +1,1741 @@
+#include "scode_file.h"
+
+#if SCODE_FILE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FILE_VIEWS 16 // params a view can hold before the array grows
+#define INDEX_MAGIC "SCIX"
+#define INDEX_VERSION 1
+#define INDEX_HEADER 5 // magic and version
+#define CHUNKS_PER_THREAD 8
+#define MIN_CHUNK_SIZE (64 * 1024)
+#define BOUNDARY_SEARCH (64 * 1024)
+#define BOUNDARY_FRAMES 3 // binary frames that must be valid after a guess
+#define WRITER_BINARY -2   // writer_dump() a binary code
+#define WRITER_SHORTEST -1 // writer_dump() a human code with shortest floats
+#define ARCHIVE_MAGIC "SCAR"
+#define ARCHIVE_VERSION 3
+#define ARCHIVE_HEADER 6   // magic, version and checksum of binary codes
+#define ARCHIVE_CRC 4      // CRC-32C of each block and of the footer
+#define ARCHIVE_TRAILER 12 // offset of the footer and the magic
+#define LZ_HASH_BITS 14
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 0xFFFF
+
+typedef struct {
+  size_t start;
+  size_t end;  // where the next chunk starts
+  size_t stop; // where parsing actually stopped, at or after end
+  code_t *codes;
+  size_t num_codes;
+  size_t cap;
+  size_t num_errors;
+  int error;
+} parse_chunk_t;
+
+typedef struct {
+  const char *buf;
+  size_t len;
+  parse_chunk_t *chunks;
+  size_t num_chunks;
+  size_t next;                    // next chunk to take
+  const code_archive_t *archive; // archive whose blocks are the chunks
+  uint8_t checksum;              // SCODE_CHECKSUM_X of binary codes
+} parse_job_t;
+
+typedef struct {
+  parse_job_t *job;
+  scode_arena_t *arena;
+  char *raw; // unpacked block of an archive
+  size_t raw_cap;
+} parse_worker_t;
+
+// Anything that isn't a wider checksum is a CRC-8, like in the dumps
+static uint8_t checksum_width(uint8_t checksum) {
+  if (checksum == SCODE_CHECKSUM_CRC16 || checksum == SCODE_CHECKSUM_CRC32C) {
+    return checksum;
+  }
+  return SCODE_CHECKSUM_CRC8;
+}
+
+int init_code_file(code_file_t *self, const char *path) {
+  memset(self, 0, sizeof(code_file_t));
+  self->checksum = SCODE_CHECKSUM_CRC8;
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return SCODE_ERROR_FILE;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    close(fd);
+    return SCODE_ERROR_FILE;
+  }
+  if (st.st_size == 0) {
+    // An empty file can't be mapped, but it is still open
+    close(fd);
+    self->buf = "";
+    return 0;
+  }
+  void *buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (buf == MAP_FAILED) {
+    return SCODE_ERROR_FILE;
+  }
+  madvise(buf, st.st_size, MADV_SEQUENTIAL);
+  self->buf = buf;
+  self->len = st.st_size;
+  return 0;
+}
+
+void free_code_file(code_file_t *self) {
+  if (self->len > 0) {
+    munmap((void *)self->buf, self->len);
+  }
+  free(self->tail);
+  free(self->views);
+  memset(self, 0, sizeof(code_file_t));
+}
+
+void code_file_set_checksum(code_file_t *self, uint8_t checksum) {
+  self->checksum = checksum_width(checksum);
+}
+
+/**
+ * Parse the next code of a buffer into a code, or into a view if view is set
+ *
+ * @param views params of views, which grows to fit the code
+ * @param checksum SCODE_CHECKSUM_X of binary codes
+ */
+static int file_parse(param_view_t **views, size_t *views_cap, const char *buf,
+                      size_t len, size_t *consumed, code_t *code,
+                      code_view_t *view, scode_arena_t *arena,
+                      uint8_t checksum) {
+  if (view == NULL) {
+    return code_parse_next_checksum(code, buf, len, consumed, arena, checksum);
+  }
+  while (1) {
+    int res = code_parse_next_view_checksum(view, *views, *views_cap, buf, len,
+                                            consumed, checksum);
+    if (res != SCODE_ERROR_MEMORY) {
+      return res;
+    }
+    // The code has more params than fit, so grow the array and try again
+    size_t cap = *views_cap == 0 ? FILE_VIEWS : *views_cap * 2;
+    param_view_t *grown = realloc(*views, sizeof(param_view_t) * cap);
+    if (grown == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    *views = grown;
+    *views_cap = cap;
+  }
+}
+
+static int code_file_next(code_file_t *self, code_t *code, code_view_t *view,
+                          scode_arena_t *arena) {
+  if (self->pos >= self->len) {
+    return SCODE_ERROR_BUFFER;
+  }
+  size_t len = self->len - self->pos;
+  size_t consumed;
+  int res = file_parse(&self->views, &self->views_cap, self->buf + self->pos,
+                       len, &consumed, code, view, arena, self->checksum);
+  if (res == SCODE_ERROR_BUFFER) {
+    // The rest of the file is one code without a line ending. Parse a copy of
+    // it that has one, which views can keep pointing into.
+    free(self->tail);
+    self->tail = malloc(len + 1);
+    if (self->tail != NULL) {
+      memcpy(self->tail, self->buf + self->pos, len);
+      self->tail[len] = '\n';
+      res = file_parse(&self->views, &self->views_cap, self->tail, len + 1,
+                       &consumed, code, view, arena, self->checksum);
+    } else {
+      res = SCODE_ERROR_MEMORY;
+    }
+    consumed = len;
+  }
+  // A code that can't be stored is skipped like any other invalid code, so
+  // that reading goes on with the next one
+  self->pos += consumed;
+  return res;
+}
+
+int code_file_pop(code_file_t *self, code_t *code) {
+  return code_file_next(self, code, NULL, NULL);
+}
+
+int code_file_pop_arena(code_file_t *self, code_t *code, scode_arena_t *arena) {
+  return code_file_next(self, code, NULL, arena);
+}
+
+int code_file_pop_view(code_file_t *self, code_view_t *code) {
+  return code_file_next(self, NULL, code, NULL);
+}
+
+static int index_grow(void **items, size_t *cap, size_t len, size_t size) {
+  if (len < *cap) {
+    return 0;
+  }
+  size_t new_cap = *cap == 0 ? 64 : *cap * 2;
+  void *new_items = realloc(*items, new_cap * size);
+  if (new_items == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  *items = new_items;
+  *cap = new_cap;
+  return 0;
+}
+
+// Record every marker between two offsets of the file. They belong to the code
+// that follows them, which is the next one to be counted.
+static int index_markers(code_index_t *self, size_t *cap, const char *buf,
+                         size_t start, size_t end, const char *marker,
+                         size_t marker_len) {
+  size_t i = start;
+  while (i + marker_len <= end) {
+    const char *found = memchr(buf + i, marker[0], end - marker_len + 1 - i);
+    if (found == NULL) {
+      break;
+    }
+    i = found - buf;
+    if (memcmp(found, marker, marker_len) != 0) {
+      i++;
+      continue;
+    }
+    if (index_grow((void **)&self->markers, cap, self->num_markers,
+                   sizeof(code_marker_t)) < 0) {
+      return SCODE_ERROR_MEMORY;
+    }
+    code_marker_t *m = &self->markers[self->num_markers++];
+    m->code = self->num_codes;
+    m->offset = i;
+    i += marker_len;
+    int negative = i < end && buf[i] == '-';
+    uint64_t value = 0;
+    for (size_t j = i + negative; j < end && buf[j] >= '0' && buf[j] <= '9';
+         ++j) {
+      value = value * 10 + (buf[j] - '0');
+    }
+    m->value = (int64_t)(negative ? 0 - value : value);
+  }
+  return 0;
+}
+
+int code_index_build(code_index_t *self, code_file_t *file, uint64_t interval,
+                     const char *marker) {
+  memset(self, 0, sizeof(code_index_t));
+  self->interval = interval > 0 ? interval : CODE_INDEX_INTERVAL;
+  self->file_len = file->len;
+  size_t marker_len = marker != NULL ? strlen(marker) : 0;
+  size_t offsets_cap = 0;
+  size_t markers_cap = 0;
+
+  file->pos = 0;
+  while (1) {
+    size_t start = file->pos;
+    code_view_t code;
+    int res = code_file_pop_view(file, &code);
+    if (res == SCODE_ERROR_MEMORY ||
+        (marker_len > 0 &&
+         index_markers(self, &markers_cap, file->buf, start, file->pos, marker,
+                       marker_len) < 0)) {
+      free_code_index(self);
+      return SCODE_ERROR_MEMORY;
+    }
+    if (res == SCODE_ERROR_BUFFER) {
+      return 0;
+    }
+    if (res < 0) {
+      continue;
+    }
+    if (self->num_codes % self->interval == 0) {
+      if (index_grow((void **)&self->offsets, &offsets_cap, self->num_offsets,
+                     sizeof(uint64_t)) < 0) {
+        free_code_index(self);
+        return SCODE_ERROR_MEMORY;
+      }
+      self->offsets[self->num_offsets++] = start;
+    }
+    self->num_codes++;
+  }
+}
+
+static size_t index_put(char *buf, uint64_t value) {
+  size_t pos = 0;
+  while (value >= 0x80) {
+    buf[pos++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  buf[pos++] = value;
+  return pos;
+}
+
+static int index_get(const char *buf, size_t len, size_t *pos,
+                     uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; shift < 64 && *pos < len; shift += 7) {
+    uint8_t c = buf[(*pos)++];
+    *value |= (uint64_t)(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      return 0;
+    }
+  }
+  return SCODE_ERROR_PARSE;
+}
+
+int code_index_save(const code_index_t *self, const char *path) {
+  // Offsets and markers are stored as varint deltas from the one before
+  size_t cap = INDEX_HEADER + 10 * 5 + 10 * self->num_offsets +
+               30 * self->num_markers + 1;
+  char *buf = malloc(cap);
+  if (buf == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  memcpy(buf, INDEX_MAGIC, 4);
+  buf[4] = INDEX_VERSION;
+  size_t pos = INDEX_HEADER;
+  pos += index_put(buf + pos, self->interval);
+  pos += index_put(buf + pos, self->num_codes);
+  pos += index_put(buf + pos, self->file_len);
+  pos += index_put(buf + pos, self->num_offsets);
+  pos += index_put(buf + pos, self->num_markers);
+  uint64_t last = 0;
+  for (size_t i = 0; i < self->num_offsets; ++i) {
+    pos += index_put(buf + pos, self->offsets[i] - last);
+    last = self->offsets[i];
+  }
+  uint64_t last_code = 0;
+  last = 0;
+  for (size_t i = 0; i < self->num_markers; ++i) {
+    const code_marker_t *m = &self->markers[i];
+    uint64_t value = ((uint64_t)m->value << 1) ^ (uint64_t)(m->value >> 63);
+    pos += index_put(buf + pos, m->code - last_code);
+    pos += index_put(buf + pos, m->offset - last);
+    pos += index_put(buf + pos, value);
+    last_code = m->code;
+    last = m->offset;
+  }
+  buf[pos] = crc_calc(buf, pos, 0);
+  pos++;
+
+  int res = 0;
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    res = SCODE_ERROR_FILE;
+  } else {
+    if (fwrite(buf, 1, pos, file) != pos) {
+      res = SCODE_ERROR_FILE;
+    }
+    if (fclose(file) != 0) {
+      res = SCODE_ERROR_FILE;
+    }
+  }
+  free(buf);
+  return res;
+}
+
+static int index_parse(code_index_t *self, const char *buf, size_t len) {
+  if (len < INDEX_HEADER + 1 || memcmp(buf, INDEX_MAGIC, 4) != 0 ||
+      buf[4] != INDEX_VERSION) {
+    return SCODE_ERROR_PARSE;
+  }
+  if (crc_calc(buf, len - 1, 0) != (uint8_t)buf[len - 1]) {
+    return SCODE_ERROR_CRC;
+  }
+  len--;
+  size_t pos = INDEX_HEADER;
+  uint64_t num_offsets, num_markers;
+  if (index_get(buf, len, &pos, &self->interval) < 0 ||
+      index_get(buf, len, &pos, &self->num_codes) < 0 ||
+      index_get(buf, len, &pos, &self->file_len) < 0 ||
+      index_get(buf, len, &pos, &num_offsets) < 0 ||
+      index_get(buf, len, &pos, &num_markers) < 0) {
+    return SCODE_ERROR_PARSE;
+  }
+  // Every value takes at least a byte
+  if (self->interval == 0 || num_offsets > len - pos ||
+      num_markers > (len - pos) / 3) {
+    return SCODE_ERROR_PARSE;
+  }
+  self->offsets = malloc(sizeof(uint64_t) * (num_offsets + 1));
+  self->markers = malloc(sizeof(code_marker_t) * (num_markers + 1));
+  if (self->offsets == NULL || self->markers == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  uint64_t last = 0;
+  for (; self->num_offsets < num_offsets; ++self->num_offsets) {
+    uint64_t delta;
+    if (index_get(buf, len, &pos, &delta) < 0) {
+      return SCODE_ERROR_PARSE;
+    }
+    last += delta;
+    self->offsets[self->num_offsets] = last;
+  }
+  uint64_t last_code = 0;
+  last = 0;
+  for (; self->num_markers < num_markers; ++self->num_markers) {
+    uint64_t code, offset, value;
+    if (index_get(buf, len, &pos, &code) < 0 ||
+        index_get(buf, len, &pos, &offset) < 0 ||
+        index_get(buf, len, &pos, &value) < 0) {
+      return SCODE_ERROR_PARSE;
+    }
+    last_code += code;
+    last += offset;
+    code_marker_t *m = &self->markers[self->num_markers];
+    m->code = last_code;
+    m->offset = last;
+    m->value = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+  }
+  return pos == len ? 0 : SCODE_ERROR_PARSE;
+}
+
+int code_index_load(code_index_t *self, const char *path) {
+  memset(self, 0, sizeof(code_index_t));
+  code_file_t file;
+  int res = init_code_file(&file, path);
+  if (res == 0) {
+    res = index_parse(self, file.buf, file.len);
+  }
+  free_code_file(&file);
+  return res;
+}
+
+void free_code_index(code_index_t *self) {
+  free(self->offsets);
+  free(self->markers);
+  memset(self, 0, sizeof(code_index_t));
+}
+
+int code_index_find(const code_index_t *self, uint64_t code, uint64_t *offset,
+                    uint64_t *start) {
+  if (code >= self->num_codes) {
+    return SCODE_ERROR_BUFFER;
+  }
+  uint64_t i = code / self->interval;
+  if (i >= self->num_offsets) {
+    return SCODE_ERROR_BUFFER;
+  }
+  *offset = self->offsets[i];
+  *start = i * self->interval;
+  return 0;
+}
+
+const code_marker_t *code_index_marker(const code_index_t *self,
+                                       int64_t value) {
+  for (size_t i = 0; i < self->num_markers; ++i) {
+    if (self->markers[i].value == value) {
+      return &self->markers[i];
+    }
+  }
+  return NULL;
+}
+
+int code_file_seek(code_file_t *self, const code_index_t *index,
+                   uint64_t code) {
+  if (index->file_len != self->len) {
+    return SCODE_ERROR_FILE;
+  }
+  uint64_t offset, start;
+  int res = code_index_find(index, code, &offset, &start);
+  if (res < 0) {
+    return res;
+  }
+  self->pos = offset;
+  // Skip to the code from the one that was indexed before it
+  while (start < code) {
+    code_view_t view;
+    res = code_file_pop_view(self, &view);
+    if (res == SCODE_ERROR_BUFFER || res == SCODE_ERROR_MEMORY) {
+      return res;
+    }
+    if (res == 0) {
+      start++;
+    }
+  }
+  return 0;
+}
+
+// Check that a code can be parsed at a position. Binary frames are easy to
+// find by accident, so a few of them in a row must have a valid CRC.
+static int check_boundary(const char *buf, size_t len, size_t pos,
+                          uint8_t checksum) {
+  param_view_t views[64];
+  code_view_t code;
+  int is_binary = (buf[pos] & 0x80) || buf[pos] == CODE_FRAME_SYNC;
+  int frames = is_binary ? BOUNDARY_FRAMES : 1;
+  for (int i = 0; i < frames && pos < len; ++i) {
+    int res = code_parse_view_checksum(&code, views, 64, buf + pos, len - pos,
+                                       checksum);
+    if (res == SCODE_ERROR_EMPTY && frames == 1) {
+      return 1;
+    }
+    if (res <= 0) {
+      return res == SCODE_ERROR_BUFFER;
+    }
+    pos += res;
+  }
+  return 1;
+}
+
+/**
+ * Guess where a code starts at or after pos
+ *
+ * This is only a guess. A line ending might be inside of a binary value, and a
+ * null might not be the end of a frame. Chunks that started at a bad guess are
+ * parsed again once the chunk before them is known.
+ *
+ * @param checksum SCODE_CHECKSUM_X of binary codes, which is the number of
+ * bytes after the null that ends a frame
+ */
+static size_t find_boundary(const char *buf, size_t len, size_t pos,
+                            uint8_t checksum) {
+  size_t limit = len - pos > BOUNDARY_SEARCH ? pos + BOUNDARY_SEARCH : len;
+  for (size_t i = pos; i < limit; ++i) {
+    size_t start;
+    if (buf[i] == '\n') {
+      start = i + 1;
+    } else if (i > checksum && buf[i - 1 - checksum] == '\0' &&
+               ((buf[i] & 0xC0) == 0xC0 || buf[i] == CODE_FRAME_SYNC)) {
+      // A binary frame ends with a null and a checksum, and the next one
+      // starts with a code category or a frame header
+      start = i;
+    } else {
+      continue;
+    }
+    if (start >= len || check_boundary(buf, len, start, checksum)) {
+      return start;
+    }
+  }
+  return limit;
+}
+
+static int chunk_push(parse_chunk_t *chunk, code_t *code) {
+  if (chunk->num_codes == chunk->cap) {
+    size_t cap = chunk->cap == 0 ? 256 : chunk->cap * 2;
+    code_t *codes = realloc(chunk->codes, sizeof(code_t) * cap);
+    if (codes == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    chunk->codes = codes;
+    chunk->cap = cap;
+  }
+  code_move(&chunk->codes[chunk->num_codes++], code);
+  return 0;
+}
+
+// Parse the last code of a buffer that has no line ending
+static int parse_tail(code_t *code, const char *buf, size_t len,
+                      scode_arena_t *arena, uint8_t checksum) {
+  char *line = malloc(len + 1);
+  if (line == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  memcpy(line, buf, len);
+  line[len] = '\n';
+  size_t consumed;
+  int res =
+      code_parse_next_checksum(code, line, len + 1, &consumed, arena, checksum);
+  free(line);
+  return res;
+}
+
+/**
+ * Parse every code that starts before the end of the chunk
+ */
+static void parse_chunk(parse_chunk_t *chunk, const char *buf, size_t len,
+                        scode_arena_t *arena, uint8_t checksum) {
+  size_t pos = chunk->start;
+  chunk->num_codes = 0;
+  chunk->num_errors = 0;
+  chunk->error = 0;
+  while (pos < chunk->end) {
+    code_t code;
+    size_t consumed;
+    int res = code_parse_next_checksum(&code, buf + pos, len - pos, &consumed,
+                                       arena, checksum);
+    if (res == SCODE_ERROR_BUFFER) {
+      consumed = len - pos;
+      res = parse_tail(&code, buf + pos, len - pos, arena, checksum);
+      if (res == SCODE_ERROR_EMPTY || res == SCODE_ERROR_BUFFER) {
+        pos = len;
+        break;
+      }
+    }
+    pos += consumed;
+    if (res == SCODE_ERROR_MEMORY) {
+      chunk->error = res;
+      break;
+    }
+    if (res < 0) {
+      chunk->num_errors++;
+      continue;
+    }
+    if (chunk_push(chunk, &code) < 0) {
+      chunk->error = SCODE_ERROR_MEMORY;
+      break;
+    }
+  }
+  chunk->stop = pos;
+}
+
+static int archive_unpack(const code_archive_t *self, size_t block,
+                          char **raw, size_t *raw_cap);
+
+static void *parse_worker(void *arg) {
+  parse_worker_t *worker = arg;
+  parse_job_t *job = worker->job;
+  while (1) {
+    size_t i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+    if (i >= job->num_chunks) {
+      return NULL;
+    }
+    if (job->archive == NULL) {
+      parse_chunk(&job->chunks[i], job->buf, job->len, worker->arena,
+                  job->checksum);
+      continue;
+    }
+    int res = archive_unpack(job->archive, i, &worker->raw, &worker->raw_cap);
+    if (res < 0) {
+      job->chunks[i].error = res;
+      continue;
+    }
+    size_t len = job->archive->blocks[i].raw_len + 1;
+    parse_chunk(&job->chunks[i], worker->raw, len, worker->arena,
+                job->checksum);
+  }
+}
+
+static size_t default_threads(void) {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? n : 1;
+}
+
+/**
+ * Parse the chunks of a job on several threads and collect their codes
+ *
+ * The chunks are freed.
+ */
+static int parse_run(scode_codes_t *self, parse_job_t *job,
+                     size_t num_threads) {
+  parse_chunk_t *chunks = job->chunks;
+  size_t num_chunks = job->num_chunks;
+  // One arena for each thread, and one to parse mispredicted chunks again
+  self->arenas = calloc(num_threads + 1, sizeof(scode_arena_t));
+  parse_worker_t *workers = calloc(num_threads, sizeof(parse_worker_t));
+  pthread_t *threads = calloc(num_threads, sizeof(pthread_t));
+  if (self->arenas == NULL || workers == NULL || threads == NULL) {
+    free(chunks);
+    free(workers);
+    free(threads);
+    free_scode_codes(self);
+    return SCODE_ERROR_MEMORY;
+  }
+  self->num_arenas = num_threads + 1;
+
+  for (size_t i = 0; i < num_threads; ++i) {
+    workers[i].job = job;
+    workers[i].arena = &self->arenas[i];
+  }
+  // This thread works too. If a thread can't be started, the others will do
+  // its share.
+  size_t started = 1;
+  while (started < num_threads &&
+         pthread_create(&threads[started], NULL, parse_worker,
+                        &workers[started]) == 0) {
+    started++;
+  }
+  parse_worker(&workers[0]);
+  for (size_t i = 1; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // Any chunk that didn't start where the one before it stopped is parsed
+  // again from the right place. The blocks of an archive always hold whole
+  // codes.
+  int error = 0;
+  size_t expected = 0;
+  size_t total = 0;
+  for (size_t i = 0; i < num_chunks; ++i) {
+    parse_chunk_t *chunk = &chunks[i];
+    if (job->archive == NULL && chunk->start != expected) {
+      chunk->start = expected;
+      if (chunk->end < expected) {
+        chunk->end = expected;
+      }
+      parse_chunk(chunk, job->buf, job->len, &self->arenas[num_threads],
+                  job->checksum);
+    }
+    if (chunk->error < 0) {
+      error = chunk->error;
+    }
+    expected = chunk->stop;
+    total += chunk->num_codes;
+  }
+
+  if (error == 0) {
+    self->codes = malloc(sizeof(code_t) * (total > 0 ? total : 1));
+    if (self->codes == NULL) {
+      error = SCODE_ERROR_MEMORY;
+    }
+  }
+  // The params of every code are in an arena, so the codes can be copied
+  for (size_t i = 0; i < num_chunks; ++i) {
+    if (error == 0) {
+      memcpy(self->codes + self->num_codes, chunks[i].codes,
+             sizeof(code_t) * chunks[i].num_codes);
+      self->num_codes += chunks[i].num_codes;
+      self->num_errors += chunks[i].num_errors;
+    }
+    free(chunks[i].codes);
+  }
+  for (size_t i = 0; i < num_threads; ++i) {
+    free(workers[i].raw);
+  }
+  free(chunks);
+  free(workers);
+  free(threads);
+  if (error < 0) {
+    free_scode_codes(self);
+  }
+  return error;
+}
+
+int scode_parse_parallel(scode_codes_t *self, const char *buf, size_t len,
+                         size_t num_threads) {
+  return scode_parse_parallel_checksum(self, buf, len, num_threads,
+                                       SCODE_CHECKSUM_CRC8);
+}
+
+int scode_parse_parallel_checksum(scode_codes_t *self, const char *buf,
+                                  size_t len, size_t num_threads,
+                                  uint8_t checksum) {
+  memset(self, 0, sizeof(scode_codes_t));
+  checksum = checksum_width(checksum);
+  if (num_threads == 0) {
+    num_threads = default_threads();
+  }
+
+  size_t chunk_size = len / (num_threads * CHUNKS_PER_THREAD);
+  if (chunk_size < MIN_CHUNK_SIZE) {
+    chunk_size = MIN_CHUNK_SIZE;
+  }
+  size_t num_chunks = len / chunk_size + 1;
+  parse_chunk_t *chunks = calloc(num_chunks, sizeof(parse_chunk_t));
+  if (chunks == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+
+  size_t pos = 0;
+  size_t n = 0;
+  while (n < num_chunks && pos < len) {
+    chunks[n].start = pos;
+    if (pos + chunk_size >= len) {
+      pos = len;
+    } else {
+      pos = find_boundary(buf, len, pos + chunk_size, checksum);
+    }
+    chunks[n].end = pos;
+    n++;
+  }
+
+  parse_job_t job = {buf, len, chunks, n, 0, NULL, checksum};
+  return parse_run(self, &job, num_threads);
+}
+
+int scode_parse_file_parallel(scode_codes_t *self, const char *path,
+                              size_t num_threads) {
+  return scode_parse_file_parallel_checksum(self, path, num_threads,
+                                            SCODE_CHECKSUM_CRC8);
+}
+
+int scode_parse_file_parallel_checksum(scode_codes_t *self, const char *path,
+                                       size_t num_threads, uint8_t checksum) {
+  code_file_t file;
+  if (init_code_file(&file, path) < 0) {
+    memset(self, 0, sizeof(scode_codes_t));
+    free_code_file(&file);
+    return SCODE_ERROR_FILE;
+  }
+  int res = scode_parse_parallel_checksum(self, file.buf, file.len, num_threads,
+                                          checksum);
+  free_code_file(&file);
+  return res;
+}
+
+void free_scode_codes(scode_codes_t *self) {
+  free(self->codes);
+  self->codes = NULL;
+  self->num_codes = 0;
+  self->num_errors = 0;
+  if (self->arenas != NULL) {
+    for (size_t i = 0; i < self->num_arenas; ++i) {
+      free_scode_arena(&self->arenas[i]);
+    }
+    free(self->arenas);
+    self->arenas = NULL;
+  }
+  self->num_arenas = 0;
+}
+
+static int writer_init(code_writer_t *self, int fd, code_write_fn write,
+                       void *ctx, size_t capacity) {
+  memset(self, 0, sizeof(code_writer_t));
+  self->fd = fd;
+  self->write = write;
+  self->ctx = ctx;
+  self->checksum = SCODE_CHECKSUM_CRC8;
+  self->cap = capacity > 0 ? capacity : CODE_WRITER_CAPACITY;
+  self->capacity = self->cap;
+  self->buf = malloc(self->cap);
+  if (self->buf == NULL) {
+    self->cap = 0;
+    return SCODE_ERROR_MEMORY;
+  }
+  return 0;
+}
+
+int init_code_writer(code_writer_t *self, int fd, size_t capacity) {
+  return writer_init(self, fd, NULL, NULL, capacity);
+}
+
+int init_code_writer_fn(code_writer_t *self, code_write_fn write, void *ctx,
+                        size_t capacity) {
+  return writer_init(self, -1, write, ctx, capacity);
+}
+
+void free_code_writer(code_writer_t *self) {
+  free(self->buf);
+  self->buf = NULL;
+  self->len = 0;
+  self->cap = 0;
+}
+
+void code_writer_set_flush(code_writer_t *self, size_t size,
+                           uint32_t latency_us) {
+  self->flush_size = size;
+  self->flush_ns = (uint64_t)latency_us * 1000;
+}
+
+void code_writer_set_checksum(code_writer_t *self, uint8_t checksum) {
+  self->checksum = checksum_width(checksum);
+}
+
+static uint64_t writer_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Keep what a failed send left over, so that the next flush goes on from
+ * where it stopped and never leaves part of a code on the wire
+ *
+ * @param iov what is left to send
+ * @param data data that was sent after the buffer, or NULL
+ *
+ * @return 0 if the data was kept, or the error to report
+ */
+static int writer_keep(code_writer_t *self, struct iovec *iov, int num,
+                       const char *data) {
+  self->len = 0;
+  if (data == NULL || num == 2) {
+    memmove(self->buf, iov->iov_base, iov->iov_len);
+    self->len = iov->iov_len;
+    iov++;
+    num--;
+  }
+  // The data is left to the caller to write again if none of it was sent
+  if (num == 0 || iov->iov_base == data) {
+    return SCODE_ERROR_FILE;
+  }
+  if (iov->iov_len > self->cap) {
+    char *buf = realloc(self->buf, iov->iov_len);
+    if (buf == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    self->buf = buf;
+    self->cap = iov->iov_len;
+  }
+  memcpy(self->buf, iov->iov_base, iov->iov_len);
+  self->len = iov->iov_len;
+  return 0;
+}
+
+/**
+ * Send the buffer, and data that didn't fit in it after it
+ *
+ * @param iov the buffer if anything is waiting in it, then the data
+ * @param data data that is sent after the buffer, or NULL
+ *
+ * @return 0 for success, or SCODE_ERROR_FILE with errno set
+ */
+static int writer_send(code_writer_t *self, struct iovec *iov, int num,
+                       const char *data) {
+  while (num > 0) {
+    ssize_t n = self->write != NULL ? self->write(self->ctx, iov, num)
+                                    : writev(self->fd, iov, num);
+    self->num_writes++;
+    if (n < 0 && self->write == NULL && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      int err = errno;
+      int res = writer_keep(self, iov, num, data);
+      errno = err;
+      return res;
+    }
+    while (num > 0 && (size_t)n >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      num--;
+    }
+    if (num > 0) {
+      iov->iov_base = (char *)iov->iov_base + n;
+      iov->iov_len -= n;
+    }
+  }
+  self->len = 0;
+  // A buffer that grew to keep what a failed send left over goes back to
+  // its size
+  if (self->cap > self->capacity) {
+    char *buf = realloc(self->buf, self->capacity);
+    if (buf != NULL) {
+      self->buf = buf;
+      self->cap = self->capacity;
+    }
+  }
+  return 0;
+}
+
+int code_writer_flush(code_writer_t *self) {
+  if (self->len == 0) {
+    return 0;
+  }
+  struct iovec iov = {self->buf, self->len};
+  return writer_send(self, &iov, 1, NULL);
+}
+
+int code_writer_poll(code_writer_t *self) {
+  if (self->len == 0 || self->flush_ns == 0 ||
+      writer_now() - self->since < self->flush_ns) {
+    return 0;
+  }
+  return code_writer_flush(self);
+}
+
+/**
+ * Make room for bytes at the end of the buffer
+ *
+ * @return 1 if there is room, 0 if they can never fit, or SCODE_ERROR_FILE
+ */
+static int writer_reserve(code_writer_t *self, size_t len) {
+  if (len > self->cap) {
+    return 0;
+  }
+  if (self->cap - self->len < len && code_writer_flush(self) < 0) {
+    return SCODE_ERROR_FILE;
+  }
+  return 1;
+}
+
+// Add bytes that were put at the end of the buffer, and send them if it is
+// time to
+static int writer_commit(code_writer_t *self, size_t len) {
+  if (self->len == 0 && self->flush_ns != 0) {
+    self->since = writer_now();
+  }
+  self->len += len;
+  // The bytes are taken either way, and what isn't sent yet stays in the
+  // buffer, so an error is left for the next flush to report
+  if (self->len >= self->cap ||
+      (self->flush_size != 0 && self->len >= self->flush_size)) {
+    code_writer_flush(self);
+  } else {
+    code_writer_poll(self);
+  }
+  return 0;
+}
+
+int code_writer_write(code_writer_t *self, const char *buf, size_t len) {
+  if (len == 0) {
+    return 0;
+  }
+  int room = writer_reserve(self, len);
+  if (room < 0) {
+    return room;
+  }
+  if (room) {
+    memcpy(self->buf + self->len, buf, len);
+    return writer_commit(self, len);
+  }
+  // Send it along with what is waiting instead of copying it
+  struct iovec iov[2] = {{self->buf, self->len}, {(void *)buf, len}};
+  int skip = self->len == 0;
+  return writer_send(self, iov + skip, 2 - skip, buf);
+}
+
+// Dump a code into the buffer, or a temporary one if it can never fit
+//
+// decimals is the number of decimals of a human code, or one of WRITER_X
+static int writer_dump(code_writer_t *self, const code_t *code, int decimals) {
+  int size;
+  if (decimals == WRITER_BINARY) {
+    size = code_dump_binary_checksum_size(code, self->checksum);
+  } else if (decimals == WRITER_SHORTEST) {
+    size = code_dump_human_size(code);
+  } else {
+    size = code_dump_human_fixed_size(code, decimals);
+  }
+  if (size < 0) {
+    return size;
+  }
+  int room = writer_reserve(self, size);
+  if (room < 0) {
+    return room;
+  }
+  char *buf = room ? self->buf + self->len : malloc(size);
+  if (buf == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  int res;
+  if (decimals == WRITER_BINARY) {
+    res = code_dump_binary_checksum(code, buf, size, self->checksum);
+  } else if (decimals == WRITER_SHORTEST) {
+    res = code_dump_human(code, buf, size);
+  } else {
+    res = code_dump_human_fixed(code, buf, size, decimals);
+  }
+  if (res >= 0) {
+    res = room ? writer_commit(self, size) : code_writer_write(self, buf, size);
+  }
+  if (!room) {
+    free(buf);
+  }
+  return res < 0 ? res : size;
+}
+
+int code_writer_dump_binary(code_writer_t *self, const code_t *code) {
+  return writer_dump(self, code, WRITER_BINARY);
+}
+
+int code_writer_dump_human(code_writer_t *self, const code_t *code) {
+  return writer_dump(self, code, WRITER_SHORTEST);
+}
+
+int code_writer_dump_human_fixed(code_writer_t *self, const code_t *code,
+                                 uint8_t decimals) {
+  return writer_dump(self, code, decimals);
+}
+
+
+/**
+ * Compress a block with LZ77 in the same sequence format as LZ4
+ *
+ * Each sequence is a token with the number of literals in its high nibble and
+ * the match length minus LZ_MIN_MATCH in its low nibble, with 15 meaning that
+ * bytes of up to 255 follow. The literals and a two byte offset of the match
+ * come next. The last sequence only has literals.
+ *
+ * @param table LZ_HASH_BITS sized table of where each hash was last seen
+ *
+ * @return length of the compressed block, or 0 if it would not fit in cap
+ */
+static size_t lz_compress(const char *src, size_t len, char *dst, size_t cap,
+                          uint32_t *table) {
+  memset(table, 0, sizeof(uint32_t) << LZ_HASH_BITS);
+  const uint8_t *in = (const uint8_t *)src;
+  uint8_t *out = (uint8_t *)dst;
+  size_t pos = 0;
+  size_t anchor = 0;
+  size_t i = 1;
+  while (len >= LZ_MIN_MATCH && i <= len - LZ_MIN_MATCH) {
+    uint32_t seq;
+    memcpy(&seq, in + i, 4);
+    uint32_t hash = (seq * 2654435761u) >> (32 - LZ_HASH_BITS);
+    size_t match = table[hash];
+    table[hash] = i;
+    uint32_t found;
+    memcpy(&found, in + match, 4);
+    if (i - match > LZ_MAX_OFFSET || found != seq) {
+      // Skip faster through data that doesn't compress
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+    size_t match_len = LZ_MIN_MATCH;
+    while (i + match_len < len && in[match + match_len] == in[i + match_len]) {
+      match_len++;
+    }
+    while (i > anchor && match > 0 && in[i - 1] == in[match - 1]) {
+      i--;
+      match--;
+      match_len++;
+    }
+
+    size_t lit = i - anchor;
+    if (pos + 1 + lit / 255 + 1 + lit + 2 + match_len / 255 + 1 > cap) {
+      return 0;
+    }
+    uint8_t *token = &out[pos++];
+    size_t ml = match_len - LZ_MIN_MATCH;
+    *token = (lit < 15 ? lit : 15) << 4 | (ml < 15 ? ml : 15);
+    if (lit >= 15) {
+      size_t n = lit - 15;
+      for (; n >= 255; n -= 255) {
+        out[pos++] = 255;
+      }
+      out[pos++] = n;
+    }
+    memcpy(out + pos, in + anchor, lit);
+    pos += lit;
+    size_t offset = i - match;
+    out[pos++] = offset & 0xFF;
+    out[pos++] = offset >> 8;
+    if (ml >= 15) {
+      size_t n = ml - 15;
+      for (; n >= 255; n -= 255) {
+        out[pos++] = 255;
+      }
+      out[pos++] = n;
+    }
+    i += match_len;
+    anchor = i;
+  }
+
+  size_t lit = len - anchor;
+  if (pos + 1 + lit / 255 + 1 + lit > cap) {
+    return 0;
+  }
+  out[pos++] = (lit < 15 ? lit : 15) << 4;
+  if (lit >= 15) {
+    size_t n = lit - 15;
+    for (; n >= 255; n -= 255) {
+      out[pos++] = 255;
+    }
+    out[pos++] = n;
+  }
+  memcpy(out + pos, in + anchor, lit);
+  return pos + lit;
+}
+
+// Read the rest of a length that didn't fit in a token
+static int lz_length(const uint8_t *in, size_t len, size_t *pos,
+                     size_t *value) {
+  uint8_t c;
+  do {
+    if (*pos >= len) {
+      return SCODE_ERROR_PARSE;
+    }
+    c = in[(*pos)++];
+    *value += c;
+  } while (c == 255);
+  return 0;
+}
+
+/**
+ * Decompress a block that was compressed by lz_compress()
+ *
+ * @return 0 for success, or SCODE_ERROR_PARSE if the block is damaged or
+ * doesn't decompress to exactly raw_len bytes
+ */
+static int lz_decompress(const char *src, size_t len, char *dst,
+                         size_t raw_len) {
+  const uint8_t *in = (const uint8_t *)src;
+  size_t pos = 0;
+  size_t out = 0;
+  while (pos < len) {
+    uint8_t token = in[pos++];
+    size_t lit = token >> 4;
+    if (lit == 15 && lz_length(in, len, &pos, &lit) < 0) {
+      return SCODE_ERROR_PARSE;
+    }
+    if (lit > len - pos || lit > raw_len - out) {
+      return SCODE_ERROR_PARSE;
+    }
+    memcpy(dst + out, in + pos, lit);
+    pos += lit;
+    out += lit;
+    if (pos == len) {
+      break;
+    }
+
+    if (len - pos < 2) {
+      return SCODE_ERROR_PARSE;
+    }
+    size_t offset = in[pos] | in[pos + 1] << 8;
+    pos += 2;
+    size_t match_len = token & 0x0F;
+    if (match_len == 15 && lz_length(in, len, &pos, &match_len) < 0) {
+      return SCODE_ERROR_PARSE;
+    }
+    match_len += LZ_MIN_MATCH;
+    if (offset == 0 || offset > out || match_len > raw_len - out) {
+      return SCODE_ERROR_PARSE;
+    }
+    if (offset >= match_len) {
+      memcpy(dst + out, dst + out - offset, match_len);
+    } else {
+      // The match overlaps what it writes, like a repeated byte
+      for (size_t i = 0; i < match_len; ++i) {
+        dst[out + i] = dst[out + i - offset];
+      }
+    }
+    out += match_len;
+  }
+  return out == raw_len ? 0 : SCODE_ERROR_PARSE;
+}
+
+static size_t archive_put_crc(char *buf, uint32_t crc) {
+  for (int i = 0; i < ARCHIVE_CRC; ++i) {
+    buf[i] = crc >> (8 * i);
+  }
+  return ARCHIVE_CRC;
+}
+
+static uint32_t archive_get_crc(const char *buf) {
+  uint32_t crc = 0;
+  for (int i = 0; i < ARCHIVE_CRC; ++i) {
+    crc |= (uint32_t)(uint8_t)buf[i] << (8 * i);
+  }
+  return crc;
+}
+
+// Write all of a buffer to a file descriptor
+static int archive_send(code_archive_writer_t *self, const char *buf,
+                        size_t len) {
+  while (len > 0) {
+    ssize_t res = write(self->fd, buf, len);
+    if (res < 0 && errno == EINTR) {
+      continue;
+    }
+    if (res <= 0) {
+      return SCODE_ERROR_FILE;
+    }
+    buf += res;
+    len -= res;
+    self->offset += res;
+  }
+  return 0;
+}
+
+int init_code_archive_writer(code_archive_writer_t *self, int fd,
+                             size_t block_size) {
+  return init_code_archive_writer_checksum(self, fd, block_size,
+                                           SCODE_CHECKSUM_CRC8);
+}
+
+int init_code_archive_writer_checksum(code_archive_writer_t *self, int fd,
+                                      size_t block_size, uint8_t checksum) {
+  memset(self, 0, sizeof(code_archive_writer_t));
+  self->fd = fd;
+  self->checksum = checksum_width(checksum);
+  self->block_size = block_size == 0 ? CODE_ARCHIVE_BLOCK : block_size;
+  self->raw = malloc(self->block_size);
+  self->packed = malloc(self->block_size);
+  self->table = malloc(sizeof(uint32_t) << LZ_HASH_BITS);
+  if (self->raw == NULL || self->packed == NULL || self->table == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  self->raw_cap = self->block_size;
+  self->packed_cap = self->block_size;
+  char header[ARCHIVE_HEADER];
+  memcpy(header, ARCHIVE_MAGIC, 4);
+  header[4] = ARCHIVE_VERSION;
+  header[5] = self->checksum;
+  return archive_send(self, header, ARCHIVE_HEADER);
+}
+
+void free_code_archive_writer(code_archive_writer_t *self) {
+  free(self->raw);
+  free(self->packed);
+  free(self->table);
+  free(self->blocks);
+  memset(self, 0, sizeof(code_archive_writer_t));
+  self->fd = -1;
+}
+
+// Make room for len more bytes in the block, growing it past the block size
+// for a single code that is bigger than that
+static int archive_reserve(code_archive_writer_t *self, size_t len) {
+  if (self->raw_len + len <= self->raw_cap) {
+    return 0;
+  }
+  // A code that is bigger than a block gets a block of its own, and the
+  // buffers go back to the block size once it is written
+  char *raw = realloc(self->raw, self->raw_len + len);
+  if (raw == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  self->raw = raw;
+  self->raw_cap = self->raw_len + len;
+  return 0;
+}
+
+// Shrink the buffers after a block that was bigger than the block size
+static void archive_shrink(code_archive_writer_t *self) {
+  if (self->raw_cap > self->block_size) {
+    char *raw = realloc(self->raw, self->block_size);
+    if (raw != NULL) {
+      self->raw = raw;
+      self->raw_cap = self->block_size;
+    }
+  }
+  if (self->packed_cap > self->block_size) {
+    char *packed = realloc(self->packed, self->block_size);
+    if (packed != NULL) {
+      self->packed = packed;
+      self->packed_cap = self->block_size;
+    }
+  }
+}
+
+// Pack the block and write it with its header
+static int archive_flush(code_archive_writer_t *self) {
+  if (self->raw_len == 0) {
+    return 0;
+  }
+  if (self->num_blocks == self->blocks_cap) {
+    size_t cap = self->blocks_cap == 0 ? 64 : self->blocks_cap * 2;
+    code_block_t *blocks = realloc(self->blocks, sizeof(code_block_t) * cap);
+    if (blocks == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    self->blocks = blocks;
+    self->blocks_cap = cap;
+  }
+  if (self->packed_cap < self->raw_len) {
+    char *packed = realloc(self->packed, self->raw_len);
+    if (packed == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    self->packed = packed;
+    self->packed_cap = self->raw_len;
+  }
+  // A block that doesn't get smaller is stored as it is, which a packed length
+  // equal to the raw length tells the reader
+  const char *data = self->packed;
+  size_t len = lz_compress(self->raw, self->raw_len, self->packed,
+                           self->raw_len - 1, self->table);
+  if (len == 0) {
+    data = self->raw;
+    len = self->raw_len;
+  }
+
+  code_block_t *block = &self->blocks[self->num_blocks];
+  block->offset = self->offset;
+  block->first_code = 0;
+  if (self->num_blocks > 0) {
+    code_block_t *last = block - 1;
+    block->first_code = last->first_code + last->num_codes;
+  }
+  block->num_codes = self->num_codes;
+  block->raw_len = self->raw_len;
+  block->packed_len = len;
+
+  char header[32];
+  size_t pos = index_put(header, self->raw_len);
+  pos += index_put(header + pos, len);
+  pos += index_put(header + pos, self->num_codes);
+  uint32_t crc = crc32c_calc(self->raw, self->raw_len, 0);
+  pos += archive_put_crc(header + pos, crc);
+  if (archive_send(self, header, pos) < 0 ||
+      archive_send(self, data, len) < 0) {
+    return SCODE_ERROR_FILE;
+  }
+  self->num_blocks++;
+  self->raw_len = 0;
+  self->num_codes = 0;
+  archive_shrink(self);
+  return 0;
+}
+
+int code_archive_write(code_archive_writer_t *self, const char *buf,
+                       size_t len, uint64_t num_codes) {
+  if (self->raw_len > 0 && self->raw_len + len > self->block_size) {
+    int res = archive_flush(self);
+    if (res < 0) {
+      return res;
+    }
+  }
+  int res = archive_reserve(self, len);
+  if (res < 0) {
+    return res;
+  }
+  memcpy(self->raw + self->raw_len, buf, len);
+  self->raw_len += len;
+  self->num_codes += num_codes;
+  return 0;
+}
+
+int code_archive_dump_binary(code_archive_writer_t *self, const code_t *code) {
+  int size = code_dump_binary_checksum_size(code, self->checksum);
+  if (size < 0) {
+    return size;
+  }
+  if (self->raw_len > 0 && self->raw_len + size > self->block_size) {
+    int res = archive_flush(self);
+    if (res < 0) {
+      return res;
+    }
+  }
+  int res = archive_reserve(self, size);
+  if (res < 0) {
+    return res;
+  }
+  res = code_dump_binary_checksum(code, self->raw + self->raw_len, size,
+                                  self->checksum);
+  if (res < 0) {
+    return res;
+  }
+  self->raw_len += res;
+  self->num_codes++;
+  return res;
+}
+
+int code_archive_finish(code_archive_writer_t *self) {
+  int res = archive_flush(self);
+  if (res < 0) {
+    return res;
+  }
+  // A header with no codes ends the blocks, and the lengths of every block
+  // follow it
+  char *buf =
+      malloc(1 + 10 + 30 * self->num_blocks + ARCHIVE_CRC + ARCHIVE_TRAILER);
+  if (buf == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  uint64_t footer = self->offset;
+  size_t pos = 0;
+  buf[pos++] = 0;
+  pos += index_put(buf + pos, self->num_blocks);
+  for (size_t i = 0; i < self->num_blocks; ++i) {
+    pos += index_put(buf + pos, self->blocks[i].raw_len);
+    pos += index_put(buf + pos, self->blocks[i].packed_len);
+    pos += index_put(buf + pos, self->blocks[i].num_codes);
+  }
+  pos += archive_put_crc(buf + pos, crc32c_calc(buf, pos, 0));
+  for (int i = 0; i < 8; ++i) {
+    buf[pos++] = footer >> (8 * i);
+  }
+  memcpy(buf + pos, ARCHIVE_MAGIC, 4);
+  pos += 4;
+  res = archive_send(self, buf, pos);
+  free(buf);
+  return res;
+}
+
+int code_archive_pack(const char *path, const char *archive_path,
+                      size_t block_size) {
+  return code_archive_pack_checksum(path, archive_path, block_size,
+                                    SCODE_CHECKSUM_CRC8);
+}
+
+int code_archive_pack_checksum(const char *path, const char *archive_path,
+                               size_t block_size, uint8_t checksum) {
+  code_file_t file;
+  if (init_code_file(&file, path) < 0) {
+    free_code_file(&file);
+    return SCODE_ERROR_FILE;
+  }
+  code_file_set_checksum(&file, checksum);
+  int fd = open(archive_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    free_code_file(&file);
+    return SCODE_ERROR_FILE;
+  }
+  code_archive_writer_t writer;
+  int res =
+      init_code_archive_writer_checksum(&writer, fd, block_size, checksum);
+  // Each code is added along with the comments and empty lines before it
+  size_t start = 0;
+  code_view_t view;
+  while (res == 0) {
+    int popped = code_file_pop_view(&file, &view);
+    if (popped == SCODE_ERROR_BUFFER || popped == SCODE_ERROR_MEMORY) {
+      res = popped == SCODE_ERROR_MEMORY ? popped : 0;
+      break;
+    }
+    res = code_archive_write(&writer, file.buf + start, file.pos - start,
+                             popped == 0);
+    start = file.pos;
+  }
+  if (res == 0) {
+    res = code_archive_write(&writer, file.buf + start, file.len - start, 0);
+  }
+  if (res == 0) {
+    res = code_archive_finish(&writer);
+  }
+  free_code_archive_writer(&writer);
+  if (close(fd) != 0 && res == 0) {
+    res = SCODE_ERROR_FILE;
+  }
+  free_code_file(&file);
+  return res;
+}
+
+// Read the header of a block, returning the offset of its data
+static int archive_header(const char *buf, size_t len, size_t pos,
+                          code_block_t *block, uint32_t *crc, size_t *data) {
+  uint64_t raw_len, packed_len;
+  block->offset = pos;
+  if (index_get(buf, len, &pos, &raw_len) < 0 || raw_len == 0 ||
+      index_get(buf, len, &pos, &packed_len) < 0 ||
+      index_get(buf, len, &pos, &block->num_codes) < 0 ||
+      len - pos < ARCHIVE_CRC) {
+    return SCODE_ERROR_PARSE;
+  }
+  *crc = archive_get_crc(buf + pos);
+  pos += ARCHIVE_CRC;
+  if (packed_len > raw_len || packed_len > len - pos) {
+    return SCODE_ERROR_PARSE;
+  }
+  block->raw_len = raw_len;
+  block->packed_len = packed_len;
+  *data = pos;
+  return 0;
+}
+
+// Read the blocks from the footer
+static int archive_footer(code_archive_t *self) {
+  const char *buf = self->file.buf;
+  size_t len = self->file.len;
+  if (len < ARCHIVE_HEADER + 2 + ARCHIVE_CRC + ARCHIVE_TRAILER ||
+      memcmp(buf + len - 4, ARCHIVE_MAGIC, 4) != 0) {
+    return SCODE_ERROR_PARSE;
+  }
+  uint64_t footer = 0;
+  for (int i = 0; i < 8; ++i) {
+    footer |= (uint64_t)(uint8_t)buf[len - ARCHIVE_TRAILER + i] << (8 * i);
+  }
+  size_t end = len - ARCHIVE_TRAILER - ARCHIVE_CRC;
+  if (footer < ARCHIVE_HEADER || footer >= end || buf[footer] != 0 ||
+      crc32c_calc(buf + footer, end - footer, 0) !=
+          archive_get_crc(buf + end)) {
+    return SCODE_ERROR_PARSE;
+  }
+  size_t pos = footer + 1;
+  uint64_t num_blocks;
+  // Every block takes at least three bytes
+  if (index_get(buf, end, &pos, &num_blocks) < 0 ||
+      num_blocks > (end - pos) / 3) {
+    return SCODE_ERROR_PARSE;
+  }
+  self->blocks = malloc(sizeof(code_block_t) * (num_blocks + 1));
+  if (self->blocks == NULL) {
+    return SCODE_ERROR_MEMORY;
+  }
+  uint64_t offset = ARCHIVE_HEADER;
+  uint64_t first_code = 0;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    code_block_t *block = &self->blocks[i];
+    uint64_t raw_len, packed_len;
+    if (index_get(buf, end, &pos, &raw_len) < 0 ||
+        index_get(buf, end, &pos, &packed_len) < 0 ||
+        index_get(buf, end, &pos, &block->num_codes) < 0) {
+      return SCODE_ERROR_PARSE;
+    }
+    char header[32];
+    size_t header_len = index_put(header, raw_len);
+    header_len += index_put(header, packed_len);
+    header_len += index_put(header, block->num_codes) + ARCHIVE_CRC;
+    block->offset = offset;
+    block->first_code = first_code;
+    block->raw_len = raw_len;
+    block->packed_len = packed_len;
+    offset += header_len + packed_len;
+    first_code += block->num_codes;
+    if (offset > footer) {
+      return SCODE_ERROR_PARSE;
+    }
+  }
+  if (pos != end || offset != footer) {
+    return SCODE_ERROR_PARSE;
+  }
+  self->num_blocks = num_blocks;
+  self->num_codes = first_code;
+  return 0;
+}
+
+// Find the blocks by reading their headers, up to the first incomplete one
+static int archive_walk(code_archive_t *self) {
+  size_t cap = 0;
+  size_t pos = ARCHIVE_HEADER;
+  uint64_t first_code = 0;
+  while (1) {
+    if (self->num_blocks == cap) {
+      cap = cap == 0 ? 64 : cap * 2;
+      code_block_t *blocks = realloc(self->blocks, sizeof(code_block_t) * cap);
+      if (blocks == NULL) {
+        return SCODE_ERROR_MEMORY;
+      }
+      self->blocks = blocks;
+    }
+    code_block_t *block = &self->blocks[self->num_blocks];
+    uint32_t crc;
+    size_t data;
+    if (archive_header(self->file.buf, self->file.len, pos, block, &crc,
+                       &data) < 0) {
+      break;
+    }
+    block->first_code = first_code;
+    first_code += block->num_codes;
+    pos = data + block->packed_len;
+    self->num_blocks++;
+  }
+  self->num_codes = first_code;
+  return 0;
+}
+
+int init_code_archive(code_archive_t *self, const char *path) {
+  memset(self, 0, sizeof(code_archive_t));
+  if (init_code_file(&self->file, path) < 0) {
+    return SCODE_ERROR_FILE;
+  }
+  if (self->file.len < ARCHIVE_HEADER ||
+      memcmp(self->file.buf, ARCHIVE_MAGIC, 4) != 0 ||
+      self->file.buf[4] != ARCHIVE_VERSION) {
+    return SCODE_ERROR_PARSE;
+  }
+  self->checksum = self->file.buf[5];
+  if (self->checksum != SCODE_CHECKSUM_CRC8 &&
+      self->checksum != SCODE_CHECKSUM_CRC16 &&
+      self->checksum != SCODE_CHECKSUM_CRC32C) {
+    return SCODE_ERROR_PARSE;
+  }
+  int res = archive_footer(self);
+  if (res == SCODE_ERROR_PARSE) {
+    free(self->blocks);
+    self->blocks = NULL;
+    self->num_blocks = 0;
+    res = archive_walk(self);
+  }
+  return res;
+}
+
+void free_code_archive(code_archive_t *self) {
+  free_code_file(&self->file);
+  free(self->blocks);
+  free(self->raw);
+  free(self->views);
+  memset(self, 0, sizeof(code_archive_t));
+}
+
+int code_archive_read_block(const code_archive_t *self, size_t block,
+                            char *buf) {
+  const code_block_t *expected = &self->blocks[block];
+  code_block_t found;
+  uint32_t crc;
+  size_t data;
+  if (archive_header(self->file.buf, self->file.len, expected->offset, &found,
+                     &crc, &data) < 0 ||
+      found.raw_len != expected->raw_len ||
+      found.packed_len != expected->packed_len) {
+    return SCODE_ERROR_PARSE;
+  }
+  if (found.packed_len == found.raw_len) {
+    memcpy(buf, self->file.buf + data, found.raw_len);
+  } else if (lz_decompress(self->file.buf + data, found.packed_len, buf,
+                           found.raw_len) < 0) {
+    return SCODE_ERROR_PARSE;
+  }
+  if (crc32c_calc(buf, found.raw_len, 0) != crc) {
+    return SCODE_ERROR_CRC;
+  }
+  return 0;
+}
+
+// Unpack a block into a buffer that grows to fit it, with a line ending after
+// it so that a last code without one can be parsed
+static int archive_unpack(const code_archive_t *self, size_t block,
+                          char **raw, size_t *raw_cap) {
+  size_t len = self->blocks[block].raw_len;
+  if (*raw_cap < len + 1) {
+    char *grown = realloc(*raw, len + 1);
+    if (grown == NULL) {
+      return SCODE_ERROR_MEMORY;
+    }
+    *raw = grown;
+    *raw_cap = len + 1;
+  }
+  int res = code_archive_read_block(self, block, *raw);
+  if (res < 0) {
+    return res;
+  }
+  (*raw)[len] = '\n';
+  return 0;
+}
+
+static int code_archive_next(code_archive_t *self, code_t *code,
+                             code_view_t *view) {
+  while (1) {
+    if (self->pos < self->raw_len) {
+      size_t consumed;
+      int res = file_parse(&self->views, &self->views_cap,
+                           self->raw + self->pos, self->raw_len - self->pos,
+                           &consumed, code, view, NULL, self->checksum);
+      if (res != SCODE_ERROR_BUFFER) {
+        self->pos += consumed;
+        return res;
+      }
+    }
+    // Only comments and empty lines are left, so go on to the next block
+    self->pos = 0;
+    self->raw_len = 0;
+    if (self->block >= self->num_blocks) {
+      return SCODE_ERROR_BUFFER;
+    }
+    size_t block = self->block++;
+    int res = archive_unpack(self, block, &self->raw, &self->raw_cap);
+    if (res < 0) {
+      return res;
+    }
+    self->raw_len = self->blocks[block].raw_len + 1;
+  }
+}
+
+int code_archive_pop(code_archive_t *self, code_t *code) {
+  return code_archive_next(self, code, NULL);
+}
+
+int code_archive_pop_view(code_archive_t *self, code_view_t *code) {
+  return code_archive_next(self, NULL, code);
+}
+
+int scode_parse_archive_parallel(scode_codes_t *self, const char *path,
+                                 size_t num_threads) {
+  memset(self, 0, sizeof(scode_codes_t));
+  if (num_threads == 0) {
+    num_threads = default_threads();
+  }
+  code_archive_t archive;
+  int res = init_code_archive(&archive, path);
+  if (res < 0) {
+    free_code_archive(&archive);
+    return res;
+  }
+  parse_chunk_t *chunks = calloc(archive.num_blocks + 1, sizeof(parse_chunk_t));
+  if (chunks == NULL) {
+    free_code_archive(&archive);
+    return SCODE_ERROR_MEMORY;
+  }
+  for (size_t i = 0; i < archive.num_blocks; ++i) {
+    chunks[i].end = archive.blocks[i].raw_len + 1;
+  }
+  parse_job_t job = {NULL, 0, chunks, archive.num_blocks, 0, &archive,
+                     archive.checksum};
+  res = parse_run(self, &job, num_threads);
+  free_code_archive(&archive);
+  return res;
+}
+
+#endif
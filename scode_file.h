@@ -0,0 +1,732 @@
+#pragma once
+
+#include "scode.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Reading whole files needs POSIX threads, memory maps and the heap
+#if !defined(SCODE_FILE)
+#if (defined(__unix__) || defined(__APPLE__)) && !defined(SCODE_NO_MALLOC)
+#define SCODE_FILE 1
+#else
+#define SCODE_FILE 0
+#endif
+#endif
+
+#define SCODE_ERROR_FILE -8
+
+#if SCODE_FILE
+
+#include <sys/uio.h>
+
+/**
+ * A file of codes that is read straight from a memory map
+ *
+ * Codes are parsed from the mapping one at a time, so nothing is copied into a
+ * stream buffer and the file can be larger than memory. The kernel is told
+ * that the file will be read in order so it can read ahead and drop pages that
+ * are done with.
+ */
+typedef struct {
+  const char *buf;     // the mapped file
+  size_t len;          // length of the file
+  size_t pos;          // offset of the next code
+  char *tail;          // copy of a last line that has no line ending
+  param_view_t *views; // params of the last code_file_pop_view()
+  size_t views_cap;
+  uint8_t checksum; // SCODE_CHECKSUM_X of binary codes
+} code_file_t;
+
+/**
+ * Map a file for reading
+ *
+ * free_code_file() should be called after use, even if this fails.
+ *
+ * @param path file to read
+ *
+ * @return 0 for success, or SCODE_ERROR_FILE if the file could not be mapped
+ */
+int init_code_file(code_file_t *self, const char *path);
+/**
+ * Unmap the file and free everything that it uses
+ */
+void free_code_file(code_file_t *self);
+/**
+ * Set the checksum that binary codes in the file end with, which is CRC-8
+ * until this is called
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ */
+void code_file_set_checksum(code_file_t *self, uint8_t checksum);
+/**
+ * Parse the next code of the file
+ *
+ * Invalid codes are skipped and their error is returned, so the next call
+ * continues with the code after them. This includes a code that there isn't
+ * memory for, which gives SCODE_ERROR_MEMORY.
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER at the end of the file, or one of
+ * the SCODE_ERROR_X errors
+ */
+int code_file_pop(code_file_t *self, code_t *code);
+/**
+ * Parse the next code of the file using an arena
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER at the end of the file, or one of
+ * the SCODE_ERROR_X errors
+ */
+int code_file_pop_arena(code_file_t *self, code_t *code, scode_arena_t *arena);
+/**
+ * Borrow the next code of the file without copying it
+ *
+ * String params point into the mapping. The params array is owned by the file
+ * and is only valid until the next call to code_file_pop_view().
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER at the end of the file, or one of
+ * the SCODE_ERROR_X errors
+ */
+int code_file_pop_view(code_file_t *self, code_view_t *code);
+
+#define CODE_INDEX_INTERVAL 1024 // default number of codes between offsets
+
+/**
+ * A comment that was found while building an index, like ";LAYER:12"
+ */
+typedef struct {
+  uint64_t code;   // ordinal of the first code after the marker
+  uint64_t offset; // offset of the marker in the file
+  int64_t value;   // number that follows the marker, or 0
+} code_marker_t;
+
+/**
+ * Byte offsets of every Kth code of a file
+ *
+ * Codes are numbered from 0 in the order code_file_pop() returns them, so
+ * invalid codes are not counted. Seeking to a code only has to parse the codes
+ * between it and the offset before it. An index can be saved next to the file
+ * it was built from and loaded again later.
+ */
+typedef struct {
+  uint64_t interval;  // number of codes between offsets
+  uint64_t num_codes; // number of codes in the file
+  uint64_t file_len;  // length of the file the index was built from
+  uint64_t *offsets;  // offset of code i * interval
+  size_t num_offsets;
+  code_marker_t *markers;
+  size_t num_markers;
+} code_index_t;
+
+/**
+ * Build an index of a file, starting from the beginning of it
+ *
+ * The file is read to the end. free_code_index() should be called after use.
+ *
+ * @param file file to index
+ * @param interval number of codes between offsets, or 0 for
+ * CODE_INDEX_INTERVAL
+ * @param marker text that starts a marker comment, like ";LAYER:", or NULL for
+ * no markers
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int code_index_build(code_index_t *self, code_file_t *file, uint64_t interval,
+                     const char *marker);
+/**
+ * Write an index to a sidecar file
+ *
+ * @param path file to write
+ *
+ * @return 0 for success, or SCODE_ERROR_FILE
+ */
+int code_index_save(const code_index_t *self, const char *path);
+/**
+ * Read an index that was written by code_index_save()
+ *
+ * free_code_index() should be called after use, even if this fails.
+ *
+ * @param path file to read
+ *
+ * @return 0 for success, SCODE_ERROR_FILE if the file could not be read, or
+ * SCODE_ERROR_PARSE or SCODE_ERROR_CRC if it is not a valid index
+ */
+int code_index_load(code_index_t *self, const char *path);
+/**
+ * Free an index
+ */
+void free_code_index(code_index_t *self);
+/**
+ * Find where to start reading to get to a code
+ *
+ * This is how a code_stream_t is moved to a code. Feed it the file from the
+ * offset, then pop and drop code - *start codes.
+ *
+ * @param code ordinal of the code to find
+ * @param offset set to the offset of the closest indexed code before it
+ * @param start set to the ordinal of the code at the offset
+ *
+ * @return 0 for success, or SCODE_ERROR_BUFFER if there is no such code
+ */
+int code_index_find(const code_index_t *self, uint64_t code, uint64_t *offset,
+                    uint64_t *start);
+/**
+ * Find the first marker with a value
+ *
+ * @param value value to look for, like the layer number
+ *
+ * @return marker or NULL if there is none
+ */
+const code_marker_t *code_index_marker(const code_index_t *self,
+                                       int64_t value);
+/**
+ * Move a file so that the next code popped is a given code
+ *
+ * @param index index of the file
+ * @param code ordinal of the code
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER if there is no such code, or
+ * SCODE_ERROR_FILE if the index was built from a different file
+ */
+int code_file_seek(code_file_t *self, const code_index_t *index, uint64_t code);
+
+/**
+ * Every code of a file, in the order they were in the file
+ *
+ * The params of the codes live in the arenas, so the codes don't need to be
+ * freed one by one. Use free_scode_codes() to free everything.
+ */
+typedef struct {
+  code_t *codes;
+  size_t num_codes;
+  size_t num_errors; // codes that were skipped because they were invalid
+  scode_arena_t *arenas;
+  size_t num_arenas;
+} scode_codes_t;
+
+/**
+ * Parse a buffer of codes on several threads
+ *
+ * The buffer is split into chunks at line and frame boundaries which are
+ * parsed at the same time. The result is the same as parsing the buffer from
+ * start to end with code_parse_next(). A final line without a line ending is
+ * parsed as well.
+ *
+ * @param buf buffer to parse
+ * @param len length of the buffer
+ * @param num_threads number of threads to use, or 0 for one per core
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int scode_parse_parallel(scode_codes_t *self, const char *buf, size_t len,
+                         size_t num_threads);
+/**
+ * Parse a buffer of codes on several threads like scode_parse_parallel(), with
+ * binary codes ending in a checksum other than CRC-8
+ *
+ * The chunks are split after the checksum of a binary frame as well.
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int scode_parse_parallel_checksum(scode_codes_t *self, const char *buf,
+                                  size_t len, size_t num_threads,
+                                  uint8_t checksum);
+/**
+ * Parse a file of codes on several threads
+ *
+ * @param path file to parse
+ * @param num_threads number of threads to use, or 0 for one per core
+ *
+ * @return 0 for success, SCODE_ERROR_FILE if the file could not be read, or
+ * one of the SCODE_ERROR_X errors
+ */
+int scode_parse_file_parallel(scode_codes_t *self, const char *path,
+                              size_t num_threads);
+/**
+ * Parse a file of codes on several threads, with binary codes ending in a
+ * checksum other than CRC-8
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return the same as scode_parse_file_parallel()
+ */
+int scode_parse_file_parallel_checksum(scode_codes_t *self, const char *path,
+                                       size_t num_threads, uint8_t checksum);
+/**
+ * Free all of the codes
+ */
+void free_scode_codes(scode_codes_t *self);
+
+#define CODE_WRITER_CAPACITY 4096 // default size of a writer's buffer
+
+/**
+ * Where a writer sends its data, with the same contract as writev()
+ *
+ * @return number of bytes written, which may be less than all of them, or
+ * below zero on an error
+ */
+typedef ssize_t (*code_write_fn)(void *ctx, const struct iovec *iov, int num);
+
+/**
+ * Buffered output of codes to a file descriptor or a callback
+ *
+ * Codes are dumped straight into the buffer, which is sent with as few
+ * writev() calls as possible. The buffer is sent when it is full, when the
+ * flush size is reached, when the oldest byte in it has waited for the flush
+ * latency, or when code_writer_flush() is called.
+ */
+typedef struct {
+  int fd;              // file descriptor, or -1 if write is used
+  code_write_fn write; // callback that data is sent to
+  void *ctx;           // passed to write
+  char *buf;
+  size_t len;          // bytes waiting in buf
+  size_t cap;
+  size_t capacity;     // size of buf when it hasn't grown to keep a write
+  size_t flush_size;   // send once this many bytes are waiting, or 0 when full
+  uint64_t flush_ns;   // longest a byte may wait, or 0 for no limit
+  uint64_t since;      // when the oldest waiting byte was added
+  size_t num_writes;   // number of calls to writev() or write so far
+  uint8_t checksum;    // SCODE_CHECKSUM_X of binary dumps
+} code_writer_t;
+
+/**
+ * Initialize a writer that writes to a file descriptor
+ *
+ * @param fd file descriptor to write to. It is not closed by the writer.
+ * @param capacity size of the buffer, or 0 for CODE_WRITER_CAPACITY
+ *
+ * @return 0 for success, or SCODE_ERROR_MEMORY
+ */
+int init_code_writer(code_writer_t *self, int fd, size_t capacity);
+/**
+ * Initialize a writer that sends its data to a callback
+ *
+ * @param write callback to send data to
+ * @param ctx passed to the callback
+ * @param capacity size of the buffer, or 0 for CODE_WRITER_CAPACITY
+ *
+ * @return 0 for success, or SCODE_ERROR_MEMORY
+ */
+int init_code_writer_fn(code_writer_t *self, code_write_fn write, void *ctx,
+                        size_t capacity);
+/**
+ * Free the buffer of a writer. Anything that is still waiting is dropped, so
+ * call code_writer_flush() first.
+ */
+void free_code_writer(code_writer_t *self);
+/**
+ * Set when the buffer is sent before it is full
+ *
+ * The latency is checked whenever something is written, and by
+ * code_writer_poll().
+ *
+ * @param size send once this many bytes are waiting, or 0 for when full
+ * @param latency_us longest a byte may wait in microseconds, or 0 for no limit
+ */
+void code_writer_set_flush(code_writer_t *self, size_t size,
+                           uint32_t latency_us);
+/**
+ * Set the checksum that code_writer_dump_binary() ends codes with, which is
+ * CRC-8 until this is called
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ */
+void code_writer_set_checksum(code_writer_t *self, uint8_t checksum);
+/**
+ * Send everything that is waiting
+ *
+ * What can't be sent stays in the buffer, so a flush after a short write or
+ * EAGAIN goes on from where the last one stopped.
+ *
+ * @return 0 for success, or SCODE_ERROR_FILE with errno set
+ */
+int code_writer_flush(code_writer_t *self);
+/**
+ * Send everything that is waiting if the oldest byte has waited for the flush
+ * latency. Call it while idle so that data isn't held back.
+ *
+ * @return 0 for success, or SCODE_ERROR_FILE with errno set
+ */
+int code_writer_poll(code_writer_t *self);
+/**
+ * Write raw bytes. Writes that don't fit in the buffer are sent along with
+ * the buffer in one writev() call, without copying them.
+ *
+ * Writes and dumps only fail if none of their bytes were taken, so they can be
+ * tried again. Once some of them are taken, the rest are sent by a later
+ * flush, and an error in sending them is reported by it.
+ *
+ * @return 0 for success, or SCODE_ERROR_FILE with errno set
+ */
+int code_writer_write(code_writer_t *self, const char *buf, size_t len);
+/**
+ * Dump a code as a binary code straight into the writer
+ *
+ * @return number of bytes dumped, or one of the SCODE_ERROR_X errors
+ */
+int code_writer_dump_binary(code_writer_t *self, const code_t *code);
+/**
+ * Dump a code as a human code straight into the writer, without a null
+ * terminator
+ *
+ * @return number of bytes dumped, or one of the SCODE_ERROR_X errors
+ */
+int code_writer_dump_human(code_writer_t *self, const code_t *code);
+/**
+ * Dump a code as a human code straight into the writer, with floats rounded to
+ * a fixed number of decimals
+ *
+ * @param decimals number of decimals to write for floats
+ *
+ * @return number of bytes dumped, or one of the SCODE_ERROR_X errors
+ */
+int code_writer_dump_human_fixed(code_writer_t *self, const code_t *code,
+                                 uint8_t decimals);
+
+// Default size of an archive block before packing
+#define CODE_ARCHIVE_BLOCK (256 * 1024)
+
+/**
+ * A block of an archive
+ */
+typedef struct {
+  uint64_t offset;     // offset of the block's header in the archive
+  uint64_t first_code; // ordinal of the first code in the block
+  uint64_t num_codes;  // number of valid codes in the block
+  size_t raw_len;      // length of the codes in the block
+  size_t packed_len;   // length of the block in the archive, after the header
+} code_block_t;
+
+/**
+ * Writes an archive of codes
+ *
+ * An archive is a series of blocks that are compressed on their own, so they
+ * can be read in order without the rest of the archive, or many at a time.
+ * Each block holds whole codes and has a header with its lengths, its number
+ * of codes and the CRC-32C of its codes. A footer at the end lists the blocks.
+ * The header of the archive records the checksum that its binary codes end
+ * with.
+ */
+typedef struct {
+  int fd;
+  uint64_t offset;  // bytes written to fd so far
+  char *raw;        // codes of the block that is being filled
+  size_t raw_len;
+  size_t raw_cap;
+  size_t block_size;
+  uint64_t num_codes; // codes in raw
+  char *packed;
+  size_t packed_cap;
+  uint32_t *table; // match finder of the compressor
+  code_block_t *blocks;
+  size_t num_blocks;
+  size_t blocks_cap;
+  uint8_t checksum; // SCODE_CHECKSUM_X of the binary codes
+} code_archive_writer_t;
+
+/**
+ * Initialize a writer that writes an archive to a file descriptor
+ *
+ * @param fd file descriptor to write to. It is not closed by the writer.
+ * @param block_size size of a block before packing, or 0 for
+ * CODE_ARCHIVE_BLOCK
+ *
+ * @return 0 for success, SCODE_ERROR_MEMORY, or SCODE_ERROR_FILE if the header
+ * could not be written
+ */
+int init_code_archive_writer(code_archive_writer_t *self, int fd,
+                             size_t block_size);
+/**
+ * Initialize a writer whose binary codes end with a checksum other than CRC-8
+ *
+ * code_archive_dump_binary() dumps with the checksum, and codes given to
+ * code_archive_write() must already end with it. Readers of the archive parse
+ * with it too.
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return the same as init_code_archive_writer()
+ */
+int init_code_archive_writer_checksum(code_archive_writer_t *self, int fd,
+                                      size_t block_size, uint8_t checksum);
+/**
+ * Free a writer without finishing the archive
+ */
+void free_code_archive_writer(code_archive_writer_t *self);
+/**
+ * Add codes to the archive. A block is packed and written once it is full.
+ *
+ * @param buf whole codes, human or binary
+ * @param num_codes number of valid codes in buf
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int code_archive_write(code_archive_writer_t *self, const char *buf,
+                       size_t len, uint64_t num_codes);
+/**
+ * Add a code to the archive as a binary code
+ *
+ * @return number of bytes dumped, or one of the SCODE_ERROR_X errors
+ */
+int code_archive_dump_binary(code_archive_writer_t *self, const code_t *code);
+/**
+ * Write the last block and the footer. The writer still has to be freed.
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int code_archive_finish(code_archive_writer_t *self);
+/**
+ * Write a file of codes as an archive
+ *
+ * Comments and empty lines are kept, so the archive holds the same bytes.
+ *
+ * @param path file of codes to read
+ * @param archive_path archive to write
+ * @param block_size size of a block before packing, or 0 for
+ * CODE_ARCHIVE_BLOCK
+ *
+ * @return 0 for success, or one of the SCODE_ERROR_X errors
+ */
+int code_archive_pack(const char *path, const char *archive_path,
+                      size_t block_size);
+/**
+ * Write a file of codes as an archive, with binary codes in the file ending in
+ * a checksum other than CRC-8. The archive records the checksum.
+ *
+ * @param checksum one of the SCODE_CHECKSUM_X values, anything else is CRC-8
+ *
+ * @return the same as code_archive_pack()
+ */
+int code_archive_pack_checksum(const char *path, const char *archive_path,
+                               size_t block_size, uint8_t checksum);
+
+/**
+ * An archive that is read from a memory map
+ *
+ * Codes are popped from one unpacked block at a time.
+ */
+typedef struct {
+  code_file_t file; // the mapped archive
+  code_block_t *blocks;
+  size_t num_blocks;
+  uint64_t num_codes;
+  size_t block;        // block that is unpacked in raw
+  char *raw;           // unpacked block, with a line ending after it
+  size_t raw_len;
+  size_t raw_cap;
+  size_t pos;          // offset of the next code in raw
+  param_view_t *views; // params of the last code_archive_pop_view()
+  size_t views_cap;
+  uint8_t checksum; // SCODE_CHECKSUM_X of the binary codes
+} code_archive_t;
+
+/**
+ * Open an archive for reading
+ *
+ * The blocks are read from the footer. An archive without a valid footer, like
+ * one that was cut short, is read by walking the headers of its blocks up to
+ * the first one that is incomplete. free_code_archive() should be called after
+ * use, even if this fails.
+ *
+ * @param path archive to read
+ *
+ * @return 0 for success, SCODE_ERROR_FILE if the file could not be mapped, or
+ * SCODE_ERROR_PARSE if it is not an archive
+ */
+int init_code_archive(code_archive_t *self, const char *path);
+/**
+ * Unmap the archive and free everything that it uses
+ */
+void free_code_archive(code_archive_t *self);
+/**
+ * Unpack a block. This can be called from many threads at once.
+ *
+ * @param block index of the block
+ * @param buf where to put the codes, which must hold the block's raw_len
+ *
+ * @return 0 for success, SCODE_ERROR_PARSE if the block is damaged, or
+ * SCODE_ERROR_CRC if its codes don't match its CRC
+ */
+int code_archive_read_block(const code_archive_t *self, size_t block,
+                            char *buf);
+/**
+ * Parse the next code of the archive
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER at the end of the archive, or one
+ * of the SCODE_ERROR_X errors. An error unpacking a block skips the block.
+ */
+int code_archive_pop(code_archive_t *self, code_t *code);
+/**
+ * Borrow the next code of the archive without copying it
+ *
+ * The code is only valid until the next pop.
+ *
+ * @return 0 for success, SCODE_ERROR_BUFFER at the end of the archive, or one
+ * of the SCODE_ERROR_X errors
+ */
+int code_archive_pop_view(code_archive_t *self, code_view_t *code);
+/**
+ * Parse an archive on several threads, one block at a time
+ *
+ * @param path archive to parse
+ * @param num_threads number of threads to use, or 0 for one per core
+ *
+ * @return 0 for success, SCODE_ERROR_FILE if the file could not be read, or
+ * one of the SCODE_ERROR_X errors
+ */
+int scode_parse_archive_parallel(scode_codes_t *self, const char *path,
+                                 size_t num_threads);
+
+#endif
+
+#if defined(__cplusplus)
+}
+
+#if SCODE_FILE
+
+class CodeFile {
+public:
+  code_file_t code_file;
+
+  CodeFile() : code_file({0}) {}
+  CodeFile(const char *path) : code_file({0}) {
+    init_code_file(&this->code_file, path);
+  }
+  CodeFile(CodeFile &&other) : code_file(other.code_file) {
+    other.code_file = code_file_t();
+  }
+  CodeFile(CodeFile &other) = delete;
+
+  ~CodeFile() { free_code_file(&this->code_file); }
+
+  bool is_open() const { return this->code_file.buf != nullptr; }
+
+  int pop(code_t *code) { return code_file_pop(&this->code_file, code); }
+  int pop(code_t *code, Arena &arena) {
+    return code_file_pop_arena(&this->code_file, code, &arena.arena);
+  }
+  int pop_view(code_view_t *code) {
+    return code_file_pop_view(&this->code_file, code);
+  }
+  int seek(const code_index_t &index, uint64_t code) {
+    return code_file_seek(&this->code_file, &index, code);
+  }
+  void set_checksum(uint8_t checksum) {
+    code_file_set_checksum(&this->code_file, checksum);
+  }
+};
+
+class CodeWriter {
+public:
+  code_writer_t code_writer;
+
+  CodeWriter() : code_writer({0}) { this->code_writer.fd = -1; }
+  CodeWriter(int fd, size_t capacity = 0) : code_writer({0}) {
+    init_code_writer(&this->code_writer, fd, capacity);
+  }
+  CodeWriter(code_write_fn write, void *ctx, size_t capacity = 0)
+      : code_writer({0}) {
+    init_code_writer_fn(&this->code_writer, write, ctx, capacity);
+  }
+  CodeWriter(CodeWriter &&other) : code_writer(other.code_writer) {
+    other.code_writer = code_writer_t();
+    other.code_writer.fd = -1;
+  }
+  CodeWriter(CodeWriter &other) = delete;
+
+  ~CodeWriter() {
+    code_writer_flush(&this->code_writer);
+    free_code_writer(&this->code_writer);
+  }
+
+  void set_flush(size_t size, uint32_t latency_us = 0) {
+    code_writer_set_flush(&this->code_writer, size, latency_us);
+  }
+  void set_checksum(uint8_t checksum) {
+    code_writer_set_checksum(&this->code_writer, checksum);
+  }
+  int flush() { return code_writer_flush(&this->code_writer); }
+  int poll() { return code_writer_poll(&this->code_writer); }
+  int write(const char *buf, size_t len) {
+    return code_writer_write(&this->code_writer, buf, len);
+  }
+  int dump_binary(const Code &code) {
+    return code_writer_dump_binary(&this->code_writer, &code.code);
+  }
+  int dump_human(const Code &code) {
+    return code_writer_dump_human(&this->code_writer, &code.code);
+  }
+  int dump_human(const Code &code, uint8_t decimals) {
+    return code_writer_dump_human_fixed(&this->code_writer, &code.code,
+                                        decimals);
+  }
+};
+
+class CodeIndex {
+public:
+  code_index_t code_index;
+
+  CodeIndex() : code_index({0}) {}
+  CodeIndex(CodeIndex &&other) : code_index(other.code_index) {
+    other.code_index = code_index_t();
+  }
+  CodeIndex(CodeIndex &other) = delete;
+
+  ~CodeIndex() { free_code_index(&this->code_index); }
+
+  int build(CodeFile &file, uint64_t interval = 0,
+            const char *marker = nullptr) {
+    free_code_index(&this->code_index);
+    return code_index_build(&this->code_index, &file.code_file, interval,
+                            marker);
+  }
+  int save(const char *path) const {
+    return code_index_save(&this->code_index, path);
+  }
+  int load(const char *path) {
+    free_code_index(&this->code_index);
+    return code_index_load(&this->code_index, path);
+  }
+  const code_marker_t *marker(int64_t value) const {
+    return code_index_marker(&this->code_index, value);
+  }
+};
+
+class CodeArchive {
+public:
+  code_archive_t code_archive;
+
+  CodeArchive() : code_archive({}) {}
+  CodeArchive(const char *path) : code_archive({}) {
+    init_code_archive(&this->code_archive, path);
+  }
+  CodeArchive(CodeArchive &&other) : code_archive(other.code_archive) {
+    other.code_archive = code_archive_t();
+  }
+  CodeArchive(CodeArchive &other) = delete;
+
+  ~CodeArchive() { free_code_archive(&this->code_archive); }
+
+  bool is_open() const { return this->code_archive.file.buf != nullptr; }
+
+  int pop(code_t *code) { return code_archive_pop(&this->code_archive, code); }
+  int pop_view(code_view_t *code) {
+    return code_archive_pop_view(&this->code_archive, code);
+  }
+
+  static int pack(const char *path, const char *archive_path,
+                  size_t block_size = 0) {
+    return code_archive_pack(path, archive_path, block_size);
+  }
+  static int pack(const char *path, const char *archive_path,
+                  size_t block_size, uint8_t checksum) {
+    return code_archive_pack_checksum(path, archive_path, block_size,
+                                      checksum);
+  }
+};
+
+#endif
+#endif
@@ -1,6 +1,13 @@
 #include <munit.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <float.h>
+#include <math.h>
+#include <unistd.h>
+
 #include <scode.h>
+#include <scode_file.h>
 
 #define TEST(name)                                                             \
   static MunitResult name(const MunitParameter params[], void *data)
@@ -144,6 +151,144 @@ TEST(test_param_dump_human) {
   return MUNIT_OK;
 }
 
+TEST(test_param_dump_human_float) {
+  char buf[1024];
+  int result;
+  param_t param;
+
+  param = init_param_f64('X', 0.1);
+  result = param_dump_human(&param, buf, sizeof(buf));
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X0.1");
+
+  param = init_param_f32('X', 0.3f);
+  result = param_dump_human(&param, buf, sizeof(buf));
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X0.3");
+
+  param = init_param_f32('X', 1.5e9f);
+  result = param_dump_human(&param, buf, sizeof(buf));
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X1500000000.0");
+
+  param = init_param_f64('X', 0.00012);
+  result = param_dump_human(&param, buf, sizeof(buf));
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X0.00012");
+
+  param = init_param_f64('X', -0.0);
+  result = param_dump_human(&param, buf, sizeof(buf));
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X-0.0");
+
+  param = init_param_f64('X', NAN);
+  munit_assert_int(param_dump_human(&param, buf, sizeof(buf)), ==,
+                   SCODE_ERROR_DUMP);
+
+  param = init_param_f64('X', 1e-5);
+  munit_assert_int(param_dump_human(&param, buf, 7), ==, SCODE_ERROR_BUFFER);
+  munit_assert_int(param_dump_human(&param, buf, 8), ==, 8);
+
+  param = init_param_i64('N', INT64_MIN);
+  result = param_dump_human(&param, buf, sizeof(buf));
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "N-9223372036854775808");
+
+  // These are stored as 1.00499... and 2.67499..., so they round down
+  param = init_param_f64('X', 1.005);
+  result = param_dump_human_fixed(&param, buf, sizeof(buf), 2);
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X1.00");
+
+  param = init_param_f64('X', 2.675);
+  result = param_dump_human_fixed(&param, buf, sizeof(buf), 2);
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X2.67");
+
+  param = init_param_f32('X', 99.996f);
+  result = param_dump_human_fixed(&param, buf, sizeof(buf), 2);
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X100.00");
+
+  param = init_param_f32('X', 0.004f);
+  result = param_dump_human_fixed(&param, buf, sizeof(buf), 2);
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X0.00");
+
+  param = init_param_f32('X', 12.5f);
+  result = param_dump_human_fixed(&param, buf, sizeof(buf), 0);
+  buf[result] = '\0';
+  munit_assert_string_equal(buf, "X13.0");
+
+  // Fixed decimals are rounded from the exact value, like printf does. Ties
+  // are too rare in these values to matter.
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t bits = ((uint64_t)munit_rand_uint32() << 32) | munit_rand_uint32();
+    double value = ldexp((double)(bits >> 11), -40 - (int)(bits & 0x1F));
+    int decimals = 1 + munit_rand_uint32() % 8;
+    char expected[64];
+    snprintf(expected, sizeof(expected), "X%.*f", decimals, value);
+    param = init_param_f64('X', value);
+    result = param_dump_human_fixed(&param, buf, sizeof(buf), decimals);
+    buf[result] = '\0';
+    munit_assert_string_equal(buf, expected);
+
+    // Tiny values with many decimals
+    value = ldexp(value, -70);
+    decimals += 20;
+    snprintf(expected, sizeof(expected), "X%.*f", decimals, value);
+    param = init_param_f64('X', value);
+    result = param_dump_human_fixed(&param, buf, sizeof(buf), decimals);
+    buf[result] = '\0';
+    munit_assert_string_equal(buf, expected);
+  }
+
+  // Values with a few decimals are written back the way they were read
+  for (int i = 0; i < 100000; ++i) {
+    char text[64];
+    int decimals = 1 + munit_rand_uint32() % 5;
+    int whole = munit_rand_uint32() % 10000;
+    int len = snprintf(text, sizeof(text), "X%d.%.*s", whole, decimals,
+                       "00000");
+    for (int d = 0; d < decimals; ++d) {
+      text[len - decimals + d] = '0' + munit_rand_uint32() % 10;
+    }
+    while (text[len - 1] == '0' && text[len - 2] != '.') {
+      text[--len] = '\0';
+    }
+    munit_assert_int(param_parse_human(&param, text, len), ==, len);
+    result = param_dump_human(&param, buf, sizeof(buf));
+    buf[result] = '\0';
+    munit_assert_string_equal(buf, text);
+  }
+
+  // Every value must read back exactly
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t bits = ((uint64_t)munit_rand_uint32() << 32) | munit_rand_uint32();
+    double f64;
+    memcpy(&f64, &bits, sizeof(f64));
+    float f32;
+    memcpy(&f32, &bits, sizeof(f32));
+
+    if (isfinite(f64)) {
+      param = init_param_f64('X', f64);
+      result = param_dump_human(&param, buf, sizeof(buf));
+      munit_assert_int(result, >, 0);
+      buf[result] = '\0';
+      munit_assert_double(strtod(buf + 1, NULL), ==, f64);
+    }
+    if (isfinite(f32)) {
+      param = init_param_f32('X', f32);
+      result = param_dump_human(&param, buf, sizeof(buf));
+      munit_assert_int(result, >, 0);
+      buf[result] = '\0';
+      munit_assert_float(strtof(buf + 1, NULL), ==, f32);
+    }
+  }
+
+  return MUNIT_OK;
+}
+
 TEST(test_param_parse_human) {
   char *buffer;
   param_t param;
@@ -240,11 +385,60 @@ TEST(test_param_parse_human) {
   munit_assert_float(param.f32, ==, 0);
   free_param(&param);
 
+  buffer = "D-2.5";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, 5);
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F32);
+  munit_assert_float(param.f32, ==, -2.5);
+  free_param(&param);
+
+  buffer = "D0.12345678901234";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, 17);
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+  munit_assert_double(param.f64, ==, 0.12345678901234);
+  free_param(&param);
+
+  buffer = "D1.50000000000000000000000000";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, strlen(buffer));
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F32);
+  munit_assert_float(param.f32, ==, 1.5);
+  free_param(&param);
+
+  buffer = "D1.00000000000000000000000001";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, strlen(buffer));
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+  munit_assert_double(param.f64, ==, 1.0);
+  free_param(&param);
+
+  buffer = "D123456789012345678901234.5";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, strlen(buffer));
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+  munit_assert_double(param.f64, ==, 123456789012345678901234.5);
+  free_param(&param);
+
+  buffer = "D0.0000000000000000000000001";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, strlen(buffer));
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+  munit_assert_double(param.f64, ==, 1e-25);
+  free_param(&param);
+
+  buffer = "D99999999999999999999";
+  result = param_parse_human(&param, buffer, strlen(buffer));
+  munit_assert_int(result, ==, 21);
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_I64);
+  munit_assert_int64(param.i64, ==, INT64_MAX);
+  free_param(&param);
+
   buffer = "D'hello world'";
   result = param_parse_human(&param, buffer, strlen(buffer));
   munit_assert_int(result, ==, 14);
   munit_assert_uint8(param_type(&param), ==, PARAM_T_STR);
-  munit_assert_string_equal(param.str, "hello world");
+  munit_assert_string_equal(param_str(&param), "hello world");
   free_param(&param);
 
   buffer = "D'hello world";
@@ -257,7 +451,7 @@ TEST(test_param_parse_human) {
   result = param_parse_human(&param, buffer, strlen(buffer));
   munit_assert_int(result, ==, 14);
   munit_assert_uint8(param_type(&param), ==, PARAM_T_STR);
-  munit_assert_string_equal(param.str, "hello world");
+  munit_assert_string_equal(param_str(&param), "hello world");
   free_param(&param);
 
   buffer = "D";
@@ -268,6 +462,116 @@ TEST(test_param_parse_human) {
   return MUNIT_OK;
 }
 
+TEST(test_param_parse_rounding) {
+  // Every float must be the correctly rounded value of its text
+  char buffer[64];
+  param_t param;
+
+  for (int i = 0; i < 100000; ++i) {
+    uint32_t whole = munit_rand_uint32() % 100000;
+    int decimals = 1 + munit_rand_uint32() % 12;
+    int len = snprintf(buffer, sizeof(buffer), "X%s%u.%.*s", i % 2 ? "-" : "",
+                       whole, decimals, "000000000000");
+    for (int d = 0; d < decimals; ++d) {
+      buffer[len - decimals + d] = '0' + munit_rand_uint32() % 10;
+    }
+    munit_assert_int(param_parse_human(&param, buffer, len), ==, len);
+    if (param_type(&param) == PARAM_T_F32) {
+      munit_assert_float(param.f32, ==, strtof(buffer + 1, NULL));
+    } else {
+      munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+      munit_assert_double(param.f64, ==, strtod(buffer + 1, NULL));
+    }
+  }
+  return MUNIT_OK;
+}
+
+TEST(test_param_parse_long) {
+  char buffer[256];
+  param_t param;
+
+  // Just above a halfway point, with the digit that decides it far beyond the
+  // ones that are kept
+  int len = snprintf(buffer, sizeof(buffer),
+                     "X622902.0719880071119405329227447509765625%s1",
+                     "000000000000000000000000000000");
+  munit_assert_int(param_parse_human(&param, buffer, len), ==, len);
+  munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+  munit_assert_double(param.f64, ==, 0x1.3026c24db9cb1p+19);
+
+#if LDBL_MANT_DIG > DBL_MANT_DIG
+  // Halfway points between doubles, exactly and a little above and below
+  for (int i = 0; i < 2000; ++i) {
+    double d = (munit_rand_uint32() % 100000) + munit_rand_double();
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    bits++;
+    double next;
+    memcpy(&next, &bits, sizeof(next));
+    long double half = ((long double)d + next) / 2;
+    len = snprintf(buffer, sizeof(buffer), "X%.80Lf", half);
+    while (buffer[len - 1] == '0') {
+      len--;
+    }
+    if (i % 3 == 1) {
+      len += snprintf(buffer + len, sizeof(buffer) - len, "%s1",
+                      "0000000000000000000000000000000000000000");
+    } else if (i % 3 == 2) {
+      // Lower the last digit and pad it with nines
+      buffer[len - 1]--;
+      len += snprintf(buffer + len, sizeof(buffer) - len, "%s",
+                      "9999999999999999999999999999999999999999");
+    }
+    munit_assert_int(param_parse_human(&param, buffer, len), ==, len);
+    munit_assert_uint8(param_type(&param), ==, PARAM_T_F64);
+    munit_assert_double(param.f64, ==, strtod(buffer + 1, NULL));
+  }
+#endif
+  return MUNIT_OK;
+}
+
+TEST(test_param_str_inline) {
+  const char *strings[] = {"", "a", "a.gc", "1234567", "12345678",
+                           "a much longer string"};
+  char buf[64];
+  for (size_t i = 0; i < sizeof(strings) / sizeof(strings[0]); ++i) {
+    size_t length = strlen(strings[i]);
+    int is_inline = length <= PARAM_SSO_LEN;
+    param_t param = init_param_str('F', strings[i]);
+    munit_assert_int((param.flags & PARAM_FLAG_INLINE) != 0, ==, is_inline);
+    munit_assert_string_equal(param_str(&param), strings[i]);
+
+    // Every way of making a string param stores it the same way
+    param_t parsed;
+    int res = param_dump_binary(&param, buf, sizeof(buf));
+    munit_assert_int(param_parse_binary(&parsed, buf, res), ==, res);
+    munit_assert_int((parsed.flags & PARAM_FLAG_INLINE) != 0, ==, is_inline);
+    munit_assert_string_equal(param_str(&parsed), strings[i]);
+    free_param(&parsed);
+
+    res = param_dump_human(&param, buf, sizeof(buf));
+    munit_assert_int(param_parse_human(&parsed, buf, res), ==, res);
+    munit_assert_int((parsed.flags & PARAM_FLAG_INLINE) != 0, ==, is_inline);
+    munit_assert_string_equal(param_str(&parsed), strings[i]);
+    free_param(&parsed);
+    free_param(&param);
+    munit_assert_uint8(param.flags, ==, 0);
+  }
+
+  param_t param = init_param_i32('X', 3);
+  munit_assert_ptr_null(param_str(&param));
+
+  // Params are copied by value, including inline strings
+  code_t code = init_code('M', 23, 1);
+  code.params[0] = init_param_str('F', "a.gc");
+  munit_assert_int(code_dump_binary(&code, buf, sizeof(buf)), ==, 10);
+  free_code(&code);
+  munit_assert_int(code_parse(&code, buf, 10), ==, 10);
+  munit_assert_string_equal(param_str(&code.params[0]), "a.gc");
+  free_code(&code);
+  return MUNIT_OK;
+}
+
 TEST(test_param_parse_binary) {
   char *buffer;
   param_t param;
@@ -305,21 +609,21 @@ TEST(test_param_parse_binary) {
   result = param_parse_binary(&param, buffer, 13);
   munit_assert_int(result, ==, 13);
   munit_assert_uint8(param_type(&param), ==, PARAM_T_STR);
-  munit_assert_string_equal(param.str, "Hello World");
+  munit_assert_string_equal(param_str(&param), "Hello World");
   free_param(&param);
 
   buffer = "\xF4won't you join us?\0";
   result = param_parse_binary(&param, buffer, 20);
   munit_assert_int(result, ==, 20);
   munit_assert_uint8(param_type(&param), ==, PARAM_T_STR);
-  munit_assert_string_equal(param.str, "won't you join us?");
+  munit_assert_string_equal(param_str(&param), "won't you join us?");
   free_param(&param);
 
   buffer = "\xF4\"oops'\0";
   result = param_parse_binary(&param, buffer, 8);
   munit_assert_int(result, ==, 8);
   munit_assert_uint8(param_type(&param), ==, PARAM_T_STR);
-  munit_assert_string_equal(param.str, "\"oops'");
+  munit_assert_string_equal(param_str(&param), "\"oops'");
   free_param(&param);
 
   return MUNIT_OK;
@@ -369,6 +673,388 @@ TEST(test_code_dump_binary) {
   return MUNIT_OK;
 }
 
+TEST(test_code_dump_size) {
+  char buf[4096];
+  char *heap;
+  char long_str[300];
+  memset(long_str, 'x', sizeof(long_str) - 1);
+  long_str[sizeof(long_str) - 1] = '\0';
+  param_t values[] = {
+      init_param_u8('A', 0),          init_param_u8('B', 255),
+      init_param_i8('C', -128),       init_param_i16('D', -10000),
+      init_param_i32('E', 99),        init_param_i32('F', 100),
+      init_param_i64('H', INT64_MIN), init_param_i64('I', INT64_MAX),
+      init_param_f32('J', 0.1f),      init_param_f32('K', -0.0f),
+      init_param_f64('L', 1e300),     init_param_f64('M', -5e-324),
+      init_param_f64('N', 0.95),      init_param_f64('O', 99.999),
+      init_param_f32('P', 3e-7f),     init_param_str('Q', ""),
+      init_param_str('R', "it's"),    init_param_str('S', long_str),
+  };
+  size_t num_values = sizeof(values) / sizeof(values[0]);
+
+  for (size_t i = 0; i < num_values; ++i) {
+    int size = param_dump_binary_size(&values[i]);
+    munit_assert_int(size, ==, param_dump_binary(&values[i], buf, sizeof(buf)));
+    size = param_dump_human_size(&values[i]);
+    munit_assert_int(size, ==, param_dump_human(&values[i], buf, sizeof(buf)));
+    for (uint8_t d = 0; d < 12; d += 3) {
+      size = param_dump_human_fixed_size(&values[i], d);
+      munit_assert_int(size, ==,
+                       param_dump_human_fixed(&values[i], buf, sizeof(buf), d));
+    }
+  }
+
+  code_t code = init_code('G', 123, num_values);
+  memcpy(code.params, values, sizeof(values));
+  int size = code_dump_binary_size(&code);
+  munit_assert_int(code_dump_binary(&code, buf, size), ==, size);
+  munit_assert_int(code_dump_binary(&code, buf, size - 1), ==,
+                   SCODE_ERROR_BUFFER);
+  size = code_dump_human_size(&code);
+  munit_assert_int(code_dump_human(&code, buf, size), ==, size);
+  munit_assert_int(code_dump_human(&code, buf, size - 1), ==,
+                   SCODE_ERROR_BUFFER);
+  size = code_dump_human_fixed_size(&code, 2);
+  munit_assert_int(code_dump_human_fixed(&code, buf, size, 2), ==, size);
+
+  // The alloc variants give the same bytes
+  size = code_dump_human(&code, buf, sizeof(buf));
+  munit_assert_int(code_dump_human_alloc(&code, &heap), ==, size);
+  munit_assert_string_equal(heap, buf);
+  free(heap);
+  size = code_dump_binary(&code, buf, sizeof(buf));
+  munit_assert_int(code_dump_binary_alloc(&code, &heap), ==, size);
+  munit_assert_memory_equal(size, heap, buf);
+  free(heap);
+  size = code_dump_human_fixed(&code, buf, sizeof(buf), 1);
+  munit_assert_int(code_dump_human_fixed_alloc(&code, &heap, 1), ==, size);
+  munit_assert_string_equal(heap, buf);
+  free(heap);
+  free_code(&code);
+
+  // Errors are the same as dumping
+  code = init_code('M', 117, 1);
+  code.params[0] = init_param_str('S', "\"both'");
+  munit_assert_int(code_dump_human_size(&code), ==, SCODE_ERROR_DUMP);
+  munit_assert_int(code_dump_human_alloc(&code, &heap), ==, SCODE_ERROR_DUMP);
+  munit_assert_ptr_null(heap);
+  free_code(&code);
+  code = init_code('G', 1, 1);
+  code.params[0] = init_param_f64('X', NAN);
+  munit_assert_int(code_dump_human_size(&code), ==, SCODE_ERROR_DUMP);
+  munit_assert_int(code_dump_binary_size(&code), ==, 13);
+  free_code(&code);
+
+  return MUNIT_OK;
+}
+
+TEST(test_code_dump_binary_batch) {
+  char buf[256];
+  char single[64];
+  size_t offsets[3];
+  code_t codes[3];
+  codes[0] = init_code('G', 28, 0);
+  codes[1] = init_code('G', 1, 2);
+  codes[1].params[0] = init_param_f32('X', 1.5f);
+  codes[1].params[1] = init_param_i16('F', 3000);
+  codes[2] = init_code('M', 117, 1);
+  codes[2].params[0] = init_param_str('S', "batch of codes");
+
+  int size = code_dump_binary_batch(codes, 3, buf, sizeof(buf), offsets);
+  munit_assert_int(size, >, 0);
+  size_t pos = 0;
+  for (int i = 0; i < 3; ++i) {
+    int len = code_dump_binary(&codes[i], single, sizeof(single));
+    munit_assert_size(offsets[i], ==, pos);
+    munit_assert_memory_equal(len, buf + pos, single);
+    pos += len;
+  }
+  munit_assert_int(size, ==, pos);
+
+  code_t code;
+  munit_assert_int(code_parse(&code, buf + offsets[1], size - offsets[1]), ==,
+                   offsets[2] - offsets[1]);
+  munit_assert_float(param_cast_f32(code_get_param(&code, 'X')), ==, 1.5f);
+  free_code(&code);
+
+  // Only whole codes are written when the batch doesn't fit
+  memset(buf, 0, sizeof(buf));
+  munit_assert_int(code_dump_binary_batch(codes, 3, buf, size - 1, NULL), ==,
+                   SCODE_ERROR_BUFFER);
+  munit_assert_uint8(buf[0], ==, 0xC7);
+  munit_assert_uint8(buf[offsets[2]], ==, 0);
+  munit_assert_int(code_dump_binary_batch(codes, 0, buf, 0, NULL), ==, 0);
+
+  for (int i = 0; i < 3; ++i) {
+    free_code(&codes[i]);
+  }
+  return MUNIT_OK;
+}
+
+TEST(test_code_dump_binary_narrow) {
+  char buf[256];
+  code_t code = init_code('G', 1, 8);
+  code.params[0] = init_param_f64('X', 1.5);
+  code.params[1] = init_param_f64('Y', 0.1);
+  code.params[2] = init_param_i64('Z', 5);
+  code.params[3] = init_param_i64('E', -300);
+  code.params[4] = init_param_i32('F', 100000);
+  code.params[5] = init_param_i64('I', 1000000000000);
+  code.params[6] = init_param_f32('J', 0.25f);
+  code.params[7] = init_param_str('S', "text");
+  uint8_t types[] = {PARAM_T_F32, PARAM_T_F64, PARAM_T_U8,  PARAM_T_I16,
+                     PARAM_T_I32, PARAM_T_I64, PARAM_T_F32, PARAM_T_STR};
+
+  int size = code_dump_binary_narrow_size(&code);
+  munit_assert_int(size, <, code_dump_binary_size(&code));
+  munit_assert_int(code_dump_binary_narrow(&code, buf, size - 1), ==,
+                   SCODE_ERROR_BUFFER);
+  munit_assert_int(code_dump_binary_narrow(&code, buf, sizeof(buf)), ==, size);
+
+  code_t parsed;
+  munit_assert_int(code_parse(&parsed, buf, size), ==, size);
+  munit_assert_size(parsed.num_params, ==, 8);
+  for (int i = 0; i < 8; ++i) {
+    munit_assert_uint8(param_type(&parsed.params[i]), ==, types[i]);
+    if (types[i] == PARAM_T_STR) {
+      munit_assert_string_equal(param_str(&parsed.params[i]), "text");
+    } else {
+      munit_assert_double(param_cast_f64(&parsed.params[i]), ==,
+                          param_cast_f64(&code.params[i]));
+      munit_assert_int64(param_cast_i64(&parsed.params[i]), ==,
+                         param_cast_i64(&code.params[i]));
+    }
+  }
+  free_code(&parsed);
+
+  // Without narrowing the types are kept
+  size = code_dump_binary(&code, buf, sizeof(buf));
+  code_parse(&parsed, buf, size);
+  munit_assert_uint8(param_type(&parsed.params[0]), ==, PARAM_T_F64);
+  munit_assert_uint8(param_type(&parsed.params[2]), ==, PARAM_T_I64);
+  free_code(&parsed);
+  free_code(&code);
+  return MUNIT_OK;
+}
+
+TEST(test_code_dump_binary_quant) {
+  char buf[256];
+  scode_quant_t profile = {0};
+  scode_quant_set(&profile, 'X', 1000, PARAM_T_I16);
+  scode_quant_set(&profile, 'Y', 1000, PARAM_T_I16);
+  scode_quant_set(&profile, 'E', 100000, PARAM_T_I32);
+  scode_quant_set(&profile, 'Z', 100, PARAM_T_I32);
+
+  code_t code = init_code('G', 1, 6);
+  code.params[0] = init_param_f32('X', 12.3456f);
+  code.params[1] = init_param_f64('Y', 100.0); // too big for an I16
+  code.params[2] = init_param_f64('E', -0.00123);
+  code.params[3] = init_param_i64('Z', 3);
+  code.params[4] = init_param_f64('F', 1500.0);
+  code.params[5] = init_param_str('S', "text");
+  uint8_t sent[] = {PARAM_T_I16, PARAM_T_F32, PARAM_T_I32,
+                    PARAM_T_I32, PARAM_T_F32, PARAM_T_STR};
+
+  int size = code_dump_binary_quant_size(&code, &profile);
+  munit_assert_int(size, <, code_dump_binary_narrow_size(&code));
+  munit_assert_int(code_dump_binary_quant(&code, buf, size - 1, &profile), ==,
+                   SCODE_ERROR_BUFFER);
+  munit_assert_int(code_dump_binary_quant(&code, buf, sizeof(buf), &profile),
+                   ==, size);
+
+  code_t parsed;
+  munit_assert_int(code_parse(&parsed, buf, size), ==, size);
+  for (int i = 0; i < 6; ++i) {
+    munit_assert_uint8(param_type(&parsed.params[i]), ==, sent[i]);
+  }
+  munit_assert_int16(parsed.params[0].i16, ==, 12346);
+
+  code_dequantize(&parsed, &profile);
+  uint8_t types[] = {PARAM_T_F32, PARAM_T_F32, PARAM_T_F32,
+                     PARAM_T_F32, PARAM_T_F32, PARAM_T_STR};
+  for (int i = 0; i < 6; ++i) {
+    munit_assert_uint8(param_type(&parsed.params[i]), ==, types[i]);
+  }
+  // Each value is within half a step of what was sent
+  munit_assert_double_equal(param_cast_f64(&parsed.params[0]), 12.3456, 3);
+  munit_assert_double(param_cast_f64(&parsed.params[1]), ==, 100.0);
+  munit_assert_double_equal(param_cast_f64(&parsed.params[2]), -0.00123, 5);
+  munit_assert_double(param_cast_f64(&parsed.params[3]), ==, 3.0);
+  munit_assert_int(param_cast_i64(&parsed.params[4]), ==, 1500);
+  munit_assert_string_equal(param_str(&parsed.params[5]), "text");
+  free_code(&parsed);
+
+  // Human codes are never dequantized
+  size = code_dump_human(&code, buf, sizeof(buf));
+  code_parse(&parsed, buf, size);
+  code_dequantize(&parsed, &profile);
+  munit_assert_uint8(param_type(&parsed.params[3]), ==, PARAM_T_U8);
+  free_code(&parsed);
+
+  // A stream with the profile dequantizes both codes and views
+  size = code_dump_binary_quant(&code, buf, sizeof(buf), &profile);
+  code_stream_t stream = init_code_stream(0);
+  code_stream_set_quant(&stream, &profile);
+  code_stream_update(&stream, buf, size);
+  code_stream_update(&stream, buf, size);
+  munit_assert_int(code_stream_pop(&stream, &parsed), ==, 0);
+  munit_assert_uint8(param_type(&parsed.params[0]), ==, PARAM_T_F32);
+  munit_assert_double_equal(param_cast_f64(&parsed.params[0]), 12.3456, 3);
+  free_code(&parsed);
+  code_view_t view;
+  munit_assert_int(code_stream_pop_view(&stream, &view), ==, 0);
+  munit_assert_uint8(param_view_type(&view.params[2]), ==, PARAM_T_F32);
+  munit_assert_double_equal(param_view_cast_f64(&view.params[2]), -0.00123,
+                            5);
+  munit_assert_int(param_view_cast_i64(&view.params[4]), ==, 1500);
+  free_code_stream(&stream);
+  free_code(&code);
+
+  // Binary params can have a letter after 'Z', which no profile covers
+  for (char letter = 'A'; letter <= 'Z'; ++letter) {
+    scode_quant_set(&profile, letter, 1000, PARAM_T_I32);
+  }
+  char raw[] = {0xC7, 0x01, (PARAM_T_I8 << 5) | 27, 0x05, 0x00, 0x00};
+  raw[5] = crc_calc(raw, 4, 0);
+  munit_assert_int(code_parse(&parsed, raw, sizeof(raw)), ==, sizeof(raw));
+  code_dequantize(&parsed, &profile);
+  munit_assert_uint8(param_type(&parsed.params[0]), ==, PARAM_T_I8);
+  size = code_dump_binary_quant(&parsed, buf, sizeof(buf), &profile);
+  munit_assert_int(size, ==, sizeof(raw));
+  munit_assert_uint8(buf[2] & 0b00011111, ==, 27);
+  munit_assert_uint8(buf[3], ==, 5);
+  free_code(&parsed);
+  return MUNIT_OK;
+}
+
+// Check that a rebuilt code has the same values as the code that was sent
+static void assert_same_code(const code_t *code, const code_t *expected) {
+  munit_assert_uint8(code->category, ==, expected->category);
+  munit_assert_uint8(code->number, ==, expected->number);
+  munit_assert_size(code->num_params, ==, expected->num_params);
+  for (size_t i = 0; i < expected->num_params; ++i) {
+    const param_t *want = &expected->params[i];
+    param_t *got = code_get_param(code, param_letter(want));
+    munit_assert_ptr_not_null(got);
+    if (param_type(want) == PARAM_T_STR) {
+      munit_assert_string_equal(param_str(got), param_str(want));
+    } else {
+      munit_assert_double(param_cast_f64(got), ==, param_cast_f64(want));
+    }
+  }
+}
+
+TEST(test_code_dump_binary_delta) {
+  char buf[256];
+  code_delta_t sender = init_code_delta();
+  code_delta_t receiver = init_code_delta();
+  code_stream_t stream = init_code_stream(0);
+  code_stream_set_delta(&stream, &receiver);
+
+  code_t codes[4];
+  codes[0] = init_code('G', 1, 4);
+  codes[0].params[0] = init_param_f32('X', 10.5f);
+  codes[0].params[1] = init_param_i32('Y', 20000);
+  codes[0].params[2] = init_param_i32('F', 1800);
+  codes[0].params[3] = init_param_str('S', "text");
+  // F is dropped and Y is sent as a difference
+  codes[1] = init_code('G', 1, 3);
+  codes[1].params[0] = init_param_f32('X', 11.5f);
+  codes[1].params[1] = init_param_i32('Y', 20010);
+  codes[1].params[2] = init_param_i32('F', 1800);
+  // Only repeated params
+  codes[2] = init_code('G', 0, 2);
+  codes[2].params[0] = init_param_i32('F', 1800);
+  codes[2].params[1] = init_param_f32('X', 11.5f);
+  codes[3] = init_code('M', 104, 1);
+  codes[3].params[0] = init_param_i32('S', 200);
+
+  int sizes[4];
+  size_t total = 0;
+  for (int i = 0; i < 4; ++i) {
+    sizes[i] = code_dump_binary_delta(&codes[i], buf + total,
+                                      sizeof(buf) - total, &sender, NULL);
+    munit_assert_int(sizes[i], >, 0);
+    total += sizes[i];
+  }
+  munit_assert_int(sizes[0], ==, code_dump_binary_narrow_size(&codes[0]));
+  munit_assert_int(sizes[1], <, code_dump_binary_narrow_size(&codes[1]));
+  munit_assert_int(sizes[2], <, code_dump_binary_narrow_size(&codes[2]));
+
+  code_stream_update(&stream, buf, total);
+  code_t code;
+  munit_assert_int(code_stream_pop(&stream, &code), ==, 0);
+  assert_same_code(&code, &codes[0]);
+  free_code(&code);
+  munit_assert_int(code_stream_pop_into(&stream, &code), ==, 0);
+  assert_same_code(&code, &codes[1]);
+  munit_assert_int(code_stream_pop_into(&stream, &code), ==, 0);
+  assert_same_code(&code, &codes[2]);
+  free_code(&code);
+  code_view_t view;
+  munit_assert_int(code_stream_pop_view(&stream, &view), ==, 0);
+  munit_assert_size(view.num_params, ==, 1);
+  munit_assert_int(param_view_cast_i64(&view.params[0]), ==, 200);
+
+  // A code that doesn't fit leaves the state alone
+  code_delta_t before = sender;
+  munit_assert_int(code_dump_binary_delta(&codes[1], buf, 4, &sender, NULL),
+                   ==, SCODE_ERROR_BUFFER);
+  munit_assert_memory_equal(sizeof(before), &before, &sender);
+
+  // A lost code makes the codes that depend on it fail until both ends reset
+  total = code_dump_binary_delta(&codes[0], buf, sizeof(buf), &sender, NULL);
+  buf[total - 1] ^= 1;
+  size_t next = code_dump_binary_delta(&codes[1], buf + total,
+                                       sizeof(buf) - total, &sender, NULL);
+  code_stream_update(&stream, buf, total + next);
+  munit_assert_int(code_stream_pop(&stream, &code), ==, SCODE_ERROR_CRC);
+  munit_assert_int(code_stream_pop(&stream, &code), ==, SCODE_ERROR_PARSE);
+  code_delta_reset(&sender);
+  total = code_dump_binary_delta(&codes[1], buf, sizeof(buf), &sender, NULL);
+  code_stream_update(&stream, buf, total);
+  munit_assert_int(code_stream_pop(&stream, &code), ==, 0);
+  assert_same_code(&code, &codes[1]);
+  free_code(&code);
+
+  // Quantized params are sent as differences and dequantized after
+  scode_quant_t profile = {0};
+  scode_quant_set(&profile, 'X', 1000, PARAM_T_I32);
+  code_stream_set_quant(&stream, &profile);
+  code_delta_reset(&sender);
+  code_delta_reset(&receiver);
+  total = code_dump_binary_delta(&codes[0], buf, sizeof(buf), &sender,
+                                 &profile);
+  next = code_dump_binary_delta(&codes[1], buf + total, sizeof(buf) - total,
+                                &sender, &profile);
+  munit_assert_int(next, <, code_dump_binary_quant_size(&codes[1], &profile));
+  code_stream_update(&stream, buf, total + next);
+  munit_assert_int(code_stream_pop(&stream, &code), ==, 0);
+  free_code(&code);
+  munit_assert_int(code_stream_pop(&stream, &code), ==, 0);
+  assert_same_code(&code, &codes[1]);
+  munit_assert_uint8(param_type(code_get_param(&code, 'X')), ==, PARAM_T_F32);
+  free_code(&code);
+
+  // Binary params with a letter after 'Z' have no last value
+  char raw[] = {0xC7, 0x01, (PARAM_T_I8 << 5) | 27, 0x05, 0x00, 0x00};
+  raw[5] = crc_calc(raw, 4, 0);
+  munit_assert_int(code_parse(&code, raw, sizeof(raw)), ==, sizeof(raw));
+  code_delta_reset(&sender);
+  before = sender;
+  munit_assert_int(code_dump_binary_delta(&code, buf, sizeof(buf), &sender,
+                                          NULL),
+                   ==, sizeof(raw));
+  munit_assert_memory_equal(sizeof(before), &before, &sender);
+  free_code(&code);
+
+  free_code_stream(&stream);
+  for (int i = 0; i < 4; ++i) {
+    free_code(&codes[i]);
+  }
+  return MUNIT_OK;
+}
+
 TEST(test_code_parse_human) {
   char *buf;
   code_t code;
@@ -434,6 +1120,1454 @@ TEST(test_code_parse_binary) {
   return MUNIT_OK;
 }
 
+TEST(test_code_parse_view) {
+  const char *buf;
+  code_view_t code;
+  param_view_t views[4];
+  int result;
+
+  buf = "M117 X1.5 S'hello world' T\"it's\"\n";
+  result = code_parse_view(&code, views, 4, buf, strlen(buf));
+  munit_assert_int(result, ==, strlen(buf));
+  munit_assert_char(code_view_letter(&code), ==, 'M');
+  munit_assert_int(code_view_is_binary(&code), ==, 0);
+  munit_assert_uint8(code.number, ==, 117);
+  munit_assert_size(code.num_params, ==, 3);
+  munit_assert_char(param_view_letter(&code.params[0]), ==, 'X');
+  munit_assert_float(param_view_cast_f32(&code.params[0]), ==, 1.5);
+  munit_assert_uint8(param_view_type(&code.params[1]), ==, PARAM_T_STR);
+  munit_assert_ptr_equal(code.params[1].str, buf + 12);
+  munit_assert_size(code.params[1].len, ==, 11);
+  munit_assert_memory_equal(11, code.params[1].str, "hello world");
+  munit_assert_size(code.params[2].len, ==, 4);
+  munit_assert_memory_equal(4, code.params[2].str, "it's");
+
+  param_t copy = param_view_copy(&code.params[2]);
+  munit_assert_string_equal(param_str(&copy), "it's");
+  free_param(&copy);
+
+  result = code_parse_view(&code, views, 2, buf, strlen(buf));
+  munit_assert_int(result, ==, SCODE_ERROR_MEMORY);
+
+  buf = "\xD3\x02\xF4Hi\0\x8E\xD3\x04\x00\x9E";
+  code_t owned;
+  munit_assert_int(code_parse(&owned, buf, 11), ==, 11);
+  munit_assert_string_equal(param_str(&owned.params[0]), "Hi");
+  free_code(&owned);
+  result = code_parse_view(&code, views, 4, buf, 11);
+  munit_assert_int(result, ==, 11);
+  munit_assert_int(code_view_is_binary(&code), !=, 0);
+  munit_assert_size(code.num_params, ==, 2);
+  munit_assert_ptr_equal(code.params[0].str, buf + 3);
+  munit_assert_size(code.params[0].len, ==, 2);
+  munit_assert_int16(param_view_cast_i16(&code.params[1]), ==, 1235);
+
+  return MUNIT_OK;
+}
+
+TEST(test_code_get_param) {
+  const char *buf = "G1 X1 Y2 X3 E4\n";
+  code_t code;
+  munit_assert_int(code_parse(&code, buf, strlen(buf)), ==, strlen(buf));
+  munit_assert_size(code.num_params, ==, 4);
+  munit_assert_uint32(code.mask, ==,
+                      (1 << ('X' - 'A')) | (1 << ('Y' - 'A')) |
+                          (1 << ('E' - 'A')));
+  munit_assert_ptr_equal(code_get_param(&code, 'X'), &code.params[0]);
+  munit_assert_ptr_equal(code_get_param(&code, 'y'), &code.params[1]);
+  munit_assert_ptr_equal(code_get_param(&code, 'E'), &code.params[3]);
+  munit_assert_ptr_null(code_get_param(&code, 'Z'));
+  munit_assert_ptr_null(code_get_param(&code, '1'));
+  munit_assert_true(code_has_param(&code, 'Y'));
+  munit_assert_false(code_has_param(&code, 'F'));
+
+  // The binary form has the same table
+  char binary[64];
+  int len = code_dump_binary(&code, binary, sizeof(binary));
+  free_code(&code);
+  munit_assert_size(code.num_params, ==, 0);
+  munit_assert_ptr_null(code_get_param(&code, 'X'));
+  munit_assert_int(code_parse(&code, binary, len), ==, len);
+  munit_assert_int(param_cast_i32(code_get_param(&code, 'E')), ==, 4);
+  munit_assert_false(code_has_param(&code, 'Z'));
+  free_code(&code);
+
+  // Codes built by hand are searched until the table is updated
+  code = init_code('G', 1, 2);
+  code.params[0] = init_param_i32('F', 100);
+  code.params[1] = init_param_i32('Z', 5);
+  munit_assert_size(code.num_params, ==, 2);
+  munit_assert_ptr_equal(code_get_param(&code, 'Z'), &code.params[1]);
+  munit_assert_ptr_null(code_get_param(&code, 'X'));
+  code_update_lookup(&code);
+  munit_assert_uint8(code.flags & CODE_FLAG_LOOKUP, ==, CODE_FLAG_LOOKUP);
+  munit_assert_ptr_equal(code_get_param(&code, 'F'), &code.params[0]);
+  munit_assert_ptr_equal(code_get_param(&code, 'Z'), &code.params[1]);
+  free_code(&code);
+
+  code = init_code('M', 17, 0);
+  munit_assert_ptr_null(code_get_param(&code, 'X'));
+  code_update_lookup(&code);
+  munit_assert_false(code_has_param(&code, 'X'));
+  free_code(&code);
+  return MUNIT_OK;
+}
+
+TEST(test_code_inline_params) {
+  const char *buf = "G1 X1 Y2 E3 F1500\n";
+  code_t code, moved;
+  munit_assert_int(code_parse(&code, buf, strlen(buf)), ==, strlen(buf));
+#if SCODE_INLINE_PARAMS >= 4
+  munit_assert_uint8(code.flags & CODE_FLAG_INLINE, ==, CODE_FLAG_INLINE);
+  munit_assert_ptr_equal(code.params, code.inline_params);
+#endif
+  code_move(&moved, &code);
+  munit_assert_ptr_null(code.params);
+  munit_assert_size(code.num_params, ==, 0);
+#if SCODE_INLINE_PARAMS >= 4
+  munit_assert_ptr_equal(moved.params, moved.inline_params);
+#endif
+  munit_assert_int(param_cast_i32(code_get_param(&moved, 'F')), ==, 1500);
+  munit_assert_uint8(moved.params[4].param, ==, 0);
+  free_code(&moved);
+  free_code(&code);
+
+  // Codes with more params than fit use the heap
+  buf = "G1 A1 B2 C3 D4 E5 F6 H7 I8 J9 K10 L11 M12\n";
+  munit_assert_int(code_parse(&code, buf, strlen(buf)), ==, strlen(buf));
+  munit_assert_uint8(code.flags & CODE_FLAG_INLINE, ==, 0);
+  munit_assert_size(code.num_params, ==, 12);
+  munit_assert_int(param_cast_i32(code_get_param(&code, 'M')), ==, 12);
+  code_move(&moved, &code);
+  munit_assert_int(param_cast_i32(code_get_param(&moved, 'A')), ==, 1);
+  free_code(&moved);
+
+  munit_assert_int(init_code_into(&code, 'M', 117, 1), ==, 0);
+#if SCODE_INLINE_PARAMS >= 1
+  munit_assert_ptr_equal(code.params, code.inline_params);
+#endif
+  code.params[0] = init_param_str('S', "hello");
+  char out[64];
+  munit_assert_int(code_dump_human(&code, out, sizeof(out)), >, 0);
+  munit_assert_memory_equal(6, out, "M117 S");
+  free_code(&code);
+
+  // Copies get their own params and strings
+  buf = "M117 S\"a long message\" P1\n";
+  munit_assert_int(code_parse(&code, buf, strlen(buf)), ==, strlen(buf));
+  code_t copy;
+  munit_assert_int(code_copy(&copy, &code), ==, 0);
+#if SCODE_INLINE_PARAMS >= 2
+  munit_assert_ptr_equal(copy.params, copy.inline_params);
+#endif
+  munit_assert_ptr_not_equal(param_str(&copy.params[0]),
+                             param_str(&code.params[0]));
+  free_code(&code);
+  munit_assert_string_equal(param_str(code_get_param(&copy, 'S')),
+                            "a long message");
+  munit_assert_int(param_cast_i32(code_get_param(&copy, 'P')), ==, 1);
+  munit_assert_uint8(copy.params[2].param, ==, 0);
+  free_code(&copy);
+
+  munit_assert_int(init_code_into(&code, 'G', 28, 0), ==, 0);
+  munit_assert_ptr_null(code.params);
+  munit_assert_int(code_copy(&copy, &code), ==, 0);
+  munit_assert_ptr_null(copy.params);
+  free_code(&code);
+  return MUNIT_OK;
+}
+
+TEST(test_code_parse_arena) {
+  const char *buf = "M117 X1.5 S'hello world'\n";
+  scode_arena_t arena = init_scode_arena(16);
+  code_t code;
+  int result;
+
+  for (int i = 0; i < 100; ++i) {
+    result = code_parse_arena(&code, buf, strlen(buf), &arena);
+    munit_assert_int(result, ==, strlen(buf));
+    munit_assert_uint8(code.flags & CODE_FLAG_ARENA, ==, CODE_FLAG_ARENA);
+    munit_assert_char(param_letter(&code.params[0]), ==, 'X');
+    munit_assert_float(param_cast_f32(&code.params[0]), ==, 1.5);
+    munit_assert_string_equal(param_str(&code.params[1]), "hello world");
+    munit_assert_uint8(code.params[2].param, ==, 0);
+  }
+  free_code(&code);
+  munit_assert_ptr_null(code.params);
+
+  // The grown arena should be merged into one block on reset
+  munit_assert_ptr_not_null(arena.head->next);
+  scode_arena_reset(&arena);
+  munit_assert_ptr_null(arena.head->next);
+  munit_assert_size(arena.used, ==, 0);
+  void *first = scode_arena_alloc(&arena, 3);
+  void *second = scode_arena_alloc(&arena, 8);
+  munit_assert_size((uintptr_t)second % 8, ==, 0);
+  munit_assert_ptr_not_equal(first, second);
+
+  code_stream_t stream = init_code_stream(64);
+  code_stream_update(&stream, "G1 X2 Y3\nM117 S'done'\n", 22);
+  munit_assert_int(code_stream_pop_arena(&stream, &code, &arena), ==, 0);
+  munit_assert_char(code_letter(&code), ==, 'G');
+  munit_assert_int(code_stream_pop_arena(&stream, &code, &arena), ==, 0);
+  munit_assert_string_equal(param_str(&code.params[0]), "done");
+  free_code_stream(&stream);
+
+  free_scode_arena(&arena);
+  munit_assert_ptr_null(arena.head);
+  return MUNIT_OK;
+}
+
+TEST(test_code_parse_next) {
+  char input[64] = "G1 X1\n\n; comment\nG1 X$\nM117 S'hi'\n";
+  size_t len = strlen(input);
+  code_t code = init_code('A', 1, 0);
+  len += code_dump_binary(&code, input + len, sizeof(input) - len);
+  free_code(&code);
+  input[len] = input[len - 4]; // start of a second frame
+  len++;
+  const char *buf = input;
+  size_t consumed;
+
+  munit_assert_int(code_parse_next(&code, buf, len, &consumed, NULL), ==, 0);
+  munit_assert_size(consumed, ==, 6);
+  munit_assert_float(param_cast_f32(&code.params[0]), ==, 1);
+  free_code(&code);
+  buf += consumed;
+  len -= consumed;
+
+  // Empty lines and comments are skipped
+  munit_assert_int(code_parse_next(&code, buf, len, &consumed, NULL), ==,
+                   SCODE_ERROR_PARSE);
+  munit_assert_size(consumed, ==, 17);
+  buf += consumed;
+  len -= consumed;
+
+  munit_assert_int(code_parse_next(&code, buf, len, &consumed, NULL), ==, 0);
+  munit_assert_string_equal(param_str(&code.params[0]), "hi");
+  free_code(&code);
+  buf += consumed;
+  len -= consumed;
+
+  munit_assert_int(code_parse_next(&code, buf, len, &consumed, NULL), ==, 0);
+  munit_assert_char(code_letter(&code), ==, 'A');
+  munit_assert_size(consumed, ==, 4);
+  free_code(&code);
+  buf += consumed;
+  len -= consumed;
+
+  // A truncated frame needs more data
+  munit_assert_int(code_parse_next(&code, buf, len, &consumed, NULL), ==,
+                   SCODE_ERROR_BUFFER);
+  munit_assert_size(consumed, ==, 0);
+  return MUNIT_OK;
+}
+
+static size_t make_codes(char *buf, size_t len, int trailing_newline,
+                         uint8_t checksum) {
+  char binary[64];
+  size_t pos = 0;
+  for (int i = 0; pos + 128 < len; ++i) {
+    if (i % 7 == 3) {
+      pos += sprintf(buf + pos, "G1 X$%d\n", i);
+    } else if (i % 5 == 1) {
+      code_t code = {.category = 'G', .number = 1};
+      param_t params[] = {init_param_f32('X', i * 0.5f),
+                          init_param_i32('E', i), {.param = 0}};
+      code.params = params;
+      int res =
+          code_dump_binary_checksum(&code, binary, sizeof(binary), checksum);
+      memcpy(buf + pos, binary, res);
+      pos += res;
+    } else {
+      pos += sprintf(buf + pos, "G1 X%d.5 E%d ; move %d\n", i, i, i);
+    }
+  }
+  pos += sprintf(buf + pos, "M117 S'end'");
+  if (trailing_newline) {
+    buf[pos++] = '\n';
+  }
+  return pos;
+}
+
+static void assert_same_codes(const code_t *a, const code_t *b) {
+  munit_assert_uint8(a->category, ==, b->category);
+  munit_assert_uint8(a->number, ==, b->number);
+  for (size_t i = 0;; ++i) {
+    munit_assert_uint8(a->params[i].param, ==, b->params[i].param);
+    if (a->params[i].param == 0) {
+      break;
+    }
+    if (param_type(&a->params[i]) == PARAM_T_STR) {
+      munit_assert_string_equal(param_str(&a->params[i]),
+                                param_str(&b->params[i]));
+    } else {
+      munit_assert_int64(param_cast_i64(&a->params[i]), ==,
+                         param_cast_i64(&b->params[i]));
+    }
+  }
+}
+
+static void assert_parse_parallel(const char *buf, size_t len,
+                                  size_t num_threads, uint8_t checksum) {
+  scode_codes_t codes;
+  munit_assert_int(
+      scode_parse_parallel_checksum(&codes, buf, len, num_threads, checksum),
+      ==, 0);
+
+  scode_arena_t arena = init_scode_arena(0);
+  size_t num_codes = 0, num_errors = 0, consumed;
+  code_t code;
+  while (len > 0) {
+    int res =
+        code_parse_next_checksum(&code, buf, len, &consumed, &arena, checksum);
+    if (res == SCODE_ERROR_BUFFER) {
+      break;
+    }
+    if (res == 0) {
+      munit_assert_size(num_codes, <, codes.num_codes);
+      assert_same_codes(&code, &codes.codes[num_codes++]);
+    } else {
+      num_errors++;
+    }
+    buf += consumed;
+    len -= consumed;
+  }
+  free_scode_arena(&arena);
+
+  // The last code has no line ending, so the loop above stops before it
+  munit_assert_size(codes.num_codes, >=, num_codes);
+  munit_assert_size(codes.num_codes, <=, num_codes + 1);
+  munit_assert_size(codes.num_errors, ==, num_errors);
+  code_t *last = &codes.codes[codes.num_codes - 1];
+  munit_assert_char(code_letter(last), ==, 'M');
+  munit_assert_string_equal(param_str(&last->params[0]), "end");
+  free_scode_codes(&codes);
+}
+
+TEST(test_code_parse_parallel) {
+  size_t cap = 1 << 20;
+  char *buf = malloc(cap);
+
+  for (int newline = 0; newline < 2; ++newline) {
+    size_t len = make_codes(buf, cap, newline, SCODE_CHECKSUM_CRC8);
+    for (size_t threads = 1; threads <= 4; ++threads) {
+      assert_parse_parallel(buf, len, threads, SCODE_CHECKSUM_CRC8);
+    }
+  }
+  scode_codes_t codes;
+
+  // Binary codes with a wider checksum, which chunks are also split after
+  size_t len = make_codes(buf, cap, 1, SCODE_CHECKSUM_CRC32C);
+  for (size_t threads = 1; threads <= 4; ++threads) {
+    assert_parse_parallel(buf, len, threads, SCODE_CHECKSUM_CRC32C);
+  }
+  munit_assert_int(scode_parse_parallel(&codes, buf, len, 4), ==, 0);
+  size_t num_errors = codes.num_errors;
+  free_scode_codes(&codes);
+  munit_assert_int(scode_parse_parallel_checksum(&codes, buf, len, 4,
+                                                 SCODE_CHECKSUM_CRC32C),
+                   ==, 0);
+  munit_assert_size(num_errors, >, codes.num_errors);
+  free_scode_codes(&codes);
+  code_t move = init_code('G', 1, 2);
+  size_t num_moves = 0;
+  for (len = 0; len + 64 < cap; ++num_moves) {
+    move.params[0] = init_param_f32('X', num_moves * 0.5f);
+    move.params[1] = init_param_i32('E', num_moves);
+    len += code_dump_binary_checksum(&move, buf + len, cap - len,
+                                     SCODE_CHECKSUM_CRC16);
+  }
+  free_code(&move);
+  munit_assert_int(scode_parse_parallel_checksum(&codes, buf, len, 4,
+                                                 SCODE_CHECKSUM_CRC16),
+                   ==, 0);
+  munit_assert_size(codes.num_errors, ==, 0);
+  for (size_t i = 0; i < codes.num_codes; ++i) {
+    munit_assert_int(param_cast_i32(&codes.codes[i].params[1]), ==, i);
+  }
+  munit_assert_size(codes.num_codes, ==, num_moves);
+  free_scode_codes(&codes);
+
+  len = make_codes(buf, cap, 1, SCODE_CHECKSUM_CRC8);
+
+  // Small buffers are parsed the same way
+  assert_parse_parallel(buf + len - 100, 100, 4, SCODE_CHECKSUM_CRC8);
+  munit_assert_int(scode_parse_parallel(&codes, buf, 0, 4), ==, 0);
+  munit_assert_size(codes.num_codes, ==, 0);
+  free_scode_codes(&codes);
+
+  char path[] = "/tmp/scode_test_XXXXXX";
+  int fd = mkstemp(path);
+  munit_assert_int(fd, >=, 0);
+  munit_assert_int(write(fd, buf, len), ==, len);
+  close(fd);
+  munit_assert_int(scode_parse_file_parallel(&codes, path, 3), ==, 0);
+  unlink(path);
+  munit_assert_size(codes.num_codes, >, 1000);
+  code_t *last = &codes.codes[codes.num_codes - 1];
+  munit_assert_string_equal(param_str(&last->params[0]), "end");
+  free_scode_codes(&codes);
+  munit_assert_int(scode_parse_file_parallel(&codes, path, 3), ==,
+                   SCODE_ERROR_FILE);
+
+  free(buf);
+  return MUNIT_OK;
+}
+
+static void write_file(const char *path, const char *buf, size_t len) {
+  FILE *file = fopen(path, "wb");
+  munit_assert_ptr_not_null(file);
+  munit_assert_size(fwrite(buf, 1, len, file), ==, len);
+  fclose(file);
+}
+
+TEST(test_code_file) {
+  char path[] = "/tmp/scode_test_XXXXXX";
+  close(mkstemp(path));
+  char buf[512] = "G1 X1 Y2\n\n; comment\nG1 X$\n";
+  size_t len = strlen(buf);
+  code_t code = init_code('G', 0, 0);
+  len += code_dump_binary(&code, buf + len, sizeof(buf) - len);
+  free_code(&code);
+  // More params than a view array starts with
+  len += sprintf(buf + len, "G1");
+  for (int i = 0; i < 40; ++i) {
+    len += sprintf(buf + len, " %c%d", 'A' + i % 26, i);
+  }
+  len += sprintf(buf + len, "\nM117 S'last line'");
+  write_file(path, buf, len);
+
+  code_file_t file;
+  code_view_t view;
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  munit_assert_int(code_file_pop_view(&file, &view), ==, 0);
+  munit_assert_size(view.num_params, ==, 2);
+  munit_assert_int(code_file_pop_view(&file, &view), ==, SCODE_ERROR_PARSE);
+  munit_assert_int(code_file_pop_view(&file, &view), ==, 0);
+  munit_assert_true(code_view_is_binary(&view));
+  munit_assert_int(code_file_pop_view(&file, &view), ==, 0);
+  munit_assert_size(view.num_params, ==, 40);
+  munit_assert_int(param_view_cast_i32(&view.params[39]), ==, 39);
+  munit_assert_int(code_file_pop_view(&file, &view), ==, 0);
+  munit_assert_char(code_view_letter(&view), ==, 'M');
+  munit_assert_memory_equal(9, view.params[0].str, "last line");
+  munit_assert_int(code_file_pop_view(&file, &view), ==, SCODE_ERROR_BUFFER);
+  free_code_file(&file);
+
+  scode_arena_t arena = init_scode_arena(0);
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  int num_codes = 0;
+  int res;
+  while ((res = code_file_pop_arena(&file, &code, &arena)) !=
+         SCODE_ERROR_BUFFER) {
+    if (res == 0) {
+      num_codes++;
+    }
+  }
+  munit_assert_int(num_codes, ==, 4);
+  munit_assert_string_equal(param_str(&code.params[0]), "last line");
+  free_code_file(&file);
+  free_scode_arena(&arena);
+
+  // A trailing comment is not a code
+  write_file(path, "G28\n; end", 9);
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  munit_assert_int(code_file_pop(&file, &code), ==, 0);
+  free_code(&code);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_BUFFER);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_BUFFER);
+  free_code_file(&file);
+
+  write_file(path, "", 0);
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_BUFFER);
+  free_code_file(&file);
+
+  // Binary codes that end with a wider checksum
+  code = init_code('G', 28, 0);
+  len = code_dump_binary_checksum(&code, buf, sizeof(buf),
+                                  SCODE_CHECKSUM_CRC16);
+  write_file(path, buf, len);
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  munit_assert_int(code_file_pop_view(&file, &view), <, 0);
+  free_code_file(&file);
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  code_file_set_checksum(&file, SCODE_CHECKSUM_CRC16);
+  munit_assert_int(code_file_pop(&file, &code), ==, 0);
+  munit_assert_uint8(code.number, ==, 28);
+  free_code(&code);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_BUFFER);
+  free_code_file(&file);
+
+  unlink(path);
+  munit_assert_int(init_code_file(&file, path), ==, SCODE_ERROR_FILE);
+  free_code_file(&file);
+  return MUNIT_OK;
+}
+
+TEST(test_code_index) {
+  char path[] = "/tmp/scode_test_XXXXXX";
+  char index_path[] = "/tmp/scode_test_XXXXXX";
+  close(mkstemp(path));
+  close(mkstemp(index_path));
+  size_t cap = 1 << 16;
+  char *buf = malloc(cap);
+  size_t len = 0;
+  for (int layer = 0; layer < 10; ++layer) {
+    len += sprintf(buf + len, ";LAYER:%d\n", layer);
+    for (int i = 0; i < 100; ++i) {
+      len += sprintf(buf + len, "G1 X%d E%d\n", layer * 100 + i, i);
+      if (i == 50) {
+        len += sprintf(buf + len, "G1 X$\n");
+      }
+    }
+  }
+  write_file(path, buf, len);
+  free(buf);
+
+  code_file_t file;
+  code_index_t index;
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  munit_assert_int(code_index_build(&index, &file, 64, ";LAYER:"), ==, 0);
+  munit_assert_uint64(index.num_codes, ==, 1000);
+  munit_assert_size(index.num_offsets, ==, 16);
+  munit_assert_size(index.num_markers, ==, 10);
+  munit_assert_int(code_index_save(&index, index_path), ==, 0);
+  free_code_index(&index);
+
+  munit_assert_int(code_index_load(&index, index_path), ==, 0);
+  munit_assert_uint64(index.interval, ==, 64);
+  munit_assert_uint64(index.num_codes, ==, 1000);
+  const code_marker_t *marker = code_index_marker(&index, 7);
+  munit_assert_ptr_not_null(marker);
+  munit_assert_uint64(marker->code, ==, 700);
+  munit_assert_ptr_null(code_index_marker(&index, 10));
+
+  code_t code;
+  uint64_t codes[] = {0, 1, 63, 64, 65, 700, 750, 999};
+  for (size_t i = 0; i < sizeof(codes) / sizeof(codes[0]); ++i) {
+    munit_assert_int(code_file_seek(&file, &index, codes[i]), ==, 0);
+    munit_assert_int(code_file_pop(&file, &code), ==, 0);
+    munit_assert_int(param_cast_i32(&code.params[0]), ==, codes[i]);
+    free_code(&code);
+  }
+  munit_assert_int(code_file_seek(&file, &index, 1000), ==, SCODE_ERROR_BUFFER);
+
+  uint64_t offset, start;
+  munit_assert_int(code_index_find(&index, 130, &offset, &start), ==, 0);
+  munit_assert_uint64(start, ==, 128);
+  code_stream_t stream = init_code_stream(0);
+  code_stream_update(&stream, file.buf + offset, file.len - offset);
+  for (; start <= 130; ++start) {
+    munit_assert_int(code_stream_pop(&stream, &code), ==, 0);
+    if (start < 130) {
+      free_code(&code);
+    }
+  }
+  munit_assert_int(param_cast_i32(&code.params[0]), ==, 130);
+  free_code(&code);
+  free_code_stream(&stream);
+  free_code_file(&file);
+
+  // An index doesn't match a different file
+  write_file(path, "G28\n", 4);
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  munit_assert_int(code_file_seek(&file, &index, 0), ==, SCODE_ERROR_FILE);
+  free_code_file(&file);
+  free_code_index(&index);
+
+  // Damaged indexes are rejected
+  write_file(index_path, "SCIX\x01\x00", 6);
+  munit_assert_int(code_index_load(&index, index_path), <, 0);
+  free_code_index(&index);
+  write_file(index_path, "G28\n", 4);
+  munit_assert_int(code_index_load(&index, index_path), ==, SCODE_ERROR_PARSE);
+  free_code_index(&index);
+
+  unlink(path);
+  unlink(index_path);
+  return MUNIT_OK;
+}
+
+static char *read_file(const char *path, size_t *len) {
+  FILE *file = fopen(path, "rb");
+  munit_assert_ptr_not_null(file);
+  fseek(file, 0, SEEK_END);
+  *len = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *buf = malloc(*len);
+  munit_assert_size(fread(buf, 1, *len, file), ==, *len);
+  fclose(file);
+  return buf;
+}
+
+TEST(test_code_archive) {
+  char path[] = "/tmp/scode_test_XXXXXX";
+  char archive_path[] = "/tmp/scode_test_XXXXXX";
+  close(mkstemp(path));
+  close(mkstemp(archive_path));
+  size_t cap = 1 << 18;
+  char *buf = malloc(cap);
+  size_t len = make_codes(buf, cap, 0, SCODE_CHECKSUM_CRC8);
+  write_file(path, buf, len);
+
+  scode_codes_t expected;
+  munit_assert_int(scode_parse_file_parallel(&expected, path, 1), ==, 0);
+  munit_assert_int(code_archive_pack(path, archive_path, 4096), ==, 0);
+  size_t archive_len;
+  char *archive_buf = read_file(archive_path, &archive_len);
+  munit_assert_size(archive_len, <, len / 2);
+
+  code_archive_t archive;
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  munit_assert_size(archive.num_blocks, >, 10);
+  munit_assert_uint64(archive.num_codes, ==, expected.num_codes);
+  munit_assert_uint64(archive.blocks[1].first_code, ==,
+                      archive.blocks[0].num_codes);
+  code_t code;
+  size_t num_codes = 0;
+  int res;
+  while ((res = code_archive_pop(&archive, &code)) != SCODE_ERROR_BUFFER) {
+    if (res == 0) {
+      assert_same_codes(&code, &expected.codes[num_codes++]);
+      free_code(&code);
+    }
+  }
+  munit_assert_size(num_codes, ==, expected.num_codes);
+  code_view_t view;
+  munit_assert_int(code_archive_pop_view(&archive, &view), ==,
+                   SCODE_ERROR_BUFFER);
+  free_code_archive(&archive);
+
+  scode_codes_t codes;
+  for (size_t threads = 1; threads <= 3; ++threads) {
+    res = scode_parse_archive_parallel(&codes, archive_path, threads);
+    munit_assert_int(res, ==, 0);
+    munit_assert_size(codes.num_codes, ==, expected.num_codes);
+    for (size_t i = 0; i < codes.num_codes; ++i) {
+      assert_same_codes(&codes.codes[i], &expected.codes[i]);
+    }
+    free_scode_codes(&codes);
+  }
+
+  // Without a footer, the blocks before the first incomplete one are found
+  write_file(archive_path, archive_buf, archive_len / 2);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  munit_assert_size(archive.num_blocks, >, 0);
+  munit_assert_uint64(archive.num_codes, <, expected.num_codes);
+  munit_assert_int(code_archive_pop(&archive, &code), ==, 0);
+  assert_same_codes(&code, &expected.codes[0]);
+  free_code(&code);
+  free_code_archive(&archive);
+
+  // A damaged block is detected, and the others can still be read
+  archive_buf[archive_len / 2] ^= 0x10;
+  write_file(archive_path, archive_buf, archive_len);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  char *raw = malloc(archive.blocks[0].raw_len);
+  munit_assert_int(code_archive_read_block(&archive, 0, raw), ==, 0);
+  free(raw);
+  int num_damaged = 0;
+  for (size_t i = 0; i < archive.num_blocks; ++i) {
+    raw = malloc(archive.blocks[i].raw_len);
+    res = code_archive_read_block(&archive, i, raw);
+    munit_assert_true(res == 0 || res == SCODE_ERROR_CRC ||
+                      res == SCODE_ERROR_PARSE);
+    num_damaged += res < 0;
+    free(raw);
+  }
+  munit_assert_int(num_damaged, ==, 1);
+  free_code_archive(&archive);
+  munit_assert_int(scode_parse_archive_parallel(&codes, archive_path, 2), <, 0);
+  free(archive_buf);
+  free_scode_codes(&expected);
+
+  // Codes dumped into a writer as binary
+  int fd = open(archive_path, O_WRONLY | O_TRUNC);
+  munit_assert_int(fd, >=, 0);
+  code_archive_writer_t writer;
+  munit_assert_int(init_code_archive_writer(&writer, fd, 64), ==, 0);
+  code = init_code('G', 1, 2);
+  for (int i = 0; i < 100; ++i) {
+    code.params[0] = init_param_f32('X', i * 0.25f);
+    code.params[1] = init_param_i32('E', i);
+    munit_assert_int(code_archive_dump_binary(&writer, &code), >, 0);
+  }
+  free_code(&code);
+  // A code that is bigger than a block gets a block of its own
+  code_t msg = init_code('M', 117, 1);
+  char text[200];
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  msg.params[0] = init_param_str('S', text);
+  munit_assert_int(code_archive_dump_binary(&writer, &msg), >, 64);
+  free_code(&msg);
+  code = init_code('G', 28, 0);
+  munit_assert_int(code_archive_dump_binary(&writer, &code), >, 0);
+  munit_assert_size(writer.block_size, ==, 64);
+  munit_assert_size(writer.raw_cap, ==, 64);
+  munit_assert_size(writer.packed_cap, ==, 64);
+  munit_assert_int(code_archive_finish(&writer), ==, 0);
+  free_code_archive_writer(&writer);
+  close(fd);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  munit_assert_uint64(archive.num_codes, ==, 102);
+  for (int i = 0; i < 100; ++i) {
+    munit_assert_int(code_archive_pop_view(&archive, &view), ==, 0);
+    munit_assert_true(code_view_is_binary(&view));
+    munit_assert_float(param_view_cast_f32(&view.params[0]), ==, i * 0.25f);
+    munit_assert_int(param_view_cast_i32(&view.params[1]), ==, i);
+  }
+  munit_assert_int(code_archive_pop_view(&archive, &view), ==, 0);
+  munit_assert_size(view.params[0].len, ==, sizeof(text) - 1);
+  munit_assert_int(code_archive_pop_view(&archive, &view), ==, 0);
+  munit_assert_uint8(view.number, ==, 28);
+  munit_assert_int(code_archive_pop_view(&archive, &view), ==,
+                   SCODE_ERROR_BUFFER);
+  for (size_t i = 0; i + 2 < archive.num_blocks; ++i) {
+    munit_assert_uint64(archive.blocks[i].raw_len, <=, 64);
+  }
+  munit_assert_uint64(archive.blocks[archive.num_blocks - 2].num_codes, ==, 1);
+  free_code_archive(&archive);
+
+  // The checksum of the binary codes is recorded in the header
+  fd = open(archive_path, O_WRONLY | O_TRUNC);
+  munit_assert_int(fd, >=, 0);
+  res = init_code_archive_writer_checksum(&writer, fd, 64,
+                                          SCODE_CHECKSUM_CRC32C);
+  munit_assert_int(res, ==, 0);
+  code = init_code('G', 1, 1);
+  for (int i = 0; i < 20; ++i) {
+    code.params[0] = init_param_i32('E', i);
+    munit_assert_int(code_archive_dump_binary(&writer, &code), ==,
+                     code_dump_binary_checksum_size(&code,
+                                                    SCODE_CHECKSUM_CRC32C));
+  }
+  munit_assert_int(code_archive_finish(&writer), ==, 0);
+  free_code_archive_writer(&writer);
+  close(fd);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  munit_assert_uint8(archive.checksum, ==, SCODE_CHECKSUM_CRC32C);
+  for (int i = 0; i < 20; ++i) {
+    munit_assert_int(code_archive_pop_view(&archive, &view), ==, 0);
+    munit_assert_int(param_view_cast_i32(&view.params[0]), ==, i);
+  }
+  free_code_archive(&archive);
+  res = scode_parse_archive_parallel(&codes, archive_path, 2);
+  munit_assert_int(res, ==, 0);
+  munit_assert_size(codes.num_codes, ==, 20);
+  munit_assert_size(codes.num_errors, ==, 0);
+  munit_assert_int(param_cast_i32(&codes.codes[19].params[0]), ==, 19);
+  free_scode_codes(&codes);
+  free_code(&code);
+
+  // A file of codes with the same checksum can be packed
+  len = make_codes(buf, cap, 0, SCODE_CHECKSUM_CRC32C);
+  write_file(path, buf, len);
+  free(buf);
+  res = scode_parse_file_parallel_checksum(&expected, path, 2,
+                                           SCODE_CHECKSUM_CRC32C);
+  munit_assert_int(res, ==, 0);
+  res = code_archive_pack_checksum(path, archive_path, 4096,
+                                   SCODE_CHECKSUM_CRC32C);
+  munit_assert_int(res, ==, 0);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  munit_assert_uint8(archive.checksum, ==, SCODE_CHECKSUM_CRC32C);
+  munit_assert_uint64(archive.num_codes, ==, expected.num_codes);
+  free_code_archive(&archive);
+  res = scode_parse_archive_parallel(&codes, archive_path, 2);
+  munit_assert_int(res, ==, 0);
+  munit_assert_size(codes.num_codes, ==, expected.num_codes);
+  munit_assert_size(codes.num_errors, ==, expected.num_errors);
+  for (size_t i = 0; i < codes.num_codes; ++i) {
+    assert_same_codes(&codes.codes[i], &expected.codes[i]);
+  }
+  free_scode_codes(&codes);
+  free_scode_codes(&expected);
+
+  write_file(archive_path, "", 0);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==,
+                   SCODE_ERROR_PARSE);
+  free_code_archive(&archive);
+  write_file(path, "", 0);
+  munit_assert_int(code_archive_pack(path, archive_path, 0), ==, 0);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==, 0);
+  munit_assert_size(archive.num_blocks, ==, 0);
+  munit_assert_int(code_archive_pop(&archive, &code), ==, SCODE_ERROR_BUFFER);
+  free_code_archive(&archive);
+
+  unlink(path);
+  unlink(archive_path);
+  munit_assert_int(init_code_archive(&archive, archive_path), ==,
+                   SCODE_ERROR_FILE);
+  free_code_archive(&archive);
+  return MUNIT_OK;
+}
+
+// Collects what a writer sends, taking at most max bytes per call
+typedef struct {
+  char out[1024];
+  size_t len;
+  size_t max;
+  int calls;
+  int max_iov;
+  int fail_at; // call that starts failing with EAGAIN, or 0
+} sink_t;
+
+static ssize_t sink_write(void *ctx, const struct iovec *iov, int num) {
+  sink_t *sink = ctx;
+  size_t total = 0;
+  sink->calls++;
+  if (num > sink->max_iov) {
+    sink->max_iov = num;
+  }
+  if (sink->max == 0 ||
+      (sink->fail_at != 0 && sink->calls >= sink->fail_at)) {
+    errno = EAGAIN;
+    return -1;
+  }
+  for (int i = 0; i < num && total < sink->max; ++i) {
+    size_t n = iov[i].iov_len;
+    if (n > sink->max - total) {
+      n = sink->max - total;
+    }
+    memcpy(sink->out + sink->len, iov[i].iov_base, n);
+    sink->len += n;
+    total += n;
+  }
+  return total;
+}
+
+TEST(test_code_writer) {
+  sink_t sink = {{0}, 0, SIZE_MAX, 0, 0};
+  code_writer_t writer;
+  char expected[1024];
+  size_t expected_len = 0;
+  code_t code = init_code('G', 1, 2);
+  code.params[0] = init_param_f32('X', 1.25f);
+  code.params[1] = init_param_i32('F', 3000);
+
+  // Codes wait in the buffer until it is flushed
+  munit_assert_int(init_code_writer_fn(&writer, sink_write, &sink, 64), ==, 0);
+  int human_len = code_writer_dump_human(&writer, &code);
+  munit_assert_int(human_len, ==, code_dump_human(&code, expected, 1024));
+  expected_len += human_len;
+  int len;
+  len = code_writer_dump_binary(&writer, &code);
+  munit_assert_int(len, ==, code_dump_binary(&code, expected + expected_len,
+                                             1024 - expected_len));
+  expected_len += len;
+  munit_assert_int(sink.calls, ==, 0);
+  munit_assert_int(code_writer_flush(&writer), ==, 0);
+  munit_assert_int(sink.calls, ==, 1);
+  munit_assert_size(sink.len, ==, expected_len);
+  munit_assert_memory_equal(expected_len, sink.out, expected);
+
+  // A full buffer is sent
+  for (int i = 0; i < 10; ++i) {
+    code_writer_dump_human(&writer, &code);
+  }
+  munit_assert_int(sink.calls, >, 1);
+  munit_assert_size(writer.len, <, 64);
+  code_writer_flush(&writer);
+  munit_assert_size(sink.len, ==, expected_len + 10 * human_len);
+
+  // Something bigger than the buffer goes out with it in one call
+  char big[100];
+  memset(big, 'x', sizeof(big));
+  sink.len = 0;
+  sink.calls = 0;
+  code_writer_write(&writer, "G28\n", 4);
+  munit_assert_int(code_writer_write(&writer, big, sizeof(big)), ==, 0);
+  munit_assert_int(sink.calls, ==, 1);
+  munit_assert_int(sink.max_iov, ==, 2);
+  munit_assert_size(sink.len, ==, 104);
+  munit_assert_size(writer.len, ==, 0);
+
+  // A code bigger than the buffer is still written
+  code_t msg = init_code('M', 117, 1);
+  msg.params[0] = init_param_str(
+      'S', "a message that is longer than the buffer that the writer has");
+  code_writer_write(&writer, "G28\n", 4);
+  len = code_writer_dump_binary(&writer, &msg);
+  munit_assert_int(len, ==, code_dump_binary_size(&msg));
+  munit_assert_size(sink.len, ==, 104 + 4 + len);
+  free_code(&msg);
+
+  // Short writes are carried on
+  sink.len = 0;
+  sink.max = 5;
+  for (int i = 0; i < 3; ++i) {
+    code_writer_dump_human(&writer, &code);
+  }
+  munit_assert_int(code_writer_flush(&writer), ==, 0);
+  munit_assert_size(sink.len, ==, 3 * human_len);
+  sink.max = SIZE_MAX;
+
+  // The flush size and latency send data early
+  sink.calls = 0;
+  code_writer_set_flush(&writer, 16, 0);
+  code_writer_write(&writer, "G28\n", 4);
+  munit_assert_int(sink.calls, ==, 0);
+  code_writer_dump_human(&writer, &code);
+  munit_assert_int(sink.calls, ==, 1);
+  code_writer_set_flush(&writer, 0, 1000);
+  code_writer_write(&writer, "G28\n", 4);
+  munit_assert_int(code_writer_poll(&writer), ==, 0);
+  munit_assert_size(writer.len, ==, 4);
+  usleep(2000);
+  munit_assert_int(code_writer_poll(&writer), ==, 0);
+  munit_assert_size(writer.len, ==, 0);
+  munit_assert_int(sink.calls, ==, 2);
+
+  // A short write followed by EAGAIN keeps what wasn't sent
+  code_writer_set_flush(&writer, 0, 0);
+  sink.len = 0;
+  sink.calls = 0;
+  sink.max = 5;
+  sink.fail_at = 2;
+  for (int i = 0; i < 3; ++i) {
+    code_writer_dump_human(&writer, &code);
+  }
+  munit_assert_int(code_writer_flush(&writer), ==, SCODE_ERROR_FILE);
+  munit_assert_int(errno, ==, EAGAIN);
+  munit_assert_size(sink.len, ==, 5);
+  munit_assert_size(writer.len, ==, 3 * human_len - 5);
+  sink.fail_at = 0;
+  sink.max = SIZE_MAX;
+  munit_assert_int(code_writer_flush(&writer), ==, 0);
+  munit_assert_size(sink.len, ==, 3 * human_len);
+  munit_assert_memory_equal(human_len, sink.out + 2 * human_len, sink.out);
+
+  // Data that is sent around the buffer is kept once part of it is sent, and
+  // left to be written again if none of it is
+  char expected_big[128];
+  memcpy(expected_big, "G28\n", 4);
+  memcpy(expected_big + 4, big, sizeof(big));
+  sink.len = 0;
+  sink.calls = 0;
+  sink.max = 10;
+  sink.fail_at = 2;
+  code_writer_write(&writer, "G28\n", 4);
+  munit_assert_int(code_writer_write(&writer, big, sizeof(big)), ==, 0);
+  munit_assert_size(writer.len, ==, 94);
+  sink.fail_at = 0;
+  sink.max = SIZE_MAX;
+  munit_assert_int(code_writer_flush(&writer), ==, 0);
+  munit_assert_size(sink.len, ==, 104);
+  munit_assert_memory_equal(104, sink.out, expected_big);
+  munit_assert_size(writer.cap, ==, 64);
+
+  sink.len = 0;
+  sink.calls = 0;
+  sink.max = 4;
+  sink.fail_at = 2;
+  code_writer_write(&writer, "G28\n", 4);
+  munit_assert_int(code_writer_write(&writer, big, sizeof(big)), ==,
+                   SCODE_ERROR_FILE);
+  munit_assert_size(writer.len, ==, 0);
+  sink.fail_at = 0;
+  sink.max = SIZE_MAX;
+
+  // Errors are reported
+  sink.max = 0;
+  code_writer_write(&writer, "G28\n", 4);
+  munit_assert_int(code_writer_flush(&writer), ==, SCODE_ERROR_FILE);
+  free_code_writer(&writer);
+
+  // A file descriptor is written with writev()
+  int fds[2];
+  munit_assert_int(pipe(fds), ==, 0);
+  munit_assert_int(init_code_writer(&writer, fds[1], 0), ==, 0);
+  for (int i = 0; i < 3; ++i) {
+    code_writer_dump_human_fixed(&writer, &code, 1);
+  }
+  munit_assert_int(code_writer_flush(&writer), ==, 0);
+  munit_assert_size(writer.num_writes, ==, 1);
+  char input[256];
+  ssize_t n = read(fds[0], input, sizeof(input));
+  input[n] = '\0';
+  munit_assert_string_equal(input,
+                            "G1 X1.3 F3000\nG1 X1.3 F3000\nG1 X1.3 F3000\n");
+
+  // Binary codes end with the writer's checksum
+  code_writer_set_checksum(&writer, SCODE_CHECKSUM_CRC32C);
+  int size = code_dump_binary_checksum_size(&code, SCODE_CHECKSUM_CRC32C);
+  munit_assert_int(code_writer_dump_binary(&writer, &code), ==, size);
+  munit_assert_int(code_writer_flush(&writer), ==, 0);
+  munit_assert_int(read(fds[0], input, sizeof(input)), ==, size);
+  code_t parsed;
+  munit_assert_int(code_parse_checksum(&parsed, input, size,
+                                       SCODE_CHECKSUM_CRC32C),
+                   ==, size);
+  assert_same_code(&parsed, &code);
+  free_code(&parsed);
+  free_code_writer(&writer);
+  close(fds[0]);
+  close(fds[1]);
+
+  free_code(&code);
+  return MUNIT_OK;
+}
+
+TEST(test_code_stream_pop_into) {
+  code_stream_t cs = init_code_stream(0);
+  code_t code = {0};
+  const char *buf = "M117 S'a long message'\n"
+                    "M117 S'shorter one'\n"
+                    "G1 X1 Y2 S'hi'\n"
+                    "G1 A1 B2 C3 D4 E5 F6 H7 I8 J9 K10 L11 M12\n"
+                    "G1 X3\n"
+                    "G1 X$\n"
+                    "G1 A1 B2 C3 D4 E5 F6 H7 I8 J9 K10 L11 M12 N13\n";
+  code_stream_update(&cs, buf, strlen(buf));
+
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_string_equal(param_str(&code.params[0]), "a long message");
+  char *str = code.params[0].str;
+
+  // A long enough string is written over
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_string_equal(param_str(&code.params[0]), "shorter one");
+  munit_assert_ptr_equal(code.params[0].str, str);
+
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_size(code.num_params, ==, 3);
+  munit_assert_int(param_cast_i32(code_get_param(&code, 'Y')), ==, 2);
+  munit_assert_string_equal(param_str(code_get_param(&code, 'S')), "hi");
+
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_size(code.num_params, ==, 12);
+  munit_assert_int(param_cast_i32(code_get_param(&code, 'M')), ==, 12);
+  param_t *heap = code.params;
+
+  // The heap array is kept for smaller codes
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_ptr_equal(code.params, heap);
+  munit_assert_size(code.num_params, ==, 1);
+  munit_assert_uint8(code.params[1].param, ==, 0);
+  munit_assert_false(code_has_param(&code, 'A'));
+
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, SCODE_ERROR_PARSE);
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_size(code.num_params, ==, 13);
+  munit_assert_int(param_cast_i32(code_get_param(&code, 'N')), ==, 13);
+  free_code(&code);
+
+  // Codes from an arena are left to the arena
+  scode_arena_t arena = init_scode_arena(0);
+  code_parse_arena(&code, buf, strlen(buf), &arena);
+  code_stream_update(&cs, "G28 X0\n", 7);
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_uint8(code.number, ==, 28);
+  munit_assert_uint8(code.flags & CODE_FLAG_ARENA, ==, 0);
+  free_code(&code);
+  free_scode_arena(&arena);
+
+  free_code_stream(&cs);
+  return MUNIT_OK;
+}
+
+TEST(test_code_stream_limit) {
+  code_stream_t cs = init_code_stream(0);
+  code_t code;
+  char line[64];
+
+  // The buffer grows by doubling while a long upload is received
+  size_t caps = 0, last_cap = 0;
+  for (int i = 0; i < 1000; ++i) {
+    int len = sprintf(line, "G1 X%d Y%d\n", i, i);
+    munit_assert_size(code_stream_update(&cs, line, len), ==, len);
+    if (cs.cap != last_cap) {
+      munit_assert_size(cs.cap & (cs.cap - 1), ==, 0);
+      last_cap = cs.cap;
+      caps++;
+    }
+  }
+  munit_assert_size(caps, <, 16);
+  for (int i = 0; i < 1000; ++i) {
+    munit_assert_int(code_stream_pop(&cs, &code), ==, 0);
+    munit_assert_int(param_cast_i32(&code.params[1]), ==, i);
+    free_code(&code);
+  }
+  munit_assert_int(code_stream_pop(&cs, &code), ==, SCODE_ERROR_BUFFER);
+  free_code_stream(&cs);
+
+  // A full stream only takes what fits
+  cs = init_code_stream(0);
+  code_stream_set_limit(&cs, 32);
+  const char *buf = "G1 X1\nG1 X2\nG1 X3\nG1 X4\nG1 X5\nG1 X6\nG1 X7\n";
+  size_t len = strlen(buf);
+  size_t added = code_stream_update(&cs, buf, len);
+  munit_assert_size(added, ==, 32);
+  munit_assert_size(cs.cap, ==, 32);
+  munit_assert_size(code_stream_update(&cs, buf + added, len - added), ==, 0);
+  for (int i = 1; i <= 5; ++i) {
+    munit_assert_int(code_stream_pop(&cs, &code), ==, 0);
+    munit_assert_int(param_cast_i32(&code.params[0]), ==, i);
+    free_code(&code);
+  }
+  munit_assert_size(code_stream_update(&cs, buf + added, len - added), ==,
+                    len - added);
+  munit_assert_size(cs.cap, ==, 32);
+  for (int i = 6; i <= 7; ++i) {
+    munit_assert_int(code_stream_pop(&cs, &code), ==, 0);
+    munit_assert_int(param_cast_i32(&code.params[0]), ==, i);
+    free_code(&code);
+  }
+
+  // A code that is longer than the limit is dropped
+  buf = "M117 S'this message is far too long for the stream'\nG28\n";
+  len = strlen(buf);
+  added = 0;
+  int dropped = 0;
+  while (added < len) {
+    added += code_stream_update(&cs, buf + added, len - added);
+    int res = code_stream_pop(&cs, &code);
+    if (res == SCODE_ERROR_MEMORY) {
+      dropped++;
+    }
+    if (res == 0) {
+      munit_assert_uint8(code.number, ==, 28);
+      free_code(&code);
+      break;
+    }
+  }
+  munit_assert_int(dropped, ==, 1);
+  munit_assert_size(cs.cap, ==, 32);
+  free_code_stream(&cs);
+  return MUNIT_OK;
+}
+
+// While set, the heap fails and the calls to it are counted. The allocator is
+// only wrapped when TEST_WRAP_MALLOC is defined.
+static int heap_watch = 0;
+static int heap_calls = 0;
+
+#if defined(TEST_WRAP_MALLOC)
+void *__real_malloc(size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+  if (heap_watch) {
+    heap_calls++;
+    return NULL;
+  }
+  return __real_malloc(size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  if (heap_watch) {
+    heap_calls++;
+    return NULL;
+  }
+  return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+  if (heap_watch && ptr != NULL) {
+    heap_calls++;
+  }
+  __real_free(ptr);
+}
+#endif
+
+TEST(test_code_file_memory) {
+#if defined(TEST_WRAP_MALLOC)
+  char path[] = "/tmp/scode_test_XXXXXX";
+  close(mkstemp(path));
+  char buf[512];
+  size_t len = 0;
+  // More params than a view array starts with, or than fit in a code
+  for (int line = 0; line < 2; ++line) {
+    len += sprintf(buf + len, "G1");
+    for (int i = 0; i < 40; ++i) {
+      len += sprintf(buf + len, " %c%d", 'A' + i % 26, i);
+    }
+    len += sprintf(buf + len, "\nG28\n");
+  }
+  write_file(path, buf, len - 1);
+
+  // Codes that there is no memory for are skipped, the last one too
+  code_file_t file;
+  code_view_t view;
+  code_t code;
+  munit_assert_int(init_code_file(&file, path), ==, 0);
+  heap_watch = 1;
+  munit_assert_int(code_file_pop_view(&file, &view), ==, SCODE_ERROR_MEMORY);
+  munit_assert_int(code_file_pop_view(&file, &view), ==, 0);
+  munit_assert_uint8(view.number, ==, 28);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_MEMORY);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_MEMORY);
+  munit_assert_int(code_file_pop(&file, &code), ==, SCODE_ERROR_BUFFER);
+  heap_watch = 0;
+  free_code_file(&file);
+  unlink(path);
+#endif
+  return MUNIT_OK;
+}
+
+TEST(test_param_str_memory) {
+#if defined(TEST_WRAP_MALLOC)
+  // A string too long for the param that can't be copied to the heap
+  char buf[64];
+  code_t code = init_code('M', 117, 1);
+  heap_watch = 1;
+  code.params[0] = init_param_str('S', "a string longer than the inline one");
+  heap_watch = 0;
+  munit_assert_ptr_null(param_str(&code.params[0]));
+  munit_assert_int(param_dump_binary_size(&code.params[0]), ==,
+                   SCODE_ERROR_MEMORY);
+  munit_assert_int(param_dump_binary(&code.params[0], buf, sizeof(buf)), ==,
+                   SCODE_ERROR_MEMORY);
+  munit_assert_int(code_dump_binary_size(&code), ==, SCODE_ERROR_MEMORY);
+  munit_assert_int(code_dump_binary(&code, buf, sizeof(buf)), ==,
+                   SCODE_ERROR_MEMORY);
+  munit_assert_int(code_dump_binary_narrow(&code, buf, sizeof(buf)), ==,
+                   SCODE_ERROR_MEMORY);
+  munit_assert_int(code_dump_binary_framed(&code, buf, sizeof(buf)), ==,
+                   SCODE_ERROR_MEMORY);
+  munit_assert_int(code_dump_human_size(&code), ==, SCODE_ERROR_MEMORY);
+  munit_assert_int(code_dump_human(&code, buf, sizeof(buf)), ==,
+                   SCODE_ERROR_MEMORY);
+  free_code(&code);
+#endif
+  return MUNIT_OK;
+}
+
+TEST(test_code_stream_framed) {
+  char buf[512];
+  char frame[64];
+  code_t code = init_code('G', 1, 2);
+  // Values that hold a null and a line ending
+  code.params[0] = init_param_i32('X', 0x000A000A);
+  code.params[1] = init_param_str('S', "framed");
+
+  int size = code_dump_binary_framed_size(&code);
+  munit_assert_int(code_dump_binary_framed(&code, frame, size - 1), ==,
+                   SCODE_ERROR_BUFFER);
+  munit_assert_int(code_dump_binary_framed(&code, frame, sizeof(frame)), ==,
+                   size);
+  munit_assert_uint8(frame[0], ==, CODE_FRAME_SYNC);
+  size_t header;
+  munit_assert_int(code_frame_size(frame, size, &header), ==, size);
+  munit_assert_size(header, ==, 2);
+  munit_assert_int(code_frame_size(frame, 1, &header), ==, SCODE_ERROR_BUFFER);
+  munit_assert_int(code_frame_size("G1\n", 3, &header), ==, SCODE_ERROR_PARSE);
+
+  // Any binary code can be framed after it is dumped
+  int len = code_dump_binary(&code, buf, sizeof(buf));
+  munit_assert_int(code_frame(buf, sizeof(buf), len), ==, size);
+  munit_assert_memory_equal(size, buf, frame);
+
+  code_t parsed;
+  munit_assert_int(code_parse(&parsed, frame, size), ==, size);
+  assert_same_code(&parsed, &code);
+  free_code(&parsed);
+
+  // Framed codes mix with human and binary codes
+  code_stream_t cs = init_code_stream(0);
+  len = sprintf(buf, "G28\n");
+  memcpy(buf + len, frame, size);
+  len += size;
+  len += code_dump_binary(&code, buf + len, sizeof(buf) - len);
+  memcpy(buf + len, frame, size);
+  len += size;
+  code_stream_update(&cs, buf, len);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+  munit_assert_uint8(parsed.number, ==, 28);
+  free_code(&parsed);
+  for (int i = 0; i < 3; ++i) {
+    munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+    assert_same_code(&parsed, &code);
+    free_code(&parsed);
+  }
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, SCODE_ERROR_BUFFER);
+
+  // A damaged frame is dropped up to its end, even though its values hold a
+  // null and a line ending
+  memcpy(buf, frame, size);
+  buf[header + 2] &= 0xE0;
+  memcpy(buf + size, frame, size);
+  code_stream_update(&cs, buf, 2 * size);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, SCODE_ERROR_PARSE);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+  assert_same_code(&parsed, &code);
+  free_code(&parsed);
+
+  memcpy(buf, frame, size);
+  buf[size - 1] ^= 0xFF;
+  memcpy(buf + size, frame, size);
+  code_stream_update(&cs, buf, 2 * size);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, SCODE_ERROR_CRC);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+  free_code(&parsed);
+
+  // A frame that is shorter than its code is invalid
+  memcpy(buf, frame, size);
+  buf[1]--;
+  munit_assert_int(code_parse(&parsed, buf, size), ==, SCODE_ERROR_PARSE);
+  size_t consumed;
+  memcpy(buf + size, "G28\n", 4);
+  munit_assert_int(code_parse_next(&parsed, buf, size + 4, &consumed, NULL),
+                   ==, SCODE_ERROR_PARSE);
+  munit_assert_size(consumed, ==, size - 1);
+
+  // Frames are skipped without being parsed, even before all of them arrives
+  code_stream_update(&cs, frame, 3);
+  munit_assert_int(code_stream_skip(&cs), ==, 0);
+  code_stream_update(&cs, frame + 3, size - 3);
+  code_stream_update(&cs, frame, size);
+  code_stream_update(&cs, "G28\n", 4);
+  munit_assert_int(code_stream_skip(&cs), ==, 0);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+  munit_assert_uint8(parsed.number, ==, 28);
+  free_code(&parsed);
+  code_stream_update(&cs, "G28\nG1", 6);
+  munit_assert_int(code_stream_skip(&cs), ==, 0);
+  munit_assert_int(code_stream_skip(&cs), ==, SCODE_ERROR_BUFFER);
+  code_stream_update(&cs, "\n", 1);
+  munit_assert_int(code_stream_skip(&cs), ==, 0);
+  munit_assert_int(code_stream_skip(&cs), ==, SCODE_ERROR_BUFFER);
+  free_code_stream(&cs);
+
+  // A frame that is longer than the limit is dropped once its length is known
+  cs = init_code_stream(0);
+  code_stream_set_limit(&cs, 64);
+  char long_str[200];
+  memset(long_str, 'x', sizeof(long_str) - 1);
+  long_str[sizeof(long_str) - 1] = '\0';
+  free_param(&code.params[1]);
+  code.params[1] = init_param_str('S', long_str);
+  len = code_dump_binary_framed(&code, buf, sizeof(buf));
+  len += sprintf(buf + len, "G28\n");
+  code_stream_update(&cs, buf, 8);
+  munit_assert_int(code_stream_pop(&cs, &parsed), ==, SCODE_ERROR_MEMORY);
+  size_t added = 8;
+  int popped = 0;
+  while (added < (size_t)len) {
+    added += code_stream_update(&cs, buf + added, len - added);
+    int res = code_stream_pop(&cs, &parsed);
+    munit_assert_true(res == SCODE_ERROR_BUFFER || res == 0);
+    if (res == 0) {
+      munit_assert_uint8(parsed.number, ==, 28);
+      free_code(&parsed);
+      popped++;
+    }
+  }
+  munit_assert_int(popped, ==, 1);
+  munit_assert_size(cs.cap, <=, 64);
+  free_code_stream(&cs);
+  free_code(&code);
+  return MUNIT_OK;
+}
+
+TEST(test_code_stream_static) {
+  char buf[32];
+  char arena_buf[128];
+  code_stream_t cs = init_code_stream_static(buf, sizeof(buf));
+  scode_arena_t arena = init_scode_arena_static(arena_buf, sizeof(arena_buf));
+  code_t code = {0};
+  code_view_t view;
+  const char *input = "G1 X1 Y2\nM117 S'a long message'\nG28\n";
+  size_t len = strlen(input);
+
+  heap_watch = 1;
+  heap_calls = 0;
+
+  // Only what fits in the buffer is taken
+  size_t added = code_stream_update(&cs, input, len);
+  munit_assert_size(added, ==, 32);
+  munit_assert_size(cs.cap, ==, 32);
+
+#if SCODE_INLINE_PARAMS >= 2
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, 0);
+  munit_assert_size(code.num_params, ==, 2);
+  munit_assert_int(param_cast_i32(code_get_param(&code, 'Y')), ==, 2);
+#else
+  munit_assert_int(code_stream_pop_arena(&cs, &code, &arena), ==, 0);
+#endif
+
+  // Long strings go in the arena
+  code_t msg;
+  munit_assert_int(code_stream_pop_arena(&cs, &msg, &arena), ==, 0);
+  munit_assert_string_equal(param_str(&msg.params[0]), "a long message");
+  free_code(&msg);
+
+  munit_assert_size(code_stream_update(&cs, input + added, len - added), ==,
+                    len - added);
+  munit_assert_int(code_stream_pop_view(&cs, &view), ==, 0);
+  munit_assert_uint8(view.number, ==, 28);
+  munit_assert_int(code_stream_pop_view(&cs, &view), ==, SCODE_ERROR_BUFFER);
+
+  // A code longer than the buffer is dropped
+  input = "M117 S'this message is far too long for the stream'\nG4\n";
+  len = strlen(input);
+  added = 0;
+  int dropped = 0, popped = 0;
+  while (added < len) {
+    added += code_stream_update(&cs, input + added, len - added);
+    int res;
+    while ((res = code_stream_pop_view(&cs, &view)) != SCODE_ERROR_BUFFER) {
+      if (res == SCODE_ERROR_MEMORY) {
+        dropped++;
+      } else if (res == 0) {
+        munit_assert_uint8(view.number, ==, 4);
+        popped++;
+      }
+    }
+  }
+  munit_assert_int(dropped, ==, 1);
+  munit_assert_int(popped, ==, 1);
+
+  // A full arena fails instead of growing
+  munit_assert_ptr_not_null(scode_arena_alloc(&arena, 16));
+  munit_assert_ptr_null(scode_arena_alloc(&arena, sizeof(arena_buf)));
+  scode_arena_reset(&arena);
+  munit_assert_ptr_not_null(scode_arena_alloc(&arena, 16));
+
+  munit_assert_int(heap_calls, ==, 0);
+
+#if defined(TEST_WRAP_MALLOC)
+  // Codes that don't fit inline report that the heap is out of memory
+  input = "G1 A1 B2 C3 D4 E5 F6 H7 I8 J9\n";
+  code_stream_update(&cs, input, strlen(input));
+  munit_assert_int(code_stream_pop_into(&cs, &code), ==, SCODE_ERROR_MEMORY);
+  munit_assert_int(heap_calls, >, 0);
+#endif
+
+  heap_watch = 0;
+  free_code(&code);
+  free_code_stream(&cs);
+  free_scode_arena(&arena);
+  munit_assert_ptr_null(arena.head);
+  return MUNIT_OK;
+}
+
+TEST(test_code_stream_view) {
+  code_stream_t cs = init_code_stream(0);
+  code_view_t code;
+  const char *buf;
+
+  buf = "G1 X2 F'ab'\nG2\n";
+  code_stream_update(&cs, buf, strlen(buf));
+  munit_assert_int(code_stream_pop_view(&cs, &code), ==, 0);
+  munit_assert_char(code_view_letter(&code), ==, 'G');
+  munit_assert_size(code.num_params, ==, 2);
+  munit_assert_ptr_equal(code.params[1].str, cs.buf + 8);
+  munit_assert_size(code.params[1].len, ==, 2);
+
+  munit_assert_int(code_stream_pop_view(&cs, &code), ==, 0);
+  munit_assert_uint8(code.number, ==, 2);
+  munit_assert_size(code.num_params, ==, 0);
+  munit_assert_int(code_stream_pop_view(&cs, &code), ==, SCODE_ERROR_BUFFER);
+
+  free_code_stream(&cs);
+  return MUNIT_OK;
+}
+
 TEST(test_crc) {
   char *buf;
   uint8_t result;
@@ -454,6 +2588,214 @@ TEST(test_crc) {
   return MUNIT_OK;
 }
 
+TEST(test_crc_variants) {
+  char buf[1024];
+  for (size_t i = 0; i < sizeof(buf); ++i) {
+    buf[i] = (char)munit_rand_uint32();
+  }
+
+  for (size_t len = 0; len < 300; ++len) {
+    for (size_t offset = 0; offset < 3; ++offset) {
+      const char *b = buf + offset * 7;
+      uint8_t crc = crc_calc_bitwise(b, len, 0);
+      munit_assert_uint8(crc_calc_table(b, len, 0), ==, crc);
+      munit_assert_uint8(crc_calc(b, len, 0), ==, crc);
+      munit_assert_uint8(crc_calc(b, len, crc), ==, 0);
+#if SCODE_CRC_FAST
+      munit_assert_uint8(crc_calc_slice8(b, len, 0), ==, crc);
+      if (crc_clmul_supported()) {
+        munit_assert_uint8(crc_calc_clmul(b, len, 0), ==, crc);
+        munit_assert_uint8(crc_calc_clmul(b, len, crc), ==, 0);
+      }
+#endif
+    }
+  }
+
+  munit_assert_uint8(crc_calc_bitwise("Hello World!", 12, 0), ==, 0x1C);
+#if SCODE_CRC_FAST
+  munit_assert_uint8(crc_calc_slice8("Hello World!", 12, 0), ==, 0x1C);
+#endif
+
+  return MUNIT_OK;
+}
+
+TEST(test_checksum) {
+  munit_assert_uint16(crc16_calc("123456789", 9, 0), ==, 0x31C3);
+  munit_assert_uint32(crc32c_calc("123456789", 9, 0), ==, 0xE3069283);
+  munit_assert_uint32(crc32c_calc_table("123456789", 9, 0), ==, 0xE3069283);
+  munit_assert_uint32(crc32c_calc("", 0, 0), ==, 0);
+
+  char rand[1024];
+  for (size_t i = 0; i < sizeof(rand); ++i) {
+    rand[i] = (char)munit_rand_uint32();
+  }
+  for (size_t len = 0; len < 300; ++len) {
+    for (size_t offset = 0; offset < 3; ++offset) {
+      const char *b = rand + offset * 7;
+      uint32_t crc = crc32c_calc_table(b, len, 0);
+      munit_assert_uint32(crc32c_calc(b, len, 0), ==, crc);
+      munit_assert_uint32(crc32c_calc(b, len, crc), ==, 0);
+      if (crc32c_hw_supported()) {
+        munit_assert_uint32(crc32c_calc_hw(b, len, 0), ==, crc);
+      }
+      uint16_t crc16 = crc16_calc(b, len, 0);
+      munit_assert_uint16(crc16_calc(b, len, crc16), ==, 0);
+    }
+  }
+
+  code_t code = init_code('G', 1, 3);
+  code.params[0] = init_param_f32('X', 12.345);
+  code.params[1] = init_param_i16('Y', -300);
+  code.params[2] = init_param_str('S', "checksum");
+  // The rest of an invalid code is skipped up to a null, so there can't be one
+  // in its values
+  code_t move = init_code('G', 1, 2);
+  move.params[0] = init_param_f32('X', 12.345);
+  move.params[1] = init_param_i16('Y', -300);
+
+  const uint8_t widths[] = {SCODE_CHECKSUM_CRC8, SCODE_CHECKSUM_CRC16,
+                            SCODE_CHECKSUM_CRC32C};
+  for (size_t w = 0; w < sizeof(widths); ++w) {
+    uint8_t checksum = widths[w];
+    char buf[512];
+    code_t parsed;
+
+    int size = code_dump_binary_checksum_size(&code, checksum);
+    munit_assert_int(size, ==, code_dump_binary_size(&code) + checksum - 1);
+    munit_assert_int(code_dump_binary_checksum(&code, buf, size - 1, checksum),
+                     ==, SCODE_ERROR_BUFFER);
+    munit_assert_int(
+        code_dump_binary_checksum(&code, buf, sizeof(buf), checksum), ==, size);
+    munit_assert_uint8(buf[size - 1 - checksum], ==, 0);
+    munit_assert_int(code_parse_checksum(&parsed, buf, size, checksum), ==,
+                     size);
+    assert_same_code(&parsed, &code);
+    free_code(&parsed);
+    munit_assert_int(code_parse_checksum(&parsed, buf, size - 1, checksum), ==,
+                     SCODE_ERROR_BUFFER);
+    if (checksum != SCODE_CHECKSUM_CRC8) {
+      munit_assert_int(code_parse(&parsed, buf, size), <, 0);
+    }
+
+    // Every byte of the checksum is checked
+    for (int i = 1; i <= checksum; ++i) {
+      buf[size - i] ^= 0x10;
+      munit_assert_int(code_parse_checksum(&parsed, buf, size, checksum), ==,
+                       SCODE_ERROR_CRC);
+      buf[size - i] ^= 0x10;
+    }
+
+    // One byte at a time, with a damaged code and an invalid one in between
+    code_stream_t cs = init_code_stream(0);
+    code_stream_set_checksum(&cs, checksum);
+    int len = size;
+    memcpy(buf + len, buf, size);
+    buf[len + 3] ^= 0x01;
+    len += size;
+    int move_size = code_dump_binary_checksum(&move, buf + len,
+                                              sizeof(buf) - len, checksum);
+    buf[len + 2] = 0x40;
+    memset(buf + len + move_size - checksum, 0xC7, checksum);
+    len += move_size;
+    len += sprintf(buf + len, "G28\n");
+    memcpy(buf + len, buf, size);
+    len += size;
+
+    const int expected[] = {0, SCODE_ERROR_CRC, SCODE_ERROR_PARSE, 0, 0};
+    size_t popped = 0;
+    for (int i = 0; i < len; ++i) {
+      code_stream_update(&cs, buf + i, 1);
+      int res;
+      while ((res = code_stream_pop(&cs, &parsed)) != SCODE_ERROR_BUFFER) {
+        munit_assert_size(popped, <, 5);
+        munit_assert_int(res, ==, expected[popped]);
+        if (res == 0) {
+          munit_assert_uint8(parsed.number, ==, popped == 3 ? 28 : 1);
+          free_code(&parsed);
+        }
+        popped++;
+      }
+    }
+    munit_assert_size(popped, ==, 5);
+
+    // Framed codes leave room for the checksum
+    size = code_dump_binary_checksum(&code, buf, sizeof(buf), checksum);
+    size = code_frame(buf, sizeof(buf), size);
+    code_stream_update(&cs, buf, size);
+    munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+    assert_same_code(&parsed, &code);
+    free_code(&parsed);
+
+    // So do the other binary dumps
+    scode_quant_t profile = {0};
+    scode_quant_set(&profile, 'X', 1000, PARAM_T_I16);
+    code_delta_t sender = init_code_delta();
+    code_delta_t receiver = init_code_delta();
+    code_stream_set_delta(&cs, &receiver);
+    int sizes[7];
+    const code_t *sent[] = {&code, &move, &move, &code, &code, &move, &move};
+    sizes[0] = code_dump_binary_narrow_checksum(&code, buf, sizeof(buf),
+                                                checksum);
+    munit_assert_int(sizes[0], ==,
+                     code_dump_binary_narrow_checksum_size(&code, checksum));
+    len = sizes[0];
+    sizes[1] = code_dump_binary_quant_checksum(&move, buf + len,
+                                               sizeof(buf) - len, &profile,
+                                               checksum);
+    munit_assert_int(sizes[1], ==,
+                     code_dump_binary_quant_checksum_size(&move, &profile,
+                                                          checksum));
+    len += sizes[1];
+    const code_t batch[] = {move, code};
+    size_t offsets[2];
+    size = code_dump_binary_batch_checksum(batch, 2, buf + len,
+                                           sizeof(buf) - len, offsets,
+                                           checksum);
+    sizes[2] = (int)offsets[1];
+    sizes[3] = size - (int)offsets[1];
+    len += size;
+    sizes[4] = code_dump_binary_framed_checksum(&code, buf + len,
+                                                sizeof(buf) - len, checksum);
+    munit_assert_int(sizes[4], ==,
+                     code_dump_binary_framed_checksum_size(&code, checksum));
+    len += sizes[4];
+    for (int i = 5; i < 7; ++i) {
+      sizes[i] = code_dump_binary_delta_checksum(
+          &move, buf + len, sizeof(buf) - len, &sender, NULL, checksum);
+      munit_assert_int(sizes[i], >, 0);
+      len += sizes[i];
+    }
+    munit_assert_int(sizes[6], <, sizes[5]);
+    for (int i = 0; i < 7; ++i) {
+      if (i != 4) {
+        munit_assert_uint8(buf[sizes[i] - 1 - checksum], ==, 0);
+      }
+      code_stream_update(&cs, buf, sizes[i]);
+      memmove(buf, buf + sizes[i], len -= sizes[i]);
+      munit_assert_int(code_stream_pop(&cs, &parsed), ==, 0);
+      if (i == 1) {
+        munit_assert_uint8(param_type(&parsed.params[0]), ==, PARAM_T_I16);
+        munit_assert_int16(parsed.params[0].i16, ==, 12345);
+      } else {
+        assert_same_code(&parsed, sent[i]);
+      }
+      free_code(&parsed);
+    }
+    free_code_stream(&cs);
+  }
+  // Anything else is a CRC-8, which is what the other functions use
+  char buf[512];
+  int size = code_dump_binary_checksum(&code, buf, sizeof(buf), 3);
+  munit_assert_int(size, ==, code_dump_binary_size(&code));
+  code_t parsed;
+  munit_assert_int(code_parse(&parsed, buf, size), ==, size);
+  free_code(&parsed);
+  free_code(&code);
+  free_code(&move);
+
+  return MUNIT_OK;
+}
+
 TEST(test_comments) {
   char *buf;
   code_t code;
@@ -551,6 +2893,117 @@ TEST(test_code_stream) {
   return MUNIT_OK;
 }
 
+TEST(test_code_stream_incremental) {
+  code_stream_t cs = init_code_stream(4);
+  code_t cmd;
+  const char *buf;
+
+  // Feed one byte at a time, the code should pop as soon as the newline
+  // arrives
+  buf = "G1 X10.5 Y-2 F'fast' ;move\r\n";
+  for (size_t i = 0; i < strlen(buf); ++i) {
+    code_stream_update(&cs, &buf[i], 1);
+    if (buf[i] != '\r') {
+      munit_assert_int(code_stream_pop(&cs, &cmd), ==, SCODE_ERROR_BUFFER);
+      continue;
+    }
+    munit_assert_int(code_stream_pop(&cs, &cmd), ==, 0);
+    munit_assert_char(code_letter(&cmd), ==, 'G');
+    munit_assert_uint8(cmd.number, ==, 1);
+    munit_assert_uint8(param_letter(&cmd.params[0]), ==, 'X');
+    munit_assert_float(cmd.params[0].f32, ==, 10.5);
+    munit_assert_uint8(param_letter(&cmd.params[1]), ==, 'Y');
+    munit_assert_int8(cmd.params[1].i8, ==, -2);
+    munit_assert_string_equal(param_str(&cmd.params[2]), "fast");
+    munit_assert_uint8(cmd.params[3].param, ==, 0);
+    free_code(&cmd);
+  }
+
+  // A binary code pops as soon as the crc arrives
+  buf = "\xD3\x02\x8E\xD3\x04\x00\x59";
+  for (size_t i = 0; i < 7; ++i) {
+    code_stream_update(&cs, &buf[i], 1);
+    if (i < 6) {
+      munit_assert_int(code_stream_pop(&cs, &cmd), ==, SCODE_ERROR_BUFFER);
+    }
+  }
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, 0);
+  munit_assert_char(code_letter(&cmd), ==, 'S');
+  munit_assert_int16(cmd.params[0].i16, ==, 1235);
+  free_code(&cmd);
+
+  // Errors are reported right away, and the rest of the line is skipped once
+  // it arrives
+  buf = "G1 X1 ?";
+  code_stream_update(&cs, buf, strlen(buf));
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, SCODE_ERROR_PARSE);
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, SCODE_ERROR_BUFFER);
+  buf = " Y2\nM3\n";
+  code_stream_update(&cs, buf, strlen(buf));
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, 0);
+  munit_assert_char(code_letter(&cmd), ==, 'M');
+  munit_assert_uint8(cmd.number, ==, 3);
+  free_code(&cmd);
+
+  // Bad binary crc
+  buf = "\xD3\x06\x8E\xD3\x04\x00\x10G5\n";
+  code_stream_update(&cs, buf, 10);
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, SCODE_ERROR_CRC);
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, 0);
+  munit_assert_char(code_letter(&cmd), ==, 'G');
+  munit_assert_uint8(cmd.number, ==, 5);
+  free_code(&cmd);
+
+  // Comments don't need to stay in the buffer
+  buf = "; a long comment that does not need to be kept around";
+  code_stream_update(&cs, buf, strlen(buf));
+  munit_assert_int(code_stream_pop(&cs, &cmd), ==, SCODE_ERROR_BUFFER);
+  munit_assert_size(cs.end - cs.pos, ==, 0);
+
+  free_code_stream(&cs);
+  return MUNIT_OK;
+}
+
+TEST(test_code_stream_long_lines) {
+  // Lines long enough to cross several vector widths, with the delimiters at
+  // every offset
+  char line[512];
+  code_stream_t stream = init_code_stream(64);
+  code_t code;
+
+  for (size_t n = 0; n < 100; ++n) {
+    size_t pos = 0;
+    pos += sprintf(line + pos, "M117 S'");
+    memset(line + pos, 'a', n);
+    pos += n;
+    pos += sprintf(line + pos, "' ;");
+    memset(line + pos, 'c', n);
+    pos += n;
+    pos += sprintf(line + pos, "\n;");
+    memset(line + pos, ';', n);
+    pos += n;
+    pos += sprintf(line + pos, "\r\nG1 X\"");
+    memset(line + pos, 'b', n);
+    pos += n;
+    line[pos++] = '\n';
+
+    munit_assert_int(code_parse(&code, line, pos), ==, 2 * n + 11);
+    munit_assert_size(strlen(param_str(&code.params[0])), ==, n);
+    free_code(&code);
+
+    code_stream_update(&stream, line, pos);
+    munit_assert_int(code_stream_pop(&stream, &code), ==, 0);
+    munit_assert_size(strlen(param_str(&code.params[0])), ==, n);
+    free_code(&code);
+    // The unterminated string is resynced at the end of the line
+    munit_assert_int(code_stream_pop(&stream, &code), ==, SCODE_ERROR_PARSE);
+    munit_assert_int(code_stream_pop(&stream, &code), ==, SCODE_ERROR_BUFFER);
+  }
+
+  free_code_stream(&stream);
+  return MUNIT_OK;
+}
+
 TEST(test_swap_endian) {
 
   munit_assert_uint16(swap_endian_16(*(uint16_t *)"AB"), ==, *(uint16_t *)"BA");
@@ -563,17 +3016,47 @@ TEST(test_swap_endian) {
 }
 
 static MunitTest test_suite_tests[] = {TEST_ITEM(test_crc),
+                                       TEST_ITEM(test_crc_variants),
+                                       TEST_ITEM(test_checksum),
                                        TEST_ITEM(test_param_init),
                                        TEST_ITEM(test_param_dump_binary),
                                        TEST_ITEM(test_param_dump_human),
+                                       TEST_ITEM(test_param_dump_human_float),
                                        TEST_ITEM(test_param_parse_human),
+                                       TEST_ITEM(test_param_parse_rounding),
+                                       TEST_ITEM(test_param_parse_long),
                                        TEST_ITEM(test_param_parse_binary),
+                                       TEST_ITEM(test_param_str_inline),
                                        TEST_ITEM(test_code_dump_human),
                                        TEST_ITEM(test_code_dump_binary),
+                                       TEST_ITEM(test_code_dump_size),
+                                       TEST_ITEM(test_code_dump_binary_batch),
+                                       TEST_ITEM(test_code_dump_binary_narrow),
+                                       TEST_ITEM(test_code_dump_binary_quant),
+                                       TEST_ITEM(test_code_dump_binary_delta),
                                        TEST_ITEM(test_code_parse_human),
                                        TEST_ITEM(test_code_parse_binary),
+                                       TEST_ITEM(test_code_parse_view),
+                                       TEST_ITEM(test_code_get_param),
+                                       TEST_ITEM(test_code_inline_params),
+                                       TEST_ITEM(test_code_parse_arena),
+                                       TEST_ITEM(test_code_parse_next),
+                                       TEST_ITEM(test_code_parse_parallel),
+                                       TEST_ITEM(test_code_file),
+                                       TEST_ITEM(test_code_file_memory),
+                                       TEST_ITEM(test_param_str_memory),
+                                       TEST_ITEM(test_code_index),
+                                       TEST_ITEM(test_code_archive),
+                                       TEST_ITEM(test_code_writer),
                                        TEST_ITEM(test_comments),
                                        TEST_ITEM(test_code_stream),
+                                       TEST_ITEM(test_code_stream_incremental),
+                                       TEST_ITEM(test_code_stream_view),
+                                       TEST_ITEM(test_code_stream_pop_into),
+                                       TEST_ITEM(test_code_stream_long_lines),
+                                       TEST_ITEM(test_code_stream_limit),
+                                       TEST_ITEM(test_code_stream_framed),
+                                       TEST_ITEM(test_code_stream_static),
                                        TEST_ITEM(test_swap_endian),
                                        TEST_NULL};
 